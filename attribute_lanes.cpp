@@ -0,0 +1,275 @@
+#include "attribute_lanes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // Fractions of vertices a statistic needs to reach for a label to stick
+    constexpr float Strict = 0.98f;
+    constexpr float Loose = 0.9f;
+
+    inline uint32_t swapWord(uint32_t w)
+    {
+        return (w >> 24) | ((w >> 8) & 0x0000FF00u) | ((w << 8) & 0x00FF0000u) | (w << 24);
+    }
+
+    // One 4-byte lane across all sampled vertices. The loops filling these are kept free of branches and calls so
+    // the compiler can vectorize them.
+    struct LaneStats
+    {
+        std::vector<uint32_t> raw;     // file byte order, as read little-endian
+        std::vector<float> values;     // decoded as floats in the layout's byte order
+
+        float finite = 0;       // zero or a normal-sized float, not NaN, infinite or denormal-small
+        float signedUnit = 0;   // in [-1, 1]
+        float unorm = 0;        // in [0, 1], with a little slack for UVs that overshoot
+        float nonzero = 0;
+        float halfUnorm = 0;    // both halves read as half floats are 0 or in [1/2048, 1]
+        float byteSum255 = 0;   // the four bytes add up to 255, as normalized byte weights do
+        float opaqueLast = 0;   // last byte 255, an RGBA alpha
+        float opaqueFirst = 0;  // first byte 255, an ARGB alpha
+        uint32_t byteMax = 0;
+        bool constant = true;
+    };
+
+    void computeStats(LaneStats& lane, bool bigEndian)
+    {
+        size_t count = lane.raw.size();
+        lane.values.resize(count);
+        uint32_t swap = bigEndian ? 1 : 0;
+        for (size_t v = 0; v < count; v++) {
+            uint32_t word = lane.raw[v];
+            uint32_t ordered = swap ? swapWord(word) : word;
+            memcpy(&lane.values[v], &ordered, 4);
+        }
+
+        uint32_t finite = 0, signedUnit = 0, unorm = 0, nonzero = 0, halfUnorm = 0, byteSum255 = 0;
+        uint32_t opaqueLast = 0, opaqueFirst = 0, byteMax = 0, differs = 0;
+        uint32_t first = count ? lane.raw[0] : 0;
+        for (size_t v = 0; v < count; v++) {
+            float f = lane.values[v];
+            uint32_t word = lane.raw[v];
+            float magnitude = std::fabs(f);
+            bool sane = f == 0.0f || (magnitude > 1e-30f && magnitude < 1e30f);
+            finite += sane;
+            signedUnit += sane && magnitude <= 1.0001f;
+            unorm += sane && f >= -0.01f && f <= 1.01f;
+            nonzero += word != 0;
+
+            // Half floats from 1/2048 to 1 are the bit patterns 0x1000 to 0x3C00; anything smaller is more likely a
+            // pair of small integers
+            uint32_t low = swap ? (word >> 8 & 0xFF) | (word & 0xFF) << 8 : word & 0xFFFF;
+            uint32_t high = swap ? (word >> 24) | (word >> 8 & 0xFF00) : word >> 16;
+            halfUnorm += (low == 0 || (low >= 0x1000 && low <= 0x3C00)) &&
+                         (high == 0 || (high >= 0x1000 && high <= 0x3C00));
+
+            uint32_t b0 = word & 0xFF, b1 = word >> 8 & 0xFF, b2 = word >> 16 & 0xFF, b3 = word >> 24;
+            uint32_t sum = b0 + b1 + b2 + b3;
+            byteSum255 += sum >= 254 && sum <= 256;
+            opaqueLast += b3 == 0xFF;
+            opaqueFirst += b0 == 0xFF;
+            byteMax = std::max(byteMax, std::max(std::max(b0, b1), std::max(b2, b3)));
+            differs |= word ^ first;
+        }
+
+        float n = count ? (float) count : 1.0f;
+        lane.finite = (float) finite / n;
+        lane.signedUnit = (float) signedUnit / n;
+        lane.unorm = (float) unorm / n;
+        lane.nonzero = (float) nonzero / n;
+        lane.halfUnorm = (float) halfUnorm / n;
+        lane.byteSum255 = (float) byteSum255 / n;
+        lane.opaqueLast = (float) opaqueLast / n;
+        lane.opaqueFirst = (float) opaqueFirst / n;
+        lane.byteMax = byteMax;
+        lane.constant = differs == 0;
+    }
+
+    // Fraction of vertices where lanes [first, first + 3) form a vector of length one
+    float unitLengthFraction(const std::vector<LaneStats>& lanes, size_t first)
+    {
+        const std::vector<float>& x = lanes[first].values;
+        const std::vector<float>& y = lanes[first + 1].values;
+        const std::vector<float>& z = lanes[first + 2].values;
+        uint32_t unit = 0;
+        for (size_t v = 0; v < x.size(); v++) {
+            float length = x[v] * x[v] + y[v] * y[v] + z[v] * z[v];
+            unit += length > 0.95f && length < 1.05f;
+        }
+        return x.empty() ? 0.0f : (float) unit / (float) x.size();
+    }
+
+    // Fraction of vertices where four lanes of non-negative floats add up to one
+    float weightSumFraction(const std::vector<LaneStats>& lanes, size_t first)
+    {
+        uint32_t normalized = 0;
+        size_t count = lanes[first].values.size();
+        for (size_t v = 0; v < count; v++) {
+            float a = lanes[first].values[v], b = lanes[first + 1].values[v];
+            float c = lanes[first + 2].values[v], d = lanes[first + 3].values[v];
+            float sum = a + b + c + d;
+            normalized += a >= 0.0f && b >= 0.0f && c >= 0.0f && d >= 0.0f && sum > 0.99f && sum < 1.01f;
+        }
+        return count ? (float) normalized / (float) count : 0.0f;
+    }
+
+    bool allAtLeast(const std::vector<LaneStats>& lanes, size_t first, size_t count, float LaneStats::*stat,
+                    float threshold)
+    {
+        if (first + count > lanes.size()) return false;
+        for (size_t i = first; i < first + count; i++) {
+            if (lanes[i].*stat < threshold) return false;
+        }
+        return true;
+    }
+
+    bool anyVaries(const std::vector<LaneStats>& lanes, size_t first, size_t count)
+    {
+        for (size_t i = first; i < first + count; i++) {
+            if (!lanes[i].constant) return true;
+        }
+        return false;
+    }
+
+    // The vertices to sample: every vertex an indexed draw can reach, otherwise the drawn range. The index buffer is
+    // read a chunk at a time, straight from the source unless a chunk straddles an edit.
+    uint64_t reachableVertices(const PieceSnapshot& data, const VisParams& params, const std::atomic<bool> *cancel)
+    {
+        if (!params.indexedDraw) return params.vertexCount;
+
+        constexpr uint64_t ChunkIndices = 256 << 10;
+        size_t size = data.size();
+        uint64_t width = params.halfWidthIndexes ? 2 : 4;
+        uint64_t start = params.indexBufferStart;
+        uint64_t count = std::min<uint64_t>(params.vertexCount, start < size ? (size - start) / width : 0);
+        uint32_t maxIndex = 0;
+        std::vector<uint8_t> scratch;
+        for (uint64_t first = 0; first < count; first += ChunkIndices) {
+            if (cancel && cancel->load(std::memory_order_relaxed)) return 0;
+            uint64_t chunk = std::min(ChunkIndices, count - first);
+            const uint8_t *p = data.contiguous((size_t) (start + first * width), (size_t) (chunk * width), scratch);
+            for (uint64_t k = 0; k < chunk; k++, p += width) {
+                uint32_t index;
+                if (width == 2) {
+                    index = params.bigEndian ? (uint32_t) (p[0] << 8 | p[1]) : (uint32_t) (p[0] | p[1] << 8);
+                } else {
+                    memcpy(&index, p, 4);
+                    if (params.bigEndian) index = swapWord(index);
+                }
+                maxIndex = std::max(maxIndex, index);
+            }
+        }
+        return count ? (uint64_t) maxIndex + 1 : 0;
+    }
+}
+
+const char *laneKindName(LaneKind kind)
+{
+    switch (kind) {
+        case LKPosition: return "Position";
+        case LKNormal: return "Normal";
+        case LKTexCoord: return "Texture Coordinates";
+        case LKColor: return "Color";
+        case LKBoneIndices: return "Bone Indices";
+        case LKBoneWeights: return "Bone Weights";
+        default: return "Unknown";
+    }
+}
+
+const char *laneFormatName(LaneFormat format)
+{
+    switch (format) {
+        case LFFloat: return "float";
+        case LFHalf: return "half";
+        case LFUnorm8: return "unorm8";
+        default: return "uint8";
+    }
+}
+
+void classifyLanes(const PieceSnapshot& data, const VisParams& params, std::vector<AttributeLane>& lanes,
+                   const std::atomic<bool> *cancel, uint32_t maxVertices)
+{
+    lanes.clear();
+    if (params.vertexStride < 16 || maxVertices == 0) return;
+
+    size_t size = data.size();
+    auto stride = (uint64_t) params.vertexStride;
+    uint64_t start = params.vertexBufferStart;
+    uint64_t vertices = reachableVertices(data, params, cancel);
+    if (start >= size || (cancel && cancel->load(std::memory_order_relaxed))) return;
+    vertices = std::min(vertices, (size - start) / stride);
+    if (vertices == 0) return;
+
+    uint64_t step = (vertices + maxVertices - 1) / maxVertices;
+    auto sampled = (size_t) ((vertices + step - 1) / step);
+    size_t laneCount = (size_t) (stride - 12) / 4;
+
+    // One read per sampled vertex of the bytes after its position, transposed into lanes
+    std::vector<LaneStats> stats(laneCount);
+    for (LaneStats& lane: stats) lane.raw.resize(sampled);
+    std::vector<uint8_t> tail(laneCount * 4);
+    for (size_t v = 0; v < sampled; v++) {
+        data.read((size_t) (start + v * step * stride + 12), tail.data(), tail.size());
+        for (size_t i = 0; i < laneCount; i++) memcpy(&stats[i].raw[v], &tail[i * 4], 4);
+    }
+    for (LaneStats& lane: stats) computeStats(lane, params.bigEndian);
+
+    for (size_t i = 0; i < laneCount;) {
+        auto offset = (uint32_t) (12 + i * 4);
+        const LaneStats& lane = stats[i];
+
+        // Checked roughly from most to least specific, since e.g. one-hot weights are also unit vectors
+        if (allAtLeast(stats, i, 4, &LaneStats::unorm, Strict) && anyVaries(stats, i, 4)) {
+            float fraction = weightSumFraction(stats, i);
+            if (fraction >= Loose) {
+                lanes.push_back({ offset, 4, LFFloat, LKBoneWeights, fraction });
+                i += 4;
+                continue;
+            }
+        }
+        if (allAtLeast(stats, i, 3, &LaneStats::signedUnit, Strict)) {
+            float fraction = unitLengthFraction(stats, i);
+            if (fraction >= Loose) {
+                lanes.push_back({ offset, 3, LFFloat, LKNormal, fraction });
+                i += 3;
+                continue;
+            }
+        }
+        // Half mantissas fill their low bytes, so varying halves reach past 127 somewhere
+        if (lane.halfUnorm >= Strict && lane.nonzero >= 0.5f && lane.byteMax >= 128) {
+            lanes.push_back({ offset, 2, LFHalf, LKTexCoord, lane.halfUnorm });
+            i += 1;
+            continue;
+        }
+        if (allAtLeast(stats, i, 2, &LaneStats::unorm, Loose) && anyVaries(stats, i, 2)) {
+            lanes.push_back({ offset, 2, LFFloat, LKTexCoord, std::min(lane.unorm, stats[i + 1].unorm) });
+            i += 2;
+            continue;
+        }
+        if (allAtLeast(stats, i, 3, &LaneStats::finite, Strict) && anyVaries(stats, i, 3) &&
+            !allAtLeast(stats, i, 3, &LaneStats::signedUnit, Strict)) {
+            lanes.push_back({ offset, 3, LFFloat, LKPosition, std::min({ lane.finite, stats[i + 1].finite,
+                                                                         stats[i + 2].finite }) });
+            i += 3;
+            continue;
+        }
+
+        // Nothing float-shaped, so try the lane as four bytes
+        if (lane.constant) {
+            if (lane.finite > 0.5f) lanes.push_back({ offset, 1, LFFloat, LKUnknown, 1.0f });
+            else lanes.push_back({ offset, 4, LFUint8, LKUnknown, 1.0f });
+        } else if (lane.byteSum255 >= Loose) {
+            lanes.push_back({ offset, 4, LFUnorm8, LKBoneWeights, lane.byteSum255 });
+        } else if (lane.byteMax < 128 && lane.finite < 0.5f) {
+            lanes.push_back({ offset, 4, LFUint8, LKBoneIndices, 1.0f - lane.finite });
+        } else if (std::max(lane.opaqueLast, lane.opaqueFirst) >= Loose || lane.finite < 0.5f) {
+            lanes.push_back({ offset, 4, LFUnorm8, LKColor,
+                              std::max({ lane.opaqueLast, lane.opaqueFirst, 1.0f - lane.finite }) });
+        } else {
+            lanes.push_back({ offset, 1, LFFloat, LKUnknown, lane.finite });
+        }
+        i += 1;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "piece_table.h"
+#include "vis_params.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum LaneKind
+{
+    LKUnknown,
+    LKPosition,
+    LKNormal,
+    LKTexCoord,
+    LKColor,
+    LKBoneIndices,
+    LKBoneWeights
+};
+
+enum LaneFormat
+{
+    LFFloat,
+    LFHalf,
+    LFUnorm8,
+    LFUint8
+};
+
+// A run of bytes within each vertex and what they most likely hold
+struct AttributeLane
+{
+    uint32_t offset;      // from the start of the vertex
+    uint32_t components;
+    LaneFormat format;
+    LaneKind kind;
+    float confidence;     // 0..1, the fraction of vertices agreeing with the label
+
+    uint32_t size() const { return components * (format == LFFloat ? 4 : format == LFHalf ? 2 : 1); }
+};
+
+const char *laneKindName(LaneKind kind);
+const char *laneFormatName(LaneFormat format);
+
+// Labels every 4-byte lane of the vertex after the 12-byte position, reading up to `maxVertices` vertices spread evenly
+// across the mesh. Floats are read in the layout's byte order, bytes in file order. Adjacent lanes are grouped when
+// they only make sense together, like the three components of a unit normal or the four bytes of a color.
+// Reads a snapshot so it can run on the pool; stops early with no lanes once `cancel` is set.
+void classifyLanes(const PieceSnapshot& data, const VisParams& params, std::vector<AttributeLane>& lanes,
+                   const std::atomic<bool> *cancel = nullptr, uint32_t maxVertices = 65536);
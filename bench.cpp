@@ -0,0 +1,228 @@
+// Throughput and accuracy of the decoding hot paths over a synthetic corpus.
+// Usage: hexspanned_bench [--size MiB] [--seed N] [--repeat N] [--json]
+#include "buffer_ops.h"
+#include "content_hash.h"
+#include "mesh_detect.h"
+#include "mesh_score.h"
+#include "pattern_search.h"
+#include "piece_table.h"
+#include "pointer_graph.h"
+#include "string_index.h"
+#include "synthetic_corpus.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    struct Options
+    {
+        size_t sizeMiB = 256;
+        uint64_t seed = 1;
+        int repeat = 5;
+        bool json = false;
+    };
+
+    struct Measurement
+    {
+        std::string name;
+        uint64_t bytes;
+        double seconds;  // best of all repeats
+
+        double gigabytesPerSecond() const { return seconds > 0.0 ? (double) bytes / seconds / 1e9 : 0.0; }
+    };
+
+    struct DetectionScore
+    {
+        size_t truth = 0;
+        size_t found = 0;
+        size_t matched = 0;
+        size_t indexedTruth = 0;
+        size_t indexMatched = 0;
+
+        double precision() const { return found ? (double) matched / (double) found : 1.0; }
+        double recall() const { return truth ? (double) matched / (double) truth : 1.0; }
+    };
+
+    bool parseOptions(int argc, char **argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--json") {
+                options.json = true;
+            } else if (arg == "--size" && hasValue) {
+                options.sizeMiB = std::stoul(argv[++i]);
+            } else if (arg == "--seed" && hasValue) {
+                options.seed = std::stoull(argv[++i]);
+            } else if (arg == "--repeat" && hasValue) {
+                options.repeat = std::max(1, std::stoi(argv[++i]));
+            } else {
+                std::cerr << "Usage: " << argv[0] << " [--size MiB] [--seed N] [--repeat N] [--json]" << std::endl;
+                return false;
+            }
+        }
+        return options.sizeMiB > 0;
+    }
+
+    Measurement measure(const std::string& name, uint64_t bytes, int repeat, const std::function<void()>& fn)
+    {
+        double best = 1e30;
+        for (int i = 0; i < repeat; i++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::min(best, elapsed.count());
+        }
+        return { name, bytes, best };
+    }
+
+    // A candidate finds a mesh when it reads the same layout from inside it, on a vertex boundary, and covers at least
+    // half of it. Each mesh is only counted once.
+    DetectionScore scoreDetection(const std::vector<EmbeddedMesh>& truth, const std::vector<MeshCandidate>& candidates)
+    {
+        DetectionScore score;
+        score.truth = truth.size();
+        score.found = candidates.size();
+
+        std::vector<bool> taken(truth.size());
+        for (const MeshCandidate& candidate: candidates) {
+            const VisParams& params = candidate.params;
+            uint64_t start = (uint64_t) params.vertexBufferStart;
+
+            for (size_t i = 0; i < truth.size(); i++) {
+                const EmbeddedMesh& mesh = truth[i];
+                uint64_t meshEnd = mesh.vertexStart + (uint64_t) mesh.vertexCount * mesh.stride;
+                if (taken[i] || (uint32_t) params.vertexStride != mesh.stride || params.bigEndian != mesh.bigEndian ||
+                    start < mesh.vertexStart || start >= meshEnd || (start - mesh.vertexStart) % mesh.stride != 0) {
+                    continue;
+                }
+
+                // Indexed candidates report index count, so coverage comes from the index buffer instead
+                uint64_t covered = params.indexedDraw ? (uint64_t) mesh.vertexCount
+                                                      : std::min<uint64_t>((uint64_t) params.vertexCount,
+                                                                           (meshEnd - start) / mesh.stride);
+                if (covered * 2 < mesh.vertexCount) continue;
+
+                taken[i] = true;
+                score.matched++;
+                if (mesh.indexed && params.indexedDraw && (uint64_t) params.indexBufferStart == mesh.indexStart &&
+                    params.halfWidthIndexes == mesh.halfWidthIndexes) {
+                    score.indexMatched++;
+                }
+                break;
+            }
+        }
+
+        for (const EmbeddedMesh& mesh: truth) score.indexedTruth += mesh.indexed;
+        return score;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) return 1;
+
+    SyntheticCorpus corpus;
+    generateCorpus(options.sizeMiB << 20, options.seed, corpus);
+    const uint8_t *data = corpus.bytes.data();
+    size_t size = corpus.bytes.size();
+
+    std::vector<Measurement> measurements;
+    std::vector<uint8_t> scratch(corpus.bytes);
+
+    measurements.push_back(measure("swap_words32", size, options.repeat, [&] {
+        swapWords32(scratch.data(), scratch.size());
+    }));
+
+    // Scattered edits so uploads cross many pieces, as they do after a session of patching
+    PieceTable table;
+    table.reset(data, size);
+    for (size_t offset = 4093; offset + 16 < size; offset += size / 1024) {
+        table.replace(offset, data + offset / 2, 16);
+    }
+    measurements.push_back(measure("prepare_upload", size, options.repeat, [&] {
+        constexpr size_t Window = 16 << 20;
+        for (size_t offset = 0; offset < size; offset += Window) prepareUpload(table, offset, Window, true, scratch);
+    }));
+
+    std::vector<uint64_t> matches;
+    bool markersFound = false;
+    measurements.push_back(measure("find_pattern", size, options.repeat, [&] {
+        findPattern(data, size, SyntheticMarker, sizeof(SyntheticMarker), matches);
+        markersFound = matches == corpus.markers;
+    }));
+    measurements.push_back(measure("find_float", size, options.repeat, [&] {
+        findFloat(data, size, 1.0f, 1e-6f, true, 4, matches);
+    }));
+
+    ContentDigest digest;
+    measurements.push_back(measure("digest_content", size, options.repeat, [&] {
+        digestContent(data, size, digest);
+    }));
+
+    PointerGraph graph;
+    measurements.push_back(measure("pointer_graph", size, options.repeat, [&] {
+        buildPointerGraph(data, size, graph);
+    }));
+
+    StringIndex strings;
+    measurements.push_back(measure("extract_strings", size, options.repeat, [&] {
+        extractStrings(data, size, strings);
+    }));
+
+    std::vector<MeshCandidate> candidates;
+    measurements.push_back(measure("detect_meshes", size, options.repeat, [&] {
+        detectMeshes(data, size, candidates);
+    }));
+    DetectionScore score = scoreDetection(corpus.meshes, candidates);
+
+    // Scoring is meant to sit inside search loops, so it's reported per candidate rather than per byte
+    std::vector<VisParams> layouts;
+    for (const MeshCandidate& candidate: candidates) {
+        if (candidate.params.indexedDraw) layouts.push_back(candidate.params);
+    }
+    std::vector<MeshScore> meshScores;
+    Measurement scoring = measure("score_meshes", 0, options.repeat, [&] {
+        scoreMeshes(data, size, layouts, meshScores);
+    });
+    double scoredPerSecond = scoring.seconds > 0.0 ? (double) layouts.size() / scoring.seconds : 0.0;
+
+    if (options.json) {
+        nlohmann::json out;
+        out["corpus"] = { { "bytes", size }, { "seed", options.seed }, { "meshes", corpus.meshes.size() },
+                          { "markers", corpus.markers.size() } };
+        out["repeat"] = options.repeat;
+        for (const Measurement& m: measurements) {
+            out["throughput"][m.name] = { { "bytes", m.bytes }, { "seconds", m.seconds },
+                                          { "gb_per_s", m.gigabytesPerSecond() } };
+        }
+        out["pattern_search"] = { { "all_markers_found", markersFound } };
+        out["detection"] = { { "truth", score.truth }, { "candidates", score.found }, { "matched", score.matched },
+                             { "precision", score.precision() }, { "recall", score.recall() },
+                             { "indexed_truth", score.indexedTruth }, { "index_matched", score.indexMatched } };
+        out["scoring"] = { { "candidates", layouts.size() }, { "seconds", scoring.seconds },
+                           { "per_second", scoredPerSecond } };
+        std::cout << out.dump(2) << std::endl;
+    } else {
+        printf("corpus: %zu MiB, seed %llu, %zu meshes, best of %d\n\n", options.sizeMiB,
+               (unsigned long long) options.seed, corpus.meshes.size(), options.repeat);
+        for (const Measurement& m: measurements) {
+            printf("%-16s %8.3f ms %8.2f GB/s\n", m.name.c_str(), m.seconds * 1000.0, m.gigabytesPerSecond());
+        }
+        printf("\nmarkers found:   %s\n", markersFound ? "all" : "MISMATCH");
+        printf("precision:       %.3f (%zu of %zu candidates)\n", score.precision(), score.matched, score.found);
+        printf("recall:          %.3f (%zu of %zu meshes)\n", score.recall(), score.matched, score.truth);
+        printf("indices paired:  %zu of %zu\n", score.indexMatched, score.indexedTruth);
+        printf("meshes scored:   %.0f per second (%zu indexed candidates)\n", scoredPerSecond, layouts.size());
+    }
+    return 0;
+}
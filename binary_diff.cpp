@@ -0,0 +1,302 @@
+#include "binary_diff.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <iterator>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define HEXSPANNED_SSE2 1
+#endif
+
+namespace
+{
+    // Length of the run both sides must share before they count as back in step
+    constexpr size_t AnchorSize = 16;
+
+    // Look-ahead windows tried in turn after a mismatch. Small edits resync within the first; the larger one catches
+    // inserted blocks without paying for it on every differing byte.
+    constexpr size_t ResyncWindows[] = { 4096, 256 * 1024 };
+    constexpr size_t LargestWindow = ResyncWindows[std::size(ResyncWindows) - 1];
+    constexpr int TableBits = 18;
+
+    inline uint64_t read64(const uint8_t *p)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        return v;
+    }
+
+    inline uint32_t anchorHash(const uint8_t *p)
+    {
+        uint64_t h = read64(p) * 0x9E3779B185EBCA87ULL ^ read64(p + 8) * 0xC2B2AE3D27D4EB4FULL;
+        return (uint32_t) (h >> (64 - TableBits));
+    }
+
+    // Looks for a pair of positions within `window` bytes where both sides share an anchor and skipping to it costs
+    // less than `bestCost`. Cost is the number of bytes skipped on both sides, so a replacement costs twice an
+    // insertion of the same length.
+    bool findResync(const uint8_t *left, size_t leftSize, const uint8_t *right, size_t rightSize, size_t window,
+                    std::vector<int32_t>& table, size_t& leftSkip, size_t& rightSkip, size_t& bestCost)
+    {
+        if (leftSize < AnchorSize || rightSize < AnchorSize) return false;
+        size_t leftEnd = std::min({ window, bestCost, leftSize - AnchorSize + 1 });
+        size_t rightEnd = std::min(window, rightSize - AnchorSize + 1);
+
+        // Only the first occurrence of each anchor is kept, which is also the cheapest, and keeps long runs of
+        // identical bytes from degenerating into quadratic chains
+        for (size_t i = 0; i < leftEnd; i++) {
+            int32_t& slot = table[anchorHash(left + i)];
+            if (slot < 0) slot = (int32_t) i;
+        }
+
+        bool found = false;
+        for (size_t j = 0; j < rightEnd && j < bestCost; j++) {
+            int32_t i = table[anchorHash(right + j)];
+            if (i < 0 || memcmp(left + i, right + j, AnchorSize) != 0) continue;
+
+            size_t cost = (size_t) i + j;
+            if (cost < bestCost) {
+                bestCost = cost;
+                leftSkip = (size_t) i;
+                rightSkip = j;
+                found = true;
+            }
+        }
+
+        // Clearing only the slots we set is far cheaper than wiping the table for every small difference
+        for (size_t i = 0; i < leftEnd; i++) {
+            table[anchorHash(left + i)] = -1;
+        }
+        return found;
+    }
+
+    // Distance to the next run of AnchorSize bytes that are equal at the same offset on both sides, i.e. where an
+    // in-place replacement ends. This is the common case and costs only the bytes it steps over.
+    bool findInStep(const uint8_t *left, const uint8_t *right, size_t limit, size_t& skip)
+    {
+        size_t run = 0;
+        for (size_t d = 0; d < limit; d++) {
+            run = left[d] == right[d] ? run + 1 : 0;
+            if (run == AnchorSize) {
+                skip = d + 1 - AnchorSize;
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+size_t mismatchLength(const uint8_t *a, const uint8_t *b, size_t size)
+{
+    size_t i = 0;
+#ifdef HEXSPANNED_SSE2
+    // Four vectors per iteration keep the loads ahead of the compares; the exact byte is found afterwards
+    for (; i + 64 <= size; i += 64) {
+        __m128i eq0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (a + i)),
+                                     _mm_loadu_si128((const __m128i *) (b + i)));
+        __m128i eq1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (a + i + 16)),
+                                     _mm_loadu_si128((const __m128i *) (b + i + 16)));
+        __m128i eq2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (a + i + 32)),
+                                     _mm_loadu_si128((const __m128i *) (b + i + 32)));
+        __m128i eq3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (a + i + 48)),
+                                     _mm_loadu_si128((const __m128i *) (b + i + 48)));
+        __m128i all = _mm_and_si128(_mm_and_si128(eq0, eq1), _mm_and_si128(eq2, eq3));
+        if (_mm_movemask_epi8(all) != 0xFFFF) break;
+    }
+    for (; i + 16 <= size; i += 16) {
+        __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) (a + i)),
+                                    _mm_loadu_si128((const __m128i *) (b + i)));
+        unsigned mask = (unsigned) _mm_movemask_epi8(eq);
+        if (mask != 0xFFFF) return i + (size_t) std::countr_zero(~mask);
+    }
+#endif
+    for (; i + 8 <= size; i += 8) {
+        uint64_t x = read64(a + i) ^ read64(b + i);
+        if (x) return i + (size_t) std::countr_zero(x) / 8;
+    }
+    for (; i < size; i++) {
+        if (a[i] != b[i]) return i;
+    }
+    return size;
+}
+
+bool diffBuffers(const uint8_t *left, size_t leftSize, const uint8_t *right, size_t rightSize,
+                 const std::function<void(const DiffRange&)>& emit, const std::atomic<bool> *cancel,
+                 std::atomic<uint64_t> *progress)
+{
+    std::vector<int32_t> table((size_t) 1 << TableBits, -1);
+    size_t i = 0, j = 0;
+    bool lastResyncFailed = false;
+
+    // Back-to-back ranges from a long run of differences are merged, so they're listed and navigated as one
+    DiffRange pending {};
+    bool hasPending = false;
+    auto add = [&](const DiffRange& range) {
+        if (hasPending && pending.leftOffset + pending.leftLength == range.leftOffset &&
+            pending.rightOffset + pending.rightLength == range.rightOffset) {
+            pending.leftLength += range.leftLength;
+            pending.rightLength += range.rightLength;
+            return;
+        }
+        if (hasPending) emit(pending);
+        pending = range;
+        hasPending = true;
+    };
+
+    while (i < leftSize && j < rightSize) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) return false;
+        if (progress) progress->store(i, std::memory_order_relaxed);
+
+        // Matching stretches are the bulk of a typical diff, compare them in large slices
+        size_t common = mismatchLength(left + i, right + j, std::min<size_t>(leftSize - i, rightSize - j));
+        i += common;
+        j += common;
+        if (i == leftSize || j == rightSize) break;
+
+        size_t leftSkip = 0, rightSkip = 0, bestCost = SIZE_MAX;
+        bool found = false;
+        size_t inStepLimit = std::min({ ResyncWindows[0], leftSize - i, rightSize - j });
+        if (findInStep(left + i, right + j, inStepLimit, leftSkip)) {
+            rightSkip = leftSkip;
+            bestCost = leftSkip * 2;
+            found = true;
+        }
+
+        // An insertion or removal may still be cheaper; each window only searches as far as could beat the best so
+        // far, and stops once the windows already searched cover everything that could. Inside a region that is
+        // different throughout, the large window is skipped until something matches.
+        size_t searched = 0;
+        for (size_t window: ResyncWindows) {
+            if (bestCost <= searched || (lastResyncFailed && window != ResyncWindows[0])) break;
+            found |= findResync(left + i, leftSize - i, right + j, rightSize - j, window, table, leftSkip, rightSkip,
+                                bestCost);
+            searched = window;
+        }
+
+        if (found) {
+            add({ i, leftSkip, j, rightSkip });
+            i += leftSkip;
+            j += rightSkip;
+        } else {
+            // Nothing in common nearby; report the searched span in step and try again after it
+            size_t step = std::min({ lastResyncFailed ? ResyncWindows[0] : LargestWindow, leftSize - i,
+                                     rightSize - j });
+            add({ i, step, j, step });
+            i += step;
+            j += step;
+        }
+        lastResyncFailed = !found;
+    }
+
+    if (i < leftSize || j < rightSize) {
+        add({ i, leftSize - i, j, rightSize - j });
+    }
+    if (hasPending) emit(pending);
+    if (progress) progress->store(leftSize);
+    return true;
+}
+
+BinaryDiff::~BinaryDiff()
+{
+    cancel();
+}
+
+void BinaryDiff::start(std::shared_ptr<const MappedFile> left, std::shared_ptr<const MappedFile> right)
+{
+    cancel();
+    ranges_.clear();
+    lastHit_ = 0;
+
+    auto job = std::make_shared<Job>();
+    job->size = left->size();
+    job_ = job;
+
+    // The job owns both mappings, so closing either file in the UI can't pull the bytes out from under it
+    workerPool().submit([job, left = std::move(left), right = std::move(right)] {
+        std::vector<DiffRange> batch;
+        auto flush = [&] {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->pending.insert(job->pending.end(), batch.begin(), batch.end());
+            batch.clear();
+        };
+
+        diffBuffers(left->data(), left->size(), right->data(), right->size(), [&](const DiffRange& range) {
+            batch.push_back(range);
+            if (batch.size() >= 1024) flush();
+        }, &job->cancelled, &job->progress);
+
+        flush();
+        job->done = true;
+    });
+}
+
+void BinaryDiff::cancel()
+{
+    if (job_) {
+        job_->cancelled = true;
+        job_.reset();
+    }
+}
+
+void BinaryDiff::clear()
+{
+    cancel();
+    std::vector<DiffRange>().swap(ranges_);
+    lastHit_ = 0;
+}
+
+void BinaryDiff::poll()
+{
+    if (!job_) return;
+
+    bool done = job_->done;
+    {
+        std::lock_guard<std::mutex> lock(job_->mutex);
+        ranges_.insert(ranges_.end(), job_->pending.begin(), job_->pending.end());
+        job_->pending.clear();
+    }
+    if (done) job_.reset();
+}
+
+float BinaryDiff::progress() const
+{
+    if (!job_) return 1.0f;
+    return job_->size ? (float) ((double) job_->progress.load() / (double) job_->size) : 1.0f;
+}
+
+namespace
+{
+    inline uint64_t rangeStart(const DiffRange& range, int side)
+    {
+        return side == 0 ? range.leftOffset : range.rightOffset;
+    }
+
+    inline uint64_t rangeLength(const DiffRange& range, int side)
+    {
+        return side == 0 ? range.leftLength : range.rightLength;
+    }
+}
+
+bool BinaryDiff::contains(int side, uint64_t offset) const
+{
+    if (ranges_.empty()) return false;
+
+    if (lastHit_ < ranges_.size()) {
+        const DiffRange& hit = ranges_[lastHit_];
+        if (offset >= rangeStart(hit, side) && offset - rangeStart(hit, side) < rangeLength(hit, side)) return true;
+    }
+
+    // Ranges are emitted in order on both sides, so either side's offsets are sorted
+    auto it = std::upper_bound(ranges_.begin(), ranges_.end(), offset, [side](uint64_t value, const DiffRange& range) {
+        return value < rangeStart(range, side);
+    });
+    if (it == ranges_.begin()) return false;
+    --it;
+    if (offset - rangeStart(*it, side) >= rangeLength(*it, side)) return false;
+
+    lastHit_ = (size_t) (it - ranges_.begin());
+    return true;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// One region that differs between the two sides. A zero length on one side is a pure insertion on the other.
+struct DiffRange
+{
+    uint64_t leftOffset;
+    uint64_t leftLength;
+    uint64_t rightOffset;
+    uint64_t rightLength;
+};
+
+// Number of leading bytes `a` and `b` have in common, compared 16 bytes at a time where SSE2 is available
+size_t mismatchLength(const uint8_t *a, const uint8_t *b, size_t size);
+
+// Walks both buffers in step, reporting each differing region to `emit` in order. After a mismatch it looks ahead for
+// a short run present in both sides, so inserted or removed bytes only cost one range instead of shifting the rest
+// of the file out of line. `progress` receives the left offset reached so far.
+bool diffBuffers(const uint8_t *left, size_t leftSize, const uint8_t *right, size_t rightSize,
+                 const std::function<void(const DiffRange&)>& emit, const std::atomic<bool> *cancel = nullptr,
+                 std::atomic<uint64_t> *progress = nullptr);
+
+// Compares two mapped files on the worker pool. Ranges become visible as they are found, so the first differences of
+// a large file can be browsed while the rest is still being compared.
+class BinaryDiff
+{
+public:
+    BinaryDiff() = default;
+    ~BinaryDiff();
+
+    BinaryDiff(const BinaryDiff&) = delete;
+    BinaryDiff& operator=(const BinaryDiff&) = delete;
+
+    void start(std::shared_ptr<const MappedFile> left, std::shared_ptr<const MappedFile> right);
+    void cancel();
+
+    // Cancels any comparison still running and frees the ranges found
+    void clear();
+
+    // Moves newly found ranges into ranges(), call once per frame
+    void poll();
+
+    bool isRunning() const { return job_ != nullptr; }
+    float progress() const;
+
+    const std::vector<DiffRange>& ranges() const { return ranges_; }
+
+    // O(log ranges), with the last hit cached since the hex view asks about neighbouring bytes
+    bool contains(int side, uint64_t offset) const;
+
+private:
+    struct Job
+    {
+        std::mutex mutex;
+        std::vector<DiffRange> pending;
+        std::atomic<bool> cancelled = false;
+        std::atomic<bool> done = false;
+        std::atomic<uint64_t> progress = 0;
+        uint64_t size = 0;
+    };
+
+    std::shared_ptr<Job> job_;
+    std::vector<DiffRange> ranges_;
+    mutable size_t lastHit_ = 0;
+};
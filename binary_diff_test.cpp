@@ -0,0 +1,73 @@
+// Regression checks for diffBuffers' resynchronisation. Exits non-zero on the first wrong diff.
+#include "binary_diff.h"
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+    std::vector<DiffRange> diff(const std::vector<uint8_t>& left, const std::vector<uint8_t>& right)
+    {
+        std::vector<DiffRange> ranges;
+        diffBuffers(left.data(), left.size(), right.data(), right.size(),
+                    [&](const DiffRange& range) { ranges.push_back(range); });
+        return ranges;
+    }
+
+    std::vector<uint8_t> randomBytes(size_t size, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        std::vector<uint8_t> bytes(size);
+        for (uint8_t& b: bytes) b = (uint8_t) rng();
+        return bytes;
+    }
+
+    bool expect(const char *name, const std::vector<DiffRange>& ranges, const std::vector<DiffRange>& expected)
+    {
+        bool same = ranges.size() == expected.size();
+        for (size_t k = 0; same && k < ranges.size(); k++) {
+            same = ranges[k].leftOffset == expected[k].leftOffset && ranges[k].leftLength == expected[k].leftLength &&
+                   ranges[k].rightOffset == expected[k].rightOffset && ranges[k].rightLength == expected[k].rightLength;
+        }
+        if (same) return true;
+
+        std::printf("FAIL %s:", name);
+        for (const DiffRange& range: ranges) {
+            std::printf(" L %llx+%llu R %llx+%llu", (unsigned long long) range.leftOffset,
+                        (unsigned long long) range.leftLength, (unsigned long long) range.rightOffset,
+                        (unsigned long long) range.rightLength);
+        }
+        std::printf("\n");
+        return false;
+    }
+}
+
+int main()
+{
+    bool ok = true;
+
+    std::vector<uint8_t> left = randomBytes(0x2000, 1);
+    std::vector<uint8_t> right = left;
+    right[0x100] ^= 0xFF;
+    right[0x101] ^= 0xFF;
+    ok &= expect("replacement", diff(left, right), { { 0x100, 2, 0x100, 2 } });
+
+    right = left;
+    right.insert(right.begin() + 0x400, { 1, 2, 3 });
+    ok &= expect("insertion", diff(left, right), { { 0x400, 0, 0x400, 3 } });
+
+    right = left;
+    right.erase(right.begin() + 0x400, right.begin() + 0x410);
+    ok &= expect("removal", diff(left, right), { { 0x400, 16, 0x400, 0 } });
+
+    // Shifted by one, the zero run lines up in step long before the insertion is noticed; the insertion is still
+    // the cheaper explanation and must win
+    std::fill(left.begin() + 0x3E8, left.begin() + 0x500, 0);
+    right = left;
+    right.insert(right.begin() + 0x1F4, 0x5A);
+    ok &= expect("insertion before a zero run", diff(left, right), { { 0x1F4, 0, 0x1F4, 1 } });
+
+    std::printf(ok ? "All diff checks passed\n" : "Some diff checks failed\n");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,46 @@
+#include "buffer_ops.h"
+
+#include <algorithm>
+#include <cstring>
+
+void swapWords32(uint8_t *data, size_t size)
+{
+    // Plain shifts on whole words; compilers turn this loop into vector shuffles
+    size_t words = size / 4;
+    for (size_t i = 0; i < words; i++) {
+        uint32_t v;
+        memcpy(&v, data + i * 4, 4);
+        v = (v >> 24) | ((v >> 8) & 0x0000FF00u) | ((v << 8) & 0x00FF0000u) | (v << 24);
+        memcpy(data + i * 4, &v, 4);
+    }
+}
+
+namespace
+{
+    template<class Source>
+    size_t copyForUpload(const Source& source, size_t offset, size_t length, bool bigEndian, std::vector<uint8_t>& out)
+    {
+        size_t begin = bigEndian ? offset & ~(size_t) 3 : offset;
+        size_t end = std::min(source.size(), offset + length);
+        if (begin >= end) {
+            out.clear();
+            return begin;
+        }
+
+        out.resize(end - begin);
+        source.read(begin, out.data(), out.size());
+        if (bigEndian) swapWords32(out.data(), out.size());
+        return begin;
+    }
+}
+
+size_t prepareUpload(const PieceTable& table, size_t offset, size_t length, bool bigEndian, std::vector<uint8_t>& out)
+{
+    return copyForUpload(table, offset, length, bigEndian, out);
+}
+
+size_t prepareUpload(const PieceSnapshot& snapshot, size_t offset, size_t length, bool bigEndian,
+                     std::vector<uint8_t>& out)
+{
+    return copyForUpload(snapshot, offset, length, bigEndian, out);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "piece_table.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Reverses the bytes of every whole 4-byte word, which is how big-endian files are made readable to the GPU
+void swapWords32(uint8_t *data, size_t size);
+
+// Copies [offset, offset + length) of `table` into `out`, ready for glBufferData/glBufferSubData.
+// When bigEndian the copy starts on a word boundary so the swaps line up with the start of the file; `out` then
+// begins at the returned offset rather than `offset`.
+size_t prepareUpload(const PieceTable& table, size_t offset, size_t length, bool bigEndian, std::vector<uint8_t>& out);
+
+// The same from a snapshot, for staging uploads on worker threads
+size_t prepareUpload(const PieceSnapshot& snapshot, size_t offset, size_t length, bool bigEndian,
+                     std::vector<uint8_t>& out);
@@ -0,0 +1,105 @@
+#include "chunk_tree.h"
+
+#include <algorithm>
+
+uint64_t packTag(const char *tag, uint32_t width)
+{
+    uint64_t packed = 0;
+    for (uint32_t i = 0; i < width && tag[i]; i++) packed |= (uint64_t) (uint8_t) tag[i] << (i * 8);
+    return packed;
+}
+
+std::string tagText(uint64_t tag, uint32_t width)
+{
+    std::string text;
+    for (uint32_t i = 0; i < width; i++) {
+        char c = (char) (tag >> (i * 8));
+        text.push_back(c >= 0x20 && c < 0x7F ? c : '.');
+    }
+    return text;
+}
+
+bool readChunk(const PieceTable& table, const ChunkFormat& format, uint64_t offset, uint64_t limit, Chunk& chunk)
+{
+    uint32_t header = format.headerWidth();
+    if (offset + header > limit || header > 16) return false;
+
+    uint8_t bytes[16];
+    if (table.read(offset, bytes, header) != header) return false;
+
+    const uint8_t *tagBytes = bytes + (format.sizeFirst ? format.sizeWidth : 0);
+    const uint8_t *sizeBytes = bytes + (format.sizeFirst ? 0 : format.tagWidth);
+    chunk.tag = 0;
+    for (uint32_t i = 0; i < format.tagWidth; i++) chunk.tag |= (uint64_t) tagBytes[i] << (i * 8);
+    uint64_t size = 0;
+    for (uint32_t i = 0; i < format.sizeWidth; i++) {
+        uint32_t shift = format.bigEndian ? format.sizeWidth - 1 - i : i;
+        size |= (uint64_t) sizeBytes[i] << (shift * 8);
+    }
+    if (format.sizeIncludesHeader) {
+        if (size < header) return false;
+        size -= header;
+    }
+
+    chunk.offset = offset;
+    chunk.payload = offset + header;
+    chunk.container = std::find(format.containerTags.begin(), format.containerTags.end(), chunk.tag) !=
+                      format.containerTags.end();
+    chunk.formType = 0;
+
+    uint64_t room = limit - chunk.payload;
+    chunk.truncated = size > room;
+    chunk.size = std::min(size, room);
+
+    uint64_t align = std::max<uint32_t>(format.alignment, 1);
+    uint64_t end = chunk.payload + chunk.size;
+    end += std::min<uint64_t>(format.trailerWidth, limit - end);
+    end = std::min(limit, (end + align - 1) / align * align);
+    chunk.end = end;
+
+    if (chunk.container && chunk.size >= format.formTypeWidth && format.formTypeWidth <= 8) {
+        uint8_t form[8];
+        table.read(chunk.payload, form, format.formTypeWidth);
+        for (uint32_t i = 0; i < format.formTypeWidth; i++) chunk.formType |= (uint64_t) form[i] << (i * 8);
+        chunk.payload += format.formTypeWidth;
+        chunk.size -= format.formTypeWidth;
+    }
+    return true;
+}
+
+void ChunkTree::reset(const PieceTable *table, const ChunkFormat& format, uint64_t start, uint64_t end)
+{
+    table_ = table;
+    format_ = format;
+    start_ = start;
+    end_ = table ? std::min<uint64_t>(end, table->size()) : 0;
+    revision_ = table ? table->revision() : 0;
+    parsed_ = 0;
+    levels_.clear();
+}
+
+ChunkTree::Level& ChunkTree::level(uint64_t begin, uint64_t end, size_t wanted)
+{
+    auto [it, inserted] = levels_.try_emplace(begin);
+    Level& level = it->second;
+    if (inserted) {
+        level.next = begin;
+        level.end = end;
+        level.complete = begin >= end;
+    }
+
+    while (!level.complete && level.chunks.size() < wanted) {
+        Chunk chunk;
+        if (!table_ || !readChunk(*table_, format_, level.next, level.end, chunk)) {
+            // Trailing bytes shorter than the alignment are padding, anything longer isn't a chunk
+            level.malformed = level.end - level.next >= std::max<uint32_t>(format_.alignment, 1);
+            level.complete = true;
+            break;
+        }
+        level.chunks.push_back(chunk);
+        level.next = chunk.end;
+        level.complete = chunk.end >= level.end || chunk.end <= chunk.offset;
+        parsed_++;
+    }
+    return level;
+}
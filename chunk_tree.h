@@ -0,0 +1,81 @@
+#pragma once
+
+#include "piece_table.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// How a (tag, size, payload) container lays out its chunk headers
+struct ChunkFormat
+{
+    uint32_t tagWidth = 4;            // 0 to 8 bytes
+    uint32_t sizeWidth = 4;           // 1, 2, 4 or 8 bytes
+    bool bigEndian = false;           // of the size field
+    bool sizeFirst = false;           // size before tag, as in PNG
+    bool sizeIncludesHeader = false;
+    uint32_t alignment = 2;           // chunks start on multiples of this from their parent's payload, 1 for packed
+    uint32_t trailerWidth = 0;        // bytes after each payload not counted in its size, like PNG's CRC
+    uint32_t formTypeWidth = 4;       // bytes at the start of a container's payload naming its contents
+    std::vector<uint64_t> containerTags;  // tags, packed as by packTag, whose payloads hold more chunks
+
+    uint32_t headerWidth() const { return tagWidth + sizeWidth; }
+};
+
+// The first `width` bytes of `tag` in file order, packed into an integer the way chunk tags are compared
+uint64_t packTag(const char *tag, uint32_t width);
+
+// Tag bytes as text, with anything unprintable shown as '.'
+std::string tagText(uint64_t tag, uint32_t width);
+
+struct Chunk
+{
+    uint64_t offset;   // of the header
+    uint64_t payload;  // of the payload, past a container's form type
+    uint64_t size;     // payload bytes, clamped to the parent
+    uint64_t end;      // where the next sibling starts
+    uint64_t tag;
+    uint64_t formType; // containers only
+    bool container;
+    bool truncated;    // the declared size ran past the parent's end
+};
+
+// Reads the chunk header at `offset` within a parent ending at `limit`. False when no whole header fits.
+bool readChunk(const PieceTable& table, const ChunkFormat& format, uint64_t offset, uint64_t limit, Chunk& chunk);
+
+// A chunk hierarchy parsed only as far as it's looked at: each level is read from its start on request, a few
+// siblings at a time, so opening a file with millions of chunks costs one header per visible row.
+class ChunkTree
+{
+public:
+    struct Level
+    {
+        std::vector<Chunk> chunks;
+        uint64_t next = 0;      // offset of the first unparsed sibling
+        uint64_t end = 0;
+        bool complete = false;
+        bool malformed = false; // stopped at bytes that can't hold a chunk
+        size_t shown = 0;       // how many the view asked for so far
+    };
+
+    void reset(const PieceTable *table, const ChunkFormat& format, uint64_t start, uint64_t end);
+
+    // Children of the payload [begin, end), parsed until at least `wanted` are known or the level ends
+    Level& level(uint64_t begin, uint64_t end, size_t wanted);
+    Level& root(size_t wanted) { return level(start_, end_, wanted); }
+
+    const ChunkFormat& format() const { return format_; }
+    uint64_t revision() const { return revision_; }
+    size_t parsedCount() const { return parsed_; }
+
+private:
+    const PieceTable *table_ = nullptr;
+    ChunkFormat format_;
+    uint64_t start_ = 0;
+    uint64_t end_ = 0;
+    uint64_t revision_ = 0;
+    size_t parsed_ = 0;
+    std::unordered_map<uint64_t, Level> levels_;  // by payload offset
+};
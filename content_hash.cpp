@@ -0,0 +1,201 @@
+#include "content_hash.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    constexpr uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t Prime3 = 0x165667B19E3779F9ULL;
+    constexpr uint64_t Prime4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr uint64_t Prime5 = 0x27D4EB2F165667C5ULL;
+
+    inline uint64_t rotl(uint64_t x, int r)
+    {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    // Files are hashed as little-endian words, which is every host we build for
+    inline uint64_t read64(const uint8_t *p)
+    {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        return v;
+    }
+
+    inline uint32_t read32(const uint8_t *p)
+    {
+        uint32_t v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    inline uint64_t round(uint64_t acc, uint64_t input)
+    {
+        acc += input * Prime2;
+        acc = rotl(acc, 31);
+        return acc * Prime1;
+    }
+
+    inline uint64_t mergeRound(uint64_t acc, uint64_t val)
+    {
+        acc ^= round(0, val);
+        return acc * Prime1 + Prime4;
+    }
+
+    uint8_t blockEntropy(const uint8_t *data, size_t size)
+    {
+        if (size == 0) return 0;
+
+        // Four interleaved tables avoid store-to-load stalls on runs of the same byte
+        uint32_t counts[4][256] = {};
+        size_t i = 0;
+        for (; i + 4 <= size; i += 4) {
+            counts[0][data[i]]++;
+            counts[1][data[i + 1]]++;
+            counts[2][data[i + 2]]++;
+            counts[3][data[i + 3]]++;
+        }
+        for (; i < size; i++) {
+            counts[0][data[i]]++;
+        }
+
+        double entropy = 0.0;
+        for (int b = 0; b < 256; b++) {
+            uint32_t count = counts[0][b] + counts[1][b] + counts[2][b] + counts[3][b];
+            if (count == 0) continue;
+            double p = (double) count / (double) size;
+            entropy -= p * std::log2(p);
+        }
+        return (uint8_t) std::lround(entropy / 8.0 * 255.0);
+    }
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed)
+{
+    const uint8_t *p = (const uint8_t *) data;
+    const uint8_t *end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + Prime1 + Prime2;
+        uint64_t v2 = seed + Prime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - Prime1;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p + 32 <= end);
+
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = seed + Prime5;
+    }
+
+    h += (uint64_t) size;
+
+    while (p + 8 <= end) {
+        h ^= round(0, read64(p));
+        h = rotl(h, 27) * Prime1 + Prime4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t) read32(p) * Prime1;
+        h = rotl(h, 23) * Prime2 + Prime3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * Prime5;
+        h = rotl(h, 11) * Prime1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= Prime2;
+    h ^= h >> 29;
+    h *= Prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t combineBlockHashes(const std::vector<uint64_t>& blockHashes, uint64_t size)
+{
+    return hashBytes(blockHashes.data(), blockHashes.size() * sizeof(uint64_t), size);
+}
+
+bool digestContent(const uint8_t *data, size_t size, ContentDigest& digest, const std::atomic<bool> *cancel,
+                   const ContentDigest *previous)
+{
+    size_t blockSize = digest.blockSize;
+    size_t blockCount = (size + blockSize - 1) / blockSize;
+
+    digest.size = size;
+    digest.blockHashes.assign(blockCount, 0);
+    digest.blockEntropy.assign(blockCount, 0);
+
+    if (previous && previous->blockSize != digest.blockSize) previous = nullptr;
+
+    // A few blocks per task keeps scheduling overhead negligible without starving threads near the end
+    workerPool().parallelFor(blockCount, 4, [&](size_t begin, size_t end) {
+        for (size_t block = begin; block < end; block++) {
+            if (cancel && cancel->load(std::memory_order_relaxed)) return;
+
+            size_t offset = block * blockSize;
+            size_t length = std::min(blockSize, size - offset);
+            uint64_t hash = hashBytes(data + offset, length);
+            digest.blockHashes[block] = hash;
+
+            // Hashing is several times cheaper than counting, so unchanged blocks of a rewritten file cost little
+            bool unchanged = previous && block < previous->blockHashes.size() &&
+                             previous->blockHashes[block] == hash &&
+                             std::min<uint64_t>(blockSize, previous->size - offset) == length;
+            digest.blockEntropy[block] = unchanged ? previous->blockEntropy[block] : blockEntropy(data + offset, length);
+        }
+    });
+
+    if (cancel && cancel->load()) return false;
+
+    digest.hash = combineBlockHashes(digest.blockHashes, size);
+    return true;
+}
+
+std::vector<ByteRange> changedRanges(const ContentDigest& before, const ContentDigest& after)
+{
+    std::vector<ByteRange> ranges;
+    if (before.blockSize != after.blockSize) {
+        ranges.push_back({ 0, std::max(before.size, after.size) });
+        return ranges;
+    }
+
+    uint64_t blockSize = after.blockSize;
+    uint64_t end = std::max(before.size, after.size);
+    size_t blockCount = std::max(before.blockHashes.size(), after.blockHashes.size());
+
+    for (size_t block = 0; block < blockCount; block++) {
+        // A block that was the partial tail before can hash differently just because it grew, which is a change too
+        bool same = block < before.blockHashes.size() && block < after.blockHashes.size() &&
+                    before.blockHashes[block] == after.blockHashes[block] &&
+                    std::min(blockSize, before.size - block * blockSize) ==
+                    std::min(blockSize, after.size - block * blockSize);
+        if (same) continue;
+
+        uint64_t offset = block * blockSize;
+        uint64_t length = std::min(blockSize, end - offset);
+        if (!ranges.empty() && ranges.back().offset + ranges.back().length == offset) {
+            ranges.back().length += length;
+        } else {
+            ranges.push_back({ offset, length });
+        }
+    }
+    return ranges;
+}
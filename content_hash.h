@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// XXH64-compatible hash of a single buffer
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
+
+// Whole-file hash built from independently hashed blocks, so it parallelizes and changed blocks can be located later.
+// Byte entropy per block is gathered in the same pass for the overview minimap.
+struct ContentDigest
+{
+    static constexpr uint32_t DefaultBlockSize = 1 << 20;
+
+    uint64_t hash = 0;
+    uint64_t size = 0;
+    uint32_t blockSize = DefaultBlockSize;
+    std::vector<uint64_t> blockHashes;
+    std::vector<uint8_t> blockEntropy;  // Shannon entropy scaled from 0..8 bits to 0..255
+};
+
+// A span of file bytes, used to report what changed between two digests
+struct ByteRange
+{
+    uint64_t offset;
+    uint64_t length;
+};
+
+// Hashes `data` across the worker pool. Returns false if `cancel` was raised before finishing.
+// Blocks whose hash matches `previous` reuse its entropy instead of recounting.
+bool digestContent(const uint8_t *data, size_t size, ContentDigest& digest,
+                   const std::atomic<bool> *cancel = nullptr, const ContentDigest *previous = nullptr);
+
+// Byte ranges whose blocks differ between two digests of the same file, adjacent blocks merged.
+// Growth or truncation shows up as a range covering the tail.
+std::vector<ByteRange> changedRanges(const ContentDigest& before, const ContentDigest& after);
+
+// Combines block hashes into the whole-file hash
+uint64_t combineBlockHashes(const std::vector<uint64_t>& blockHashes, uint64_t size);
@@ -0,0 +1,122 @@
+#include "document.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+bool Document::open(const std::string& name)
+{
+    auto newFile = std::make_shared<MappedFile>();
+    if (!newFile->open(name)) return false;
+
+    file = std::move(newFile);
+    path = name;
+    table.reset(file->data(), file->size(), file);
+    generation++;
+    return true;
+}
+
+void Document::close()
+{
+    table.reset(nullptr, 0);
+    file.reset();
+    path.clear();
+}
+
+void Document::reload(std::shared_ptr<const MappedFile> newFile)
+{
+    file = std::move(newFile);
+    table.reset(file->data(), file->size(), file);
+    generation++;
+}
+
+bool Document::save()
+{
+    if (!isOpen()) return false;
+
+    // Pure overwrites leave the original bytes where they were, so only the patched ranges hit the disk. Not while a
+    // snapshot or a job (digest, detection, the diff view) is reading the mapping, though: patching it would change
+    // bytes underneath them. Besides those, only this document and its table hold it.
+    if (table.size() == file->size() && table.isLayoutPreserved() && !table.isSnapshotHeld() &&
+        file.use_count() <= 2) {
+        return saveInPlace();
+    }
+
+    // Otherwise stream into a sibling file and swap it in. The old mapping stays valid for whoever is still reading
+    // it, and the edits stay in place until the new file is there to open.
+    std::string tempName = path + ".hexspanned-tmp";
+    std::error_code ec;
+    if (!writeTo(tempName)) {
+        std::filesystem::remove(tempName, ec);
+        return false;
+    }
+
+    std::filesystem::rename(tempName, path, ec);
+    if (ec) {
+        std::cerr << "Error replacing " << path << ": " << ec.message() << std::endl;
+        std::filesystem::remove(tempName, ec);
+        return false;
+    }
+
+    std::string name = path;
+    return open(name);
+}
+
+bool Document::saveAs(const std::string& name)
+{
+    if (!isOpen()) return false;
+
+    std::error_code ec;
+    if (std::filesystem::equivalent(name, path, ec)) return save();
+
+    if (!writeTo(name)) return false;
+    return open(name);
+}
+
+bool Document::saveInPlace()
+{
+    std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+    if (!out.is_open()) {
+        std::cerr << "Error opening file for writing: " << path << std::endl;
+        return false;
+    }
+
+    const auto& pieces = table.pieces();
+    for (size_t i = 0; i < pieces.size(); i++) {
+        if (pieces[i].source != PieceTable::SourceAdded) continue;
+
+        out.seekp((std::streamoff) table.pieceOffset(i));
+        out.write((const char *) table.pieceData(pieces[i]), (std::streamsize) pieces[i].length);
+    }
+    out.close();
+
+    if (!out) {
+        std::cerr << "Error writing file: " << path << std::endl;
+        return false;
+    }
+
+    // The mapping now shows the patched bytes, so the edits can be folded back into a single original piece
+    table.reset(file->data(), file->size(), file);
+    generation++;
+    return true;
+}
+
+bool Document::writeTo(const std::string& name) const
+{
+    std::ofstream out(name, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error opening file for writing: " << name << std::endl;
+        return false;
+    }
+
+    table.forEachSpan(0, table.size(), [&](const uint8_t *span, size_t length) {
+        out.write((const char *) span, (std::streamsize) length);
+    });
+    out.close();
+
+    if (!out) {
+        std::cerr << "Error writing file: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
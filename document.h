@@ -0,0 +1,37 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "piece_table.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// A file opened for viewing and patching: the mapped original plus the edits made on top of it.
+struct Document
+{
+    std::string path;
+    std::shared_ptr<const MappedFile> file;  // shared with background jobs still reading the original bytes
+    PieceTable table;
+    uint64_t generation = 0;  // bumped whenever the bytes behind `file` change: opens, reloads and saves in place
+
+    bool open(const std::string& name);
+    void close();
+
+    // Switches to a fresh mapping of the same file after it changed on disk. Any unsaved edits are dropped.
+    void reload(std::shared_ptr<const MappedFile> newFile);
+
+    // Writes the edits back to `path`. Saving commits the undo history.
+    bool save();
+
+    // Streams the edited contents to `name` and continues editing that file.
+    bool saveAs(const std::string& name);
+
+    size_t size() const { return table.size(); }
+    bool isOpen() const { return file != nullptr; }
+    bool isModified() const { return table.isModified(); }
+
+private:
+    bool saveInPlace();
+    bool writeTo(const std::string& name) const;
+};
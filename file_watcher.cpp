@@ -0,0 +1,121 @@
+#include "file_watcher.h"
+
+#include <filesystem>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Writers often emit many small writes; only report once they've stopped for this long
+    constexpr auto SettleTime = std::chrono::milliseconds(250);
+    constexpr auto StatInterval = std::chrono::milliseconds(500);
+}
+
+FileWatcher::~FileWatcher()
+{
+    unwatch();
+}
+
+void FileWatcher::watch(const std::string& path)
+{
+    unwatch();
+
+    std::filesystem::path fsPath(path);
+    path_ = path;
+    name_ = fsPath.filename().string();
+    pending_ = false;
+
+    std::error_code ec;
+    statSize_ = std::filesystem::file_size(fsPath, ec);
+    statTime_ = std::filesystem::last_write_time(fsPath, ec).time_since_epoch().count();
+    lastStat_ = std::chrono::steady_clock::now();
+
+#ifdef __linux__
+    // Watch the directory rather than the file, so tools that write a temporary file and rename it over ours are seen
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd_ >= 0) {
+        std::string directory = fsPath.has_parent_path() ? fsPath.parent_path().string() : ".";
+        if (inotify_add_watch(fd_, directory.c_str(), IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) < 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+#endif
+}
+
+void FileWatcher::unwatch()
+{
+#ifdef __linux__
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+#endif
+    path_.clear();
+    pending_ = false;
+}
+
+FileChange FileWatcher::poll()
+{
+    if (path_.empty()) return FCNone;
+
+    auto now = std::chrono::steady_clock::now();
+    bool changed;
+#ifdef __linux__
+    changed = fd_ >= 0 ? readEvents() : statChanged();
+#else
+    changed = statChanged();
+#endif
+
+    if (changed) {
+        pending_ = true;
+        lastEvent_ = now;
+    }
+
+    if (pending_ && now - lastEvent_ >= SettleTime) {
+        pending_ = false;
+        return FCSettled;
+    }
+    return pending_ ? FCPending : FCNone;
+}
+
+bool FileWatcher::readEvents()
+{
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    bool changed = false;
+
+    while (true) {
+        ssize_t length = read(fd_, buffer, sizeof(buffer));
+        if (length <= 0) break;
+
+        for (char *p = buffer; p < buffer + length;) {
+            auto *event = (inotify_event *) p;
+            if (event->len > 0 && name_ == event->name) changed = true;
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+    return changed;
+#else
+    return false;
+#endif
+}
+
+bool FileWatcher::statChanged()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastStat_ < StatInterval) return false;
+    lastStat_ = now;
+
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path_, ec);
+    if (ec) return false;
+    int64_t time = std::filesystem::last_write_time(path_, ec).time_since_epoch().count();
+    if (ec) return false;
+
+    if (size == statSize_ && time == statTime_) return false;
+    statSize_ = size;
+    statTime_ = time;
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+enum FileChange
+{
+    FCNone,
+    FCPending,  // the file is being written to; wait for the writer to finish
+    FCSettled   // the file changed and has been quiet for a moment
+};
+
+// Notices when another program rewrites a file, either in place or by replacing it.
+// Uses inotify on Linux and falls back to polling size and modification time elsewhere.
+class FileWatcher
+{
+public:
+    FileWatcher() = default;
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    void watch(const std::string& path);
+    void unwatch();
+
+    // Non-blocking, call once per frame
+    FileChange poll();
+
+private:
+    bool readEvents();
+    bool statChanged();
+
+    std::string path_;
+    std::string name_;
+    bool pending_ = false;
+    std::chrono::steady_clock::time_point lastEvent_;
+    std::chrono::steady_clock::time_point lastStat_;
+    uint64_t statSize_ = 0;
+    int64_t statTime_ = 0;
+#ifdef __linux__
+    int fd_ = -1;
+#endif
+};
@@ -2,16 +2,22 @@
 
 // from https://github.com/AirGuanZ/imgui-filebrowser
 // MIT licensed.
+// Patched for hexspanned: directories are listed on a background thread and streamed in, and the list is clipped.
+// Patched for hexspanned: type-to-filter box with fuzzy subsequence matching.
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cctype>
+#include <climits>
 #include <cstring>
 #include <filesystem>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 #ifndef IMGUI_VERSION
@@ -54,6 +60,8 @@ namespace ImGui
 
         FileBrowser& operator=(const FileBrowser& copyFrom);
 
+        ~FileBrowser();
+
         // set the window position (in pixels)
         // default is centered
         void SetWindowPos(int posX, int posY) noexcept;
@@ -74,6 +82,9 @@ namespace ImGui
         // the browsing window is opened or not
         bool IsOpened() const noexcept;
 
+        // a directory listing is still arriving from the background thread
+        bool IsListing() const noexcept;
+
         // display the browsing window if opened
         void Display();
 
@@ -146,12 +157,44 @@ namespace ImGui
             std::filesystem::path name;
             std::string showName;
             std::filesystem::path extension;
+            std::string searchName; // lower-cased filename for the fuzzy filter
+        };
+
+        struct FilterMatch
+        {
+            unsigned int index;
+            int score;
+        };
+
+        // records produced by the background listing thread, handed over in batches
+        struct AsyncListing
+        {
+            std::mutex mutex;
+            std::vector<FileRecord> pending;
+            std::string error;
+            bool done = false;
+            std::atomic<bool> cancelled { false };
         };
 
         static std::string ToLower(const std::string& s);
 
+        static bool IsRecordLess(const FileRecord& L, const FileRecord& R);
+
+        static void ListDirectory(
+            AsyncListing& listing, std::filesystem::directory_iterator it, ImGuiFileBrowserFlags flags);
+
         void UpdateFileRecords();
 
+        void CancelFileRecordsUpdate();
+
+        void PollFileRecords();
+
+        void UpdateVisibleRecords();
+
+        void UpdateFilteredRecords(bool narrowing);
+
+        static int FuzzyScore(std::string_view pattern, std::string_view name);
+
         void SetCurrentDirectoryUncatched(const std::filesystem::path& pwd);
 
         bool IsExtensionMatched(const std::filesystem::path& extension) const;
@@ -196,6 +239,16 @@ namespace ImGui
         unsigned int rangeSelectionStart_; // enable range selection when shift is pressed
 
         std::vector<FileRecord> fileRecords_;
+        std::shared_ptr<AsyncListing> listing_;
+
+        // indices into fileRecords_ passing the type filters, then the subset matching the fuzzy filter, so the list can
+        // be clipped
+        std::vector<unsigned int> typeFilteredRecords_;
+        std::vector<unsigned int> visibleRecords_;
+        bool visibleRecordsDirty_ = true;
+
+        InputNameBuffer filterBuf_ = {};
+        std::string appliedFilter_;
 
         // IMPROVE: truncate when selectedFilename_.length() > inputNameBuf_.size() - 1
         std::unique_ptr<InputNameBuffer> inputNameBuf_;
@@ -266,7 +319,11 @@ inline ImGui::FileBrowser& ImGui::FileBrowser::operator=(
     selectedFilenames_ = copyFrom.selectedFilenames_;
     rangeSelectionStart_ = copyFrom.rangeSelectionStart_;
 
+    // an in-progress listing isn't shared; the copy keeps whatever has arrived so far
+    CancelFileRecordsUpdate();
     fileRecords_ = copyFrom.fileRecords_;
+    visibleRecordsDirty_ = true;
+    filterBuf_ = copyFrom.filterBuf_;
 
     *inputNameBuf_ = *copyFrom.inputNameBuf_;
 
@@ -283,6 +340,11 @@ inline ImGui::FileBrowser& ImGui::FileBrowser::operator=(
     return *this;
 }
 
+inline ImGui::FileBrowser::~FileBrowser()
+{
+    CancelFileRecordsUpdate();
+}
+
 inline void ImGui::FileBrowser::SetWindowPos(int posX, int posY) noexcept
 {
     posX_ = posX;
@@ -326,8 +388,15 @@ inline bool ImGui::FileBrowser::IsOpened() const noexcept
     return isOpened_;
 }
 
+inline bool ImGui::FileBrowser::IsListing() const noexcept
+{
+    return listing_ != nullptr;
+}
+
 inline void ImGui::FileBrowser::Display()
 {
+    PollFileRecords();
+
     PushID(this);
     ScopeGuard exitThis([this] {
         shouldOpen_ = false;
@@ -488,6 +557,25 @@ inline void ImGui::FileBrowser::Display()
         }
     }
 
+    // type-to-filter box. extending the text only narrows the previous matches instead of rescanning everything
+
+    // save dialogs start in the filename box instead, so only open dialogs take the keyboard here
+
+    PushItemWidth(-1);
+    if (IsWindowAppearing() && !(flags_ & ImGuiFileBrowserFlags_EnterNewFilename)) {
+        SetKeyboardFocusHere();
+    }
+    if (InputTextWithHint("##filter", "filter", filterBuf_.data(), filterBuf_.size())) {
+        const std::string filter = ToLower(filterBuf_.data());
+        const bool narrowing = !appliedFilter_.empty() && filter.size() > appliedFilter_.size() &&
+                               filter.compare(0, appliedFilter_.size(), appliedFilter_) == 0;
+        if (!visibleRecordsDirty_) {
+            UpdateFilteredRecords(narrowing);
+        }
+    }
+    focusOnInputText |= IsItemFocused();
+    PopItemWidth();
+
     // browse files in a child window
 
     float reserveHeight = GetFrameHeightWithSpacing();
@@ -502,20 +590,15 @@ inline void ImGui::FileBrowser::Display()
                    (flags_ & ImGuiFileBrowserFlags_NoModal) ? ImGuiWindowFlags_AlwaysHorizontalScrollbar : 0);
         ScopeGuard endChild([] { EndChild(); });
 
-        const bool shouldHideRegularFiles =
-            (flags_ & ImGuiFileBrowserFlags_HideRegularFiles) && (flags_ & ImGuiFileBrowserFlags_SelectDirectory);
+        if (visibleRecordsDirty_) {
+            UpdateVisibleRecords();
+        }
 
-        for (unsigned int rscIndex = 0; rscIndex < fileRecords_.size(); ++rscIndex) {
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(visibleRecords_.size()));
+        while (clipper.Step()) for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            const unsigned int rscIndex = visibleRecords_[row];
             const auto& rsc = fileRecords_[rscIndex];
-            if (!rsc.isDir && shouldHideRegularFiles) {
-                continue;
-            }
-            if (!rsc.isDir && !IsExtensionMatched(rsc.extension)) {
-                continue;
-            }
-            if (!rsc.name.empty() && rsc.name.c_str()[0] == '$') {
-                continue;
-            }
 
             const bool selected = selectedFilenames_.find(rsc.name) != selectedFilenames_.end();
             if (Selectable(rsc.showName.c_str(), selected, ImGuiSelectableFlags_DontClosePopups)) {
@@ -532,17 +615,24 @@ inline void ImGui::FileBrowser::Display()
                     IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows);
 
                 if (rangeSelect) {
-                    const unsigned int first = (std::min)(rangeSelectionStart_, rscIndex);
-                    const unsigned int last = (std::max)(rangeSelectionStart_, rscIndex);
+                    // the range runs over the rows as shown, filtered and in score order. an anchor the filter
+                    // hides selects from the clicked row alone
+                    const auto anchor =
+                        std::find(visibleRecords_.begin(), visibleRecords_.end(), rangeSelectionStart_);
+                    const int anchorRow =
+                        anchor != visibleRecords_.end() ? static_cast<int>(anchor - visibleRecords_.begin()) : row;
+                    const int first = (std::min)(anchorRow, row);
+                    const int last = (std::max)(anchorRow, row);
                     selectedFilenames_.clear();
-                    for (unsigned int i = first; i <= last; ++i) {
-                        if (fileRecords_[i].isDir != wantDir) {
+                    for (int r = first; r <= last; ++r) {
+                        const auto& record = fileRecords_[visibleRecords_[r]];
+                        if (record.isDir != wantDir || record.name == "..") {
                             continue;
                         }
-                        if (!wantDir && !IsExtensionMatched(fileRecords_[i].extension)) {
+                        if (!wantDir && !IsExtensionMatched(record.extension)) {
                             continue;
                         }
-                        selectedFilenames_.insert(fileRecords_[i].name);
+                        selectedFilenames_.insert(record.name);
                     }
                 } else if (selected) {
                     if (!multiSelect) {
@@ -611,9 +701,10 @@ inline void ImGui::FileBrowser::Display()
         if (selectAll) {
             const bool needDir = flags_ & ImGuiFileBrowserFlags_SelectDirectory;
             selectedFilenames_.clear();
-            for (size_t i = 1; i < fileRecords_.size(); ++i) {
-                auto& record = fileRecords_[i];
-                if (record.isDir == needDir &&
+            // Only the rows the filter leaves visible, like shift-select
+            for (const unsigned int rscIndex: visibleRecords_) {
+                auto& record = fileRecords_[rscIndex];
+                if (record.isDir == needDir && record.name != ".." &&
                     (needDir || IsExtensionMatched(record.extension))) {
                     selectedFilenames_.insert(record.name);
                 }
@@ -651,6 +742,9 @@ inline void ImGui::FileBrowser::Display()
     if (!statusStr_.empty() && !(flags_ & ImGuiFileBrowserFlags_NoStatusBar)) {
         SameLine();
         Text("%s", statusStr_.c_str());
+    } else if (listing_ && !(flags_ & ImGuiFileBrowserFlags_NoStatusBar)) {
+        SameLine();
+        Text("loading... (%u)", static_cast<unsigned int>(fileRecords_.size() - 1));
     }
 
     if (!typeFilters_.empty()) {
@@ -664,6 +758,7 @@ inline void ImGui::FileBrowser::Display()
                 bool selected = i == typeFilterIndex_;
                 if (Selectable(typeFilters_[i].c_str(), selected) && !selected) {
                     typeFilterIndex_ = static_cast<unsigned int>(i);
+                    visibleRecordsDirty_ = true;
                 }
             }
         }
@@ -779,11 +874,13 @@ inline void ImGui::FileBrowser::SetTypeFilters(const std::vector<std::string>& _
 
     std::copy(typeFilters.begin(), typeFilters.end(), std::back_inserter(typeFilters_));
     typeFilterIndex_ = 0;
+    visibleRecordsDirty_ = true;
 }
 
 inline void ImGui::FileBrowser::SetCurrentTypeFilterIndex(int index)
 {
     typeFilterIndex_ = static_cast<unsigned int>(index);
+    visibleRecordsDirty_ = true;
 }
 
 inline void ImGui::FileBrowser::SetInputName(std::string_view input)
@@ -808,46 +905,253 @@ inline std::string ImGui::FileBrowser::ToLower(const std::string& s)
     return ret;
 }
 
-inline void ImGui::FileBrowser::UpdateFileRecords()
+inline bool ImGui::FileBrowser::IsRecordLess(const FileRecord& L, const FileRecord& R)
 {
-    fileRecords_ = { FileRecord { true, "..", "[D] ..", "" } };
+    return (L.isDir ^ R.isDir) ? L.isDir : (L.name < R.name);
+}
 
-    for (auto& p: std::filesystem::directory_iterator(currentDirectory_)) {
-        FileRecord rcd;
+inline void ImGui::FileBrowser::ListDirectory(
+    AsyncListing& listing, std::filesystem::directory_iterator it, ImGuiFileBrowserFlags flags)
+{
+    constexpr size_t BATCH_SIZE = 256;
 
-        try {
-            if (p.is_regular_file()) {
-                rcd.isDir = false;
-            } else if (p.is_directory()) {
-                rcd.isDir = true;
-            } else {
-                continue;
+    std::vector<FileRecord> batch;
+    auto flush = [&] {
+        std::lock_guard<std::mutex> lock(listing.mutex);
+        std::move(batch.begin(), batch.end(), std::back_inserter(listing.pending));
+        batch.clear();
+    };
+
+    try {
+        // entry type queries may stat, which is the slow part on network mounts
+        for (; it != std::filesystem::directory_iterator(); ++it) {
+            if (listing.cancelled) {
+                return;
             }
 
-            rcd.name = p.path().filename();
-            if (rcd.name.empty()) {
+            const auto& p = *it;
+            FileRecord rcd;
+
+            try {
+                if (p.is_regular_file()) {
+                    rcd.isDir = false;
+                } else if (p.is_directory()) {
+                    rcd.isDir = true;
+                } else {
+                    continue;
+                }
+
+                rcd.name = p.path().filename();
+                if (rcd.name.empty()) {
+                    continue;
+                }
+
+                rcd.extension = p.path().filename().extension();
+                rcd.showName = (rcd.isDir ? "[D] " : "[F] ") + u8StrToStr(p.path().filename().u8string());
+                rcd.searchName = ToLower(u8StrToStr(p.path().filename().u8string()));
+            }
+            catch (...) {
+                if (!(flags & ImGuiFileBrowserFlags_SkipItemsCausingError)) {
+                    throw;
+                }
                 continue;
             }
 
-            rcd.extension = p.path().filename().extension();
-            rcd.showName = (rcd.isDir ? "[D] " : "[F] ") + u8StrToStr(p.path().filename().u8string());
-        }
-        catch (...) {
-            if (!(flags_ & ImGuiFileBrowserFlags_SkipItemsCausingError)) {
-                throw;
+            batch.push_back(std::move(rcd));
+            if (batch.size() >= BATCH_SIZE) {
+                flush();
             }
+        }
+    }
+    catch (const std::exception& err) {
+        std::lock_guard<std::mutex> lock(listing.mutex);
+        listing.error = err.what();
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(listing.mutex);
+        listing.error = "unknown";
+    }
+
+    flush();
+    std::lock_guard<std::mutex> lock(listing.mutex);
+    listing.done = true;
+}
+
+inline void ImGui::FileBrowser::UpdateFileRecords()
+{
+    CancelFileRecordsUpdate();
+
+    fileRecords_ = { FileRecord { true, "..", "[D] ..", "", ".." } };
+    visibleRecordsDirty_ = true;
+    ClearRangeSelectionState();
+
+    // opening the directory stays synchronous so an unreadable path still throws to SetCurrentDirectory
+    std::filesystem::directory_iterator it(currentDirectory_);
+
+    // the thread only touches the shared listing, so it can be abandoned without joining
+    auto listing = std::make_shared<AsyncListing>();
+    listing_ = listing;
+    std::thread([listing, it = std::move(it), flags = flags_]() mutable {
+        ListDirectory(*listing, std::move(it), flags);
+    }).detach();
+}
+
+inline void ImGui::FileBrowser::CancelFileRecordsUpdate()
+{
+    if (listing_) {
+        listing_->cancelled = true;
+        listing_.reset();
+    }
+}
+
+inline void ImGui::FileBrowser::PollFileRecords()
+{
+    if (!listing_) {
+        return;
+    }
+
+    std::vector<FileRecord> batch;
+    std::string error;
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(listing_->mutex);
+        batch.swap(listing_->pending);
+        error = listing_->error;
+        done = listing_->done;
+    }
+
+    if (!batch.empty()) {
+        // sort only the new arrivals and merge them in, instead of resorting everything each frame
+        std::sort(batch.begin(), batch.end(), IsRecordLess);
+        const auto mid = static_cast<std::ptrdiff_t>(fileRecords_.size());
+        std::move(batch.begin(), batch.end(), std::back_inserter(fileRecords_));
+        std::inplace_merge(fileRecords_.begin(), fileRecords_.begin() + mid, fileRecords_.end(), IsRecordLess);
+
+        visibleRecordsDirty_ = true;
+        ClearRangeSelectionState();
+    }
+
+    if (!error.empty()) {
+        statusStr_ = "last error: " + error;
+    }
+
+    if (done) {
+        listing_.reset();
+    }
+}
+
+inline void ImGui::FileBrowser::UpdateVisibleRecords()
+{
+    const bool shouldHideRegularFiles =
+        (flags_ & ImGuiFileBrowserFlags_HideRegularFiles) && (flags_ & ImGuiFileBrowserFlags_SelectDirectory);
+
+    typeFilteredRecords_.clear();
+    for (unsigned int rscIndex = 0; rscIndex < fileRecords_.size(); ++rscIndex) {
+        const auto& rsc = fileRecords_[rscIndex];
+        if (!rsc.isDir && shouldHideRegularFiles) {
+            continue;
+        }
+        if (!rsc.isDir && !IsExtensionMatched(rsc.extension)) {
             continue;
         }
+        if (!rsc.name.empty() && rsc.name.c_str()[0] == '$') {
+            continue;
+        }
+        typeFilteredRecords_.push_back(rscIndex);
+    }
 
-        fileRecords_.push_back(rcd);
+    visibleRecordsDirty_ = false;
+    UpdateFilteredRecords(false);
+}
+
+inline void ImGui::FileBrowser::UpdateFilteredRecords(bool narrowing)
+{
+    const std::string filter = ToLower(filterBuf_.data());
+    appliedFilter_ = filter;
+
+    if (filter.empty()) {
+        visibleRecords_ = typeFilteredRecords_;
+        return;
     }
 
-    std::sort(
-        fileRecords_.begin(), fileRecords_.end(), [](const FileRecord& L, const FileRecord& R) {
-            return (L.isDir ^ R.isDir) ? L.isDir : (L.name < R.name);
-        });
+    // a longer query can only match a subset of what the shorter one matched
+    std::vector<unsigned int> candidates = narrowing ? visibleRecords_ : typeFilteredRecords_;
 
-    ClearRangeSelectionState();
+    auto scoreRange = [&](size_t first, size_t last, std::vector<FilterMatch>& out) {
+        for (size_t i = first; i < last; ++i) {
+            const unsigned int rscIndex = candidates[i];
+            const auto& rsc = fileRecords_[rscIndex];
+            const int score = rsc.name == ".." ? INT_MAX : FuzzyScore(filter, rsc.searchName);
+            if (score >= 0) {
+                out.push_back({ rscIndex, score });
+            }
+        }
+    };
+
+    // huge listings are scored in parallel slices; each slice keeps its matches in listing order
+    constexpr size_t PARALLEL_THRESHOLD = 16384;
+    const size_t threadCount = candidates.size() >= PARALLEL_THRESHOLD
+                               ? (std::max)(1u, std::thread::hardware_concurrency()) : 1;
+    std::vector<std::vector<FilterMatch>> slices(threadCount);
+    if (threadCount == 1) {
+        scoreRange(0, candidates.size(), slices[0]);
+    } else {
+        std::vector<std::thread> threads;
+        const size_t sliceSize = (candidates.size() + threadCount - 1) / threadCount;
+        for (size_t t = 0; t < threadCount; ++t) {
+            const size_t first = (std::min)(t * sliceSize, candidates.size());
+            const size_t last = (std::min)(first + sliceSize, candidates.size());
+            threads.emplace_back([&, first, last, t] { scoreRange(first, last, slices[t]); });
+        }
+        for (auto& thread: threads) {
+            thread.join();
+        }
+    }
+
+    std::vector<FilterMatch> matches;
+    for (auto& slice: slices) {
+        matches.insert(matches.end(), slice.begin(), slice.end());
+    }
+    std::stable_sort(matches.begin(), matches.end(), [](const FilterMatch& L, const FilterMatch& R) {
+        return L.score > R.score;
+    });
+
+    visibleRecords_.clear();
+    for (const auto& match: matches) {
+        visibleRecords_.push_back(match.index);
+    }
+}
+
+// scores `pattern` as a subsequence of `name`, both lower-case. returns -1 when it doesn't match.
+// consecutive characters and characters starting a word score higher, and shorter names win ties.
+inline int ImGui::FileBrowser::FuzzyScore(std::string_view pattern, std::string_view name)
+{
+    int score = 0;
+    size_t patternIndex = 0;
+    size_t previousMatch = std::string_view::npos;
+
+    for (size_t i = 0; i < name.size() && patternIndex < pattern.size(); ++i) {
+        if (name[i] != pattern[patternIndex]) {
+            continue;
+        }
+
+        int bonus = 1;
+        if (previousMatch != std::string_view::npos && previousMatch + 1 == i) {
+            bonus += 5;
+        }
+        if (i == 0 || !std::isalnum(static_cast<unsigned char>(name[i - 1]))) {
+            bonus += 8;
+        }
+
+        score += bonus;
+        previousMatch = i;
+        ++patternIndex;
+    }
+
+    if (patternIndex < pattern.size()) {
+        return -1;
+    }
+    return (std::max)(0, score * 16 - static_cast<int>(name.size() - pattern.size()));
 }
 
 inline void ImGui::FileBrowser::SetCurrentDirectoryUncatched(const std::filesystem::path& pwd)
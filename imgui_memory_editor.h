@@ -1,5 +1,6 @@
 // Patched for hexspanned! Don't update it!
 // Patched to make the editor read-only while still allowing highlighting a position.
+// Patched to edit bytes in place again, but only through WriteFn (the hexspanned document layer).
 
 // Mini memory editor for Dear ImGui (to embed in your game/tools)
 // Get latest version at http://www.github.com/ocornut/imgui_club
@@ -106,10 +107,12 @@ struct MemoryEditor
     size_t DataPreviewAddr;
     size_t DataEditingAddr;
     bool DataEditingTakeFocus;
+    bool DataEditingActive;
     char DataInputBuf[32];
     char AddrInputBuf[32];
     size_t GotoAddr;
     size_t HighlightMin, HighlightMax;
+    size_t HoveredAddr;             // byte under the mouse in the hex column after the last draw, or -1
     int PreviewEndianness;
     ImGuiDataType PreviewDataType;
 
@@ -137,10 +140,12 @@ struct MemoryEditor
         ContentsWidthChanged = false;
         DataPreviewAddr = DataEditingAddr = (size_t) -1;
         DataEditingTakeFocus = false;
+        DataEditingActive = false;
         memset(DataInputBuf, 0, sizeof(DataInputBuf));
         memset(AddrInputBuf, 0, sizeof(AddrInputBuf));
         GotoAddr = (size_t) -1;
         HighlightMin = HighlightMax = (size_t) -1;
+        HoveredAddr = (size_t) -1;
         PreviewEndianness = 0;
         PreviewDataType = ImGuiDataType_S32;
     }
@@ -225,6 +230,7 @@ struct MemoryEditor
         ImU8 *mem_data = (ImU8 *) mem_data_void;
         Sizes s;
         CalcSizes(s, mem_size, base_display_addr);
+        HoveredAddr = (size_t) -1;
         ImGuiStyle& style = ImGui::GetStyle();
 
         const ImVec2 contents_pos_start = ImGui::GetCursorScreenPos();
@@ -335,7 +341,62 @@ struct MemoryEditor
                     // NB: The trailing space is not visible but ensure there's no gap that the mouse cannot click on.
                     ImU8 b = ReadFn ? ReadFn(mem_data, addr) : mem_data[addr];
 
-                    if (OptShowHexII) {
+                    if (WriteFn && DataEditingAddr == addr && (DataEditingTakeFocus || DataEditingActive)) {
+                        // Display text input on current byte. Unlike upstream, losing focus keeps the byte highlighted.
+                        bool data_write = false;
+                        ImGui::PushID((void *) addr);
+                        if (DataEditingTakeFocus) {
+                            ImGui::SetKeyboardFocusHere(0);
+                            ImSnprintf(DataInputBuf, 32, format_byte, b);
+                        }
+                        struct UserData
+                        {
+                            static int Callback(ImGuiInputTextCallbackData *data)
+                            {
+                                UserData *user_data = (UserData *) data->UserData;
+                                if (!data->HasSelection()) {
+                                    user_data->CursorPos = data->CursorPos;
+                                }
+                                if (data->SelectionStart == 0 && data->SelectionEnd == data->BufTextLen) {
+                                    // When not editing a byte, always refresh its InputText content pulled from underlying memory data
+                                    data->DeleteChars(0, data->BufTextLen);
+                                    data->InsertChars(0, user_data->CurrentBufOverwrite);
+                                    data->SelectionStart = 0;
+                                    data->SelectionEnd = 2;
+                                    data->CursorPos = 0;
+                                }
+                                return 0;
+                            }
+
+                            char CurrentBufOverwrite[3]; // Input
+                            int CursorPos;               // Output
+                        };
+                        UserData user_data;
+                        user_data.CursorPos = -1;
+                        ImSnprintf(user_data.CurrentBufOverwrite, 3, format_byte, b);
+                        ImGuiInputTextFlags flags =
+                            ImGuiInputTextFlags_CharsHexadecimal | ImGuiInputTextFlags_EnterReturnsTrue |
+                            ImGuiInputTextFlags_AutoSelectAll | ImGuiInputTextFlags_NoHorizontalScroll |
+                            ImGuiInputTextFlags_CallbackAlways | ImGuiInputTextFlags_AlwaysOverwrite;
+                        ImGui::SetNextItemWidth(s.GlyphWidth * 2);
+                        if (ImGui::InputText("##data", DataInputBuf, IM_ARRAYSIZE(DataInputBuf), flags,
+                                             UserData::Callback, &user_data)) {
+                            data_write = data_next = true;
+                        }
+                        DataEditingActive = DataEditingTakeFocus || ImGui::IsItemActive();
+                        DataEditingTakeFocus = false;
+                        if (user_data.CursorPos >= 2) {
+                            data_write = data_next = true;
+                        }
+                        if (data_editing_addr_next != (size_t) -1) {
+                            data_write = data_next = false;
+                        }
+                        unsigned int data_input_value = 0;
+                        if (data_write && sscanf(DataInputBuf, "%X", &data_input_value) == 1) {
+                            WriteFn(mem_data, addr, (ImU8) data_input_value);
+                        }
+                        ImGui::PopID();
+                    } else if (OptShowHexII) {
                         if ((b >= 32 && b < 128)) {
                             ImGui::Text(".%c ", b);
                         } else if (b == 0xFF && OptGreyOutZeroes) {
@@ -352,6 +413,9 @@ struct MemoryEditor
                             ImGui::Text(format_byte_space, b);
                         }
                     }
+                    if (ImGui::IsItemHovered()) {
+                        HoveredAddr = addr;
+                    }
                     if (!ReadOnly && ImGui::IsItemHovered() && ImGui::IsMouseClicked(0)) {
                         DataEditingTakeFocus = true;
                         data_editing_addr_next = addr;
@@ -0,0 +1,245 @@
+#include "input_recording.h"
+
+#include <GLFW/glfw3.h>
+#include <nlohmann/json.hpp>
+
+#include <cfloat>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+
+namespace
+{
+    constexpr int Version = 1;
+
+    struct KeyMapping
+    {
+        int glfw;
+        ImGuiKey imgui;
+    };
+
+    // Keys outside the contiguous letter, digit and function key ranges
+    const KeyMapping keyMappings[] = {
+        { GLFW_KEY_TAB, ImGuiKey_Tab },
+        { GLFW_KEY_LEFT, ImGuiKey_LeftArrow },
+        { GLFW_KEY_RIGHT, ImGuiKey_RightArrow },
+        { GLFW_KEY_UP, ImGuiKey_UpArrow },
+        { GLFW_KEY_DOWN, ImGuiKey_DownArrow },
+        { GLFW_KEY_PAGE_UP, ImGuiKey_PageUp },
+        { GLFW_KEY_PAGE_DOWN, ImGuiKey_PageDown },
+        { GLFW_KEY_HOME, ImGuiKey_Home },
+        { GLFW_KEY_END, ImGuiKey_End },
+        { GLFW_KEY_INSERT, ImGuiKey_Insert },
+        { GLFW_KEY_DELETE, ImGuiKey_Delete },
+        { GLFW_KEY_BACKSPACE, ImGuiKey_Backspace },
+        { GLFW_KEY_SPACE, ImGuiKey_Space },
+        { GLFW_KEY_ENTER, ImGuiKey_Enter },
+        { GLFW_KEY_ESCAPE, ImGuiKey_Escape },
+        { GLFW_KEY_APOSTROPHE, ImGuiKey_Apostrophe },
+        { GLFW_KEY_COMMA, ImGuiKey_Comma },
+        { GLFW_KEY_MINUS, ImGuiKey_Minus },
+        { GLFW_KEY_PERIOD, ImGuiKey_Period },
+        { GLFW_KEY_SLASH, ImGuiKey_Slash },
+        { GLFW_KEY_SEMICOLON, ImGuiKey_Semicolon },
+        { GLFW_KEY_EQUAL, ImGuiKey_Equal },
+        { GLFW_KEY_LEFT_BRACKET, ImGuiKey_LeftBracket },
+        { GLFW_KEY_BACKSLASH, ImGuiKey_Backslash },
+        { GLFW_KEY_RIGHT_BRACKET, ImGuiKey_RightBracket },
+        { GLFW_KEY_GRAVE_ACCENT, ImGuiKey_GraveAccent },
+        { GLFW_KEY_CAPS_LOCK, ImGuiKey_CapsLock },
+        { GLFW_KEY_SCROLL_LOCK, ImGuiKey_ScrollLock },
+        { GLFW_KEY_NUM_LOCK, ImGuiKey_NumLock },
+        { GLFW_KEY_PRINT_SCREEN, ImGuiKey_PrintScreen },
+        { GLFW_KEY_PAUSE, ImGuiKey_Pause },
+        { GLFW_KEY_KP_DECIMAL, ImGuiKey_KeypadDecimal },
+        { GLFW_KEY_KP_DIVIDE, ImGuiKey_KeypadDivide },
+        { GLFW_KEY_KP_MULTIPLY, ImGuiKey_KeypadMultiply },
+        { GLFW_KEY_KP_SUBTRACT, ImGuiKey_KeypadSubtract },
+        { GLFW_KEY_KP_ADD, ImGuiKey_KeypadAdd },
+        { GLFW_KEY_KP_ENTER, ImGuiKey_KeypadEnter },
+        { GLFW_KEY_KP_EQUAL, ImGuiKey_KeypadEqual },
+        { GLFW_KEY_LEFT_SHIFT, ImGuiKey_LeftShift },
+        { GLFW_KEY_LEFT_CONTROL, ImGuiKey_LeftCtrl },
+        { GLFW_KEY_LEFT_ALT, ImGuiKey_LeftAlt },
+        { GLFW_KEY_LEFT_SUPER, ImGuiKey_LeftSuper },
+        { GLFW_KEY_RIGHT_SHIFT, ImGuiKey_RightShift },
+        { GLFW_KEY_RIGHT_CONTROL, ImGuiKey_RightCtrl },
+        { GLFW_KEY_RIGHT_ALT, ImGuiKey_RightAlt },
+        { GLFW_KEY_RIGHT_SUPER, ImGuiKey_RightSuper },
+        { GLFW_KEY_MENU, ImGuiKey_Menu }
+    };
+
+    ImGuiKey translateKey(int key)
+    {
+        if (key >= GLFW_KEY_A && key <= GLFW_KEY_Z) return (ImGuiKey) (ImGuiKey_A + (key - GLFW_KEY_A));
+        if (key >= GLFW_KEY_0 && key <= GLFW_KEY_9) return (ImGuiKey) (ImGuiKey_0 + (key - GLFW_KEY_0));
+        if (key >= GLFW_KEY_KP_0 && key <= GLFW_KEY_KP_9) return (ImGuiKey) (ImGuiKey_Keypad0 + (key - GLFW_KEY_KP_0));
+        if (key >= GLFW_KEY_F1 && key <= GLFW_KEY_F12) return (ImGuiKey) (ImGuiKey_F1 + (key - GLFW_KEY_F1));
+        for (const KeyMapping& mapping: keyMappings) {
+            if (mapping.glfw == key) return mapping.imgui;
+        }
+        return ImGuiKey_None;
+    }
+
+    // Some platforms report a modifier key's own press without its bit set, so it's folded in here
+    int modsAfter(int key, int action, int mods)
+    {
+        int bit = 0;
+        if (key == GLFW_KEY_LEFT_SHIFT || key == GLFW_KEY_RIGHT_SHIFT) bit = GLFW_MOD_SHIFT;
+        if (key == GLFW_KEY_LEFT_CONTROL || key == GLFW_KEY_RIGHT_CONTROL) bit = GLFW_MOD_CONTROL;
+        if (key == GLFW_KEY_LEFT_ALT || key == GLFW_KEY_RIGHT_ALT) bit = GLFW_MOD_ALT;
+        if (key == GLFW_KEY_LEFT_SUPER || key == GLFW_KEY_RIGHT_SUPER) bit = GLFW_MOD_SUPER;
+        return action == GLFW_RELEASE ? mods & ~bit : mods | bit;
+    }
+
+    void applyMods(ImGuiIO& io, int mods)
+    {
+        io.AddKeyEvent(ImGuiMod_Ctrl, (mods & GLFW_MOD_CONTROL) != 0);
+        io.AddKeyEvent(ImGuiMod_Shift, (mods & GLFW_MOD_SHIFT) != 0);
+        io.AddKeyEvent(ImGuiMod_Alt, (mods & GLFW_MOD_ALT) != 0);
+        io.AddKeyEvent(ImGuiMod_Super, (mods & GLFW_MOD_SUPER) != 0);
+    }
+
+    // Whether `value` is an array with one element per character of `shape`: 'n' a number, 'i' an integer, 's' a
+    // string, 'a' an array
+    bool hasShape(const nlohmann::json& value, std::string_view shape)
+    {
+        if (!value.is_array() || value.size() != shape.size()) return false;
+        for (size_t k = 0; k < shape.size(); k++) {
+            const nlohmann::json& field = value[k];
+            bool matches = shape[k] == 'n' ? field.is_number()
+                           : shape[k] == 'i' ? field.is_number_integer()
+                           : shape[k] == 's' ? field.is_string()
+                           : field.is_array();
+            if (!matches) return false;
+        }
+        return true;
+    }
+
+    bool parseEvent(const nlohmann::json& fields, InputEvent& event)
+    {
+        if (!fields.is_array() || fields.empty() || !fields[0].is_number_integer()) return false;
+        int type = fields[0].get<int>();
+        if (type < IEKey || type > IEOpenFile) return false;
+        event.type = (InputEventType) type;
+
+        if (event.type == IEOpenFile) {
+            if (!hasShape(fields, "is")) return false;
+            event.path = fields[1].get<std::string>();
+        } else if (event.type == IECursorPos || event.type == IEScroll) {
+            if (!hasShape(fields, "inn")) return false;
+            event.x = fields[1].get<double>();
+            event.y = fields[2].get<double>();
+        } else {
+            if (!hasShape(fields, "iiii")) return false;
+            event.a = fields[1].get<int>();
+            event.b = fields[2].get<int>();
+            event.c = fields[3].get<int>();
+        }
+        return true;
+    }
+
+    bool parseFrame(const nlohmann::json& item, RecordedFrame& frame)
+    {
+        if (!hasShape(item, "nnnna")) return false;
+        frame.time = item[0].get<double>();
+        frame.deltaTime = item[1].get<float>();
+        frame.width = item[2].get<float>();
+        frame.height = item[3].get<float>();
+        for (const auto& fields: item[4]) {
+            InputEvent event;
+            if (!parseEvent(fields, event)) return false;
+            frame.events.push_back(std::move(event));
+        }
+        return true;
+    }
+}
+
+bool saveRecording(const std::string& path, const InputRecording& recording)
+{
+    nlohmann::json frames = nlohmann::json::array();
+    for (const RecordedFrame& frame: recording.frames) {
+        nlohmann::json events = nlohmann::json::array();
+        for (const InputEvent& event: frame.events) {
+            if (event.type == IEOpenFile) {
+                events.push_back({ event.type, event.path });
+            } else if (event.type == IECursorPos || event.type == IEScroll) {
+                events.push_back({ event.type, event.x, event.y });
+            } else {
+                events.push_back({ event.type, event.a, event.b, event.c });
+            }
+        }
+        frames.push_back({ frame.time, frame.deltaTime, frame.width, frame.height, std::move(events) });
+    }
+
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        std::cerr << "Error writing input recording: " << path << std::endl;
+        return false;
+    }
+    out << nlohmann::json { { "version", Version }, { "ini", recording.iniSettings }, { "frames", frames } };
+    return true;
+}
+
+bool loadRecording(const std::string& path, InputRecording& recording)
+{
+    std::ifstream in(path);
+    auto root = nlohmann::json::parse(in, nullptr, false);
+
+    // A file that isn't quite a recording is rejected whole, rather than replayed up to where it goes wrong
+    InputRecording loaded;
+    bool valid = !root.is_discarded() && root.is_object() && root.contains("version") &&
+                 root["version"].is_number_integer() && root["version"].get<int>() == Version &&
+                 root.contains("ini") && root["ini"].is_string() && root.contains("frames") &&
+                 root["frames"].is_array();
+    if (valid) {
+        loaded.iniSettings = root["ini"].get<std::string>();
+        for (const auto& item: root["frames"]) {
+            RecordedFrame frame;
+            if (!parseFrame(item, frame)) {
+                valid = false;
+                break;
+            }
+            loaded.frames.push_back(std::move(frame));
+        }
+    }
+    if (!valid) {
+        std::cerr << "Error reading input recording: " << path << std::endl;
+        return false;
+    }
+
+    recording = std::move(loaded);
+    return true;
+}
+
+void replayEvent(ImGuiIO& io, const InputEvent& event)
+{
+    switch (event.type) {
+        case IEKey:
+            if (event.b == GLFW_REPEAT) break;
+            applyMods(io, modsAfter(event.a, event.b, event.c));
+            io.AddKeyEvent(translateKey(event.a), event.b == GLFW_PRESS);
+            break;
+        case IEChar:
+            io.AddInputCharacter((unsigned) event.a);
+            break;
+        case IEMouseButton:
+            applyMods(io, event.c);
+            if (event.a >= 0 && event.a < 5) io.AddMouseButtonEvent(event.a, event.b == GLFW_PRESS);
+            break;
+        case IECursorPos:
+            io.AddMousePosEvent((float) event.x, (float) event.y);
+            break;
+        case IEScroll:
+            io.AddMouseWheelEvent((float) event.x, (float) event.y);
+            break;
+        case IECursorEnter:
+            if (!event.a) io.AddMousePosEvent(-FLT_MAX, -FLT_MAX);
+            break;
+        case IEFocus:
+            io.AddFocusEvent(event.a != 0);
+            break;
+        case IEOpenFile:
+            break;
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <imgui.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum InputEventType
+{
+    IEKey,          // a = GLFW key, b = action, c = mods
+    IEChar,         // a = codepoint
+    IEMouseButton,  // a = button, b = action, c = mods
+    IECursorPos,    // x, y
+    IEScroll,       // x, y
+    IECursorEnter,  // a = entered
+    IEFocus,        // a = focused
+    IEOpenFile      // path; files are opened by name on replay rather than through the dialog
+};
+
+struct InputEvent
+{
+    InputEventType type = IEKey;
+    int a = 0, b = 0, c = 0;
+    double x = 0.0, y = 0.0;
+    std::string path;
+};
+
+// Everything one frame saw: when it started, the delta time ImGui was given and the input since the frame before
+struct RecordedFrame
+{
+    double time = 0.0;  // seconds since recording started
+    float deltaTime = 0.0f;
+    float width = 0.0f, height = 0.0f;
+    std::vector<InputEvent> events;
+};
+
+// GLFW input as a sequence of frames, with the ImGui layout it started from, so replaying it frame for frame feeds
+// ImGui exactly what it saw when recording
+struct InputRecording
+{
+    std::string iniSettings;
+    std::vector<RecordedFrame> frames;
+    std::vector<InputEvent> pending;  // arrived since the last frame, while recording
+};
+
+bool saveRecording(const std::string& path, const InputRecording& recording);
+bool loadRecording(const std::string& path, InputRecording& recording);
+
+// Queues a recorded event on ImGui directly, with modifiers taken from the event rather than the live keyboard, which
+// a hidden replay window doesn't have. File opens are left to the caller.
+void replayEvent(ImGuiIO& io, const InputEvent& event);
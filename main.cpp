@@ -5,6 +5,28 @@
 #include <imgui_impl_opengl3.h>
 #include "imgui_memory_editor.h"
 #include "imfilebrowser.h"
+#include "document.h"
+#include "vis_params.h"
+#include "session_cache.h"
+#include "worker_pool.h"
+#include "file_watcher.h"
+#include "binary_diff.h"
+#include "struct_template.h"
+#include "mesh_export.h"
+#include "buffer_ops.h"
+#include "mesh_detect.h"
+#include "mesh_score.h"
+#include "attribute_lanes.h"
+#include "pointer_graph.h"
+#include "string_index.h"
+#include "chunk_tree.h"
+#include "shader.h"
+#include "thumbnail_atlas.h"
+#include "prefetch.h"
+#include "startup_trace.h"
+#include "input_recording.h"
+#include "vertex_picking.h"
+#include <chrono>
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -14,13 +36,6 @@
 
 using json = nlohmann::json;
 
-enum PolygonMode
-{
-    PMFill,
-    PMLine,
-    PMPoint
-};
-
 const char *polygonModes[] = {
     "Fill",
     "Wireframe",
@@ -33,214 +48,2491 @@ unsigned polygonModeGLConstants[] = {
     GL_POINT
 };
 
-enum MeshType
+const char *meshTypes[] = {
+    "Triangle",
+    "Triangle Strip",
+    "Triangle Fan",
+    "Quad",
+    "Quad Strip",
+    "Line",
+    "Line Strip",
+    "Line Loop",
+    "Point"
+};
+
+unsigned meshTypeGLConstants[] = {
+    GL_TRIANGLES,
+    GL_TRIANGLE_STRIP,
+    GL_TRIANGLE_FAN,
+    GL_QUADS,
+    GL_QUAD_STRIP,
+    GL_LINES,
+    GL_LINE_STRIP,
+    GL_LINE_LOOP,
+    GL_POINTS
+};
+
+// The slice of the document one GPU buffer holds. Archives run to many gigabytes, more than a buffer can, so only the
+// bytes the current layout draws are uploaded, padded so that nudging the layout doesn't upload again.
+struct GpuWindow
+{
+    unsigned buffer = 0;
+    uint64_t begin = 0;
+    uint64_t end = 0;
+    uint64_t revision = 0;
+    bool bigEndian = false;
+    bool loaded = false;
+    uint64_t uploaded = 0;  // bytes sent to the GPU so far, for --bench
+};
+
+constexpr uint64_t WindowPadding = 16 << 20;
+
+// Largest span one draw may read; past it drawing is refused rather than asking the driver for the whole archive
+constexpr uint64_t MaxWindowBytes = 1ull << 30;
+
+// Makes `window` hold [begin, end) of the document as it now stands. False when the span is too large to upload.
+bool mapWindow(GpuWindow& window, const Document& document, uint64_t begin, uint64_t end, bool bigEndian)
+{
+    if (window.loaded && window.begin <= begin && end <= window.end && window.bigEndian == bigEndian &&
+        window.revision == document.table.revision()) {
+        return true;
+    }
+    if (end - begin > MaxWindowBytes) return false;
+
+    // Starting on a 64 KiB boundary keeps word swaps and index alignment the same as in the file
+    window.begin = (begin > WindowPadding ? begin - WindowPadding : 0) & ~(uint64_t) 0xFFFF;
+    window.end = std::min<uint64_t>(document.size(), end + WindowPadding);
+    window.bigEndian = bigEndian;
+    window.revision = document.table.revision();
+    window.loaded = true;
+
+    std::vector<uint8_t> uploadData;
+    prepareUpload(document.table, window.begin, window.end - window.begin, bigEndian, uploadData);
+    glBindBuffer(GL_ARRAY_BUFFER, window.buffer);
+    glBufferData(GL_ARRAY_BUFFER, (long) uploadData.size(), uploadData.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    window.uploaded += uploadData.size();
+    return true;
+}
+
+// Refreshes the part of [offset, offset + length) the window holds, after the file changed underneath it
+void copyRangeToGPU(GpuWindow& window, const Document& document, uint64_t offset, uint64_t length)
+{
+    uint64_t begin = std::max(offset, window.begin), end = std::min(offset + length, window.end);
+    if (!window.loaded || begin >= end) return;
+
+    std::vector<uint8_t> uploadData;
+    uint64_t start = prepareUpload(document.table, begin, end - begin, window.bigEndian, uploadData);
+    uploadData.resize(std::min<uint64_t>(uploadData.size(), window.end - start));
+    glBindBuffer(GL_ARRAY_BUFFER, window.buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, (long) (start - window.begin), (long) uploadData.size(), uploadData.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    window.uploaded += uploadData.size();
+}
+
+// The vertex and index windows, and how far the current index buffer reaches
+struct DrawWindows
+{
+    GpuWindow vertices;
+    GpuWindow indices;
+    VisParams measured;
+    uint64_t measuredRevision = UINT64_MAX;
+    uint64_t maxIndex = 0;
+};
+
+enum DrawCheck
+{
+    DCDrawable,
+    DCPastEnd,
+    DCTooLarge
+};
+
+// Largest value in the layout's index buffer, which the caller has checked lies inside the document
+uint64_t findMaxIndex(const PieceTable& table, const VisParams& visParams)
+{
+    uint64_t width = visParams.halfWidthIndexes ? 2 : 4;
+    uint64_t maxIndex = 0;
+    std::vector<uint8_t> block(64 << 10);
+    for (uint64_t done = 0; done < visParams.vertexCount;) {
+        uint64_t count = std::min<uint64_t>(visParams.vertexCount - done, block.size() / width);
+        table.read(visParams.indexBufferStart + done * width, block.data(), count * width);
+        for (uint64_t k = 0; k < count; k++) {
+            const uint8_t *p = block.data() + k * width;
+            uint64_t index = 0;
+            for (uint64_t b = 0; b < width; b++) {
+                index |= (uint64_t) p[b] << ((visParams.bigEndian ? width - 1 - b : b) * 8);
+            }
+            maxIndex = std::max(maxIndex, index);
+        }
+        done += count;
+    }
+    return maxIndex;
+}
+
+// Whether two layouts read the same index buffer, so its largest index needn't be measured again when only the
+// vertices move
+bool sameIndices(const VisParams& a, const VisParams& b)
+{
+    return a.indexedDraw == b.indexedDraw && a.indexBufferStart == b.indexBufferStart &&
+           a.vertexCount == b.vertexCount && a.halfWidthIndexes == b.halfWidthIndexes && a.bigEndian == b.bigEndian;
+}
+
+// Checks every byte the layout reads lies in the document, in 64-bit arithmetic so nothing wraps on huge files, and
+// maps the windows over them
+DrawCheck prepareDraw(DrawWindows& windows, const Document& document, const VisParams& visParams)
+{
+    uint64_t size = document.size();
+    uint64_t stride = visParams.vertexStride ? visParams.vertexStride : 12;
+    uint64_t count = visParams.vertexCount;
+    if (count == 0 || count > INT32_MAX || visParams.vertexBufferStart >= size) return DCPastEnd;
+
+    uint64_t vertices = count;
+    if (visParams.indexedDraw) {
+        uint64_t width = visParams.halfWidthIndexes ? 2 : 4;
+        if (visParams.indexBufferStart >= size || count > (size - visParams.indexBufferStart) / width) return DCPastEnd;
+        if (count * width > MaxWindowBytes) return DCTooLarge;
+        if (!sameIndices(windows.measured, visParams) || windows.measuredRevision != document.table.revision()) {
+            windows.maxIndex = findMaxIndex(document.table, visParams);
+            windows.measured = visParams;
+            windows.measuredRevision = document.table.revision();
+        }
+        vertices = windows.maxIndex + 1;
+    }
+
+    // The last vertex only needs its position, not a whole stride
+    uint64_t room = size - visParams.vertexBufferStart;
+    if (room < 12 || vertices - 1 > (room - 12) / stride) return DCPastEnd;
+    uint64_t lastVertex = visParams.vertexBufferStart + (vertices - 1) * stride;
+    uint64_t vertexEnd = std::min(size, lastVertex + std::max<uint64_t>(stride, 12));
+    if (!mapWindow(windows.vertices, document, visParams.vertexBufferStart, vertexEnd, visParams.bigEndian)) {
+        return DCTooLarge;
+    }
+    if (visParams.indexedDraw) {
+        uint64_t indexEnd = visParams.indexBufferStart + count * (visParams.halfWidthIndexes ? 2 : 4);
+        if (!mapWindow(windows.indices, document, visParams.indexBufferStart, indexEnd, visParams.bigEndian)) {
+            return DCTooLarge;
+        }
+    }
+    return DCDrawable;
+}
+
+ImU8 readDocumentByte(const ImU8 *data, size_t off)
+{
+    return ((const Document *) data)->table.readByte(off);
+}
+
+void writeDocumentByte(ImU8 *data, size_t off, ImU8 d)
+{
+    ((Document *) data)->table.replace(off, &d, 1);
+}
+
+bool
+drawVisMenu(VisParams& visParams, size_t editAddress)
+{
+    bool needsReupload = false;
+    bool hasAddress = editAddress != (size_t) -1;
+    const uint64_t step = 1, fastStep = 0x100;
+    const uint32_t strideStep = 1, strideFastStep = 4;
+
+    ImGui::Begin("Vertex Visualization");
+    ImGui::InputScalar("Start", ImGuiDataType_U64, &visParams.vertexBufferStart, &step, &fastStep, "%llX",
+                       ImGuiInputTextFlags_CharsHexadecimal);
+    if (ImGui::Button("Set to Highlighted Address") && hasAddress) {
+        visParams.vertexBufferStart = editAddress;
+    }
+
+    if (visParams.indexedDraw) {
+        ImGui::InputScalar("Index Start", ImGuiDataType_U64, &visParams.indexBufferStart, &step, &fastStep, "%llX",
+                           ImGuiInputTextFlags_CharsHexadecimal);
+        if (ImGui::Button("Set to Highlighted Address##STHA_IND") && hasAddress) {
+            visParams.indexBufferStart = editAddress;
+        }
+    }
+
+    ImGui::InputScalar("Count", ImGuiDataType_U64, &visParams.vertexCount, &step, &fastStep);
+    ImGui::InputScalar("Stride", ImGuiDataType_U32, &visParams.vertexStride, &strideStep, &strideFastStep);
+    ImGui::Checkbox("Indexed Draw", &visParams.indexedDraw);
+
+    if (visParams.indexedDraw) {
+        ImGui::Checkbox("Half-Width (16-bit) Indexes", &visParams.halfWidthIndexes);
+    }
+
+    if (ImGui::Checkbox("Big-Endian", &visParams.bigEndian)) {
+        needsReupload = true;
+    }
+
+    ImGui::Combo("Polygon Mode", (int *) &visParams.polygonMode, polygonModes, sizeof(polygonModes) / sizeof(char *));
+    ImGui::Combo("Mesh Type", (int *) &visParams.meshType, meshTypes, sizeof(meshTypes) / sizeof(char *));
+    ImGui::Checkbox("Backface Culling", &visParams.backfaceCulling);
+    ImGui::InputFloat("View Distance", &visParams.viewDistance);
+    ImGui::End();
+
+    return needsReupload;
+}
+
+bool loadFile(const std::string& name, Document& document, DrawWindows& windows)
+{
+    // Map the file instead of reading it, edits are layered on top by the document
+    if (!document.open(name)) return false;
+
+    windows.vertices.loaded = windows.indices.loaded = false;
+    windows.measuredRevision = UINT64_MAX;
+    return true;
+}
+
+struct SessionState
+{
+    FileSession session;
+    bool hashKnown = false;
+    std::future<ContentDigest> pendingDigest;
+    std::shared_ptr<std::atomic<bool>> cancelDigest;
+    std::future<std::vector<MeshCandidate>> pendingDetection;
+    std::shared_ptr<std::atomic<bool>> cancelDetection;
+};
+
+void applySession(const FileSession& session, VisParams& visParams, MemoryEditor& memEdit)
+{
+    visParams = session.visParams;
+    memEdit.GotoAddr = session.hexViewAddress;
+}
+
+void storeSession(SessionCache& cache, SessionState& state, const VisParams& visParams, const MemoryEditor& memEdit)
+{
+    if (!state.hashKnown) return;
+
+    state.session.visParams = visParams;
+    if (memEdit.DataEditingAddr != (size_t) -1) {
+        state.session.hexViewAddress = memEdit.DataEditingAddr;
+    }
+    cache.store(state.session.digest.hash, state.session);
+}
+
+// Restores the document's session straight from the cache when the file is unchanged since we last saw it, and
+// otherwise hashes it in the background; pollSession() picks up the result. Returns true if visParams changed.
+bool startSession(SessionCache& cache, SessionState& state, const Document& document, VisParams& visParams,
+                  MemoryEditor& memEdit, bool keepSession)
+{
+    if (state.cancelDigest) *state.cancelDigest = true;
+    if (state.cancelDetection) *state.cancelDetection = true;
+    state.pendingDigest = {};
+    state.pendingDetection = {};
+    state.hashKnown = false;
+    if (!keepSession) state.session = FileSession();
+
+    uint64_t hash;
+    if (cache.lookupHash(document.path, hash) && cache.load(hash, state.session)) {
+        state.hashKnown = true;
+        applySession(state.session, visParams, memEdit);
+        return true;
+    }
+
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+    state.cancelDigest = cancel;
+    state.pendingDigest = workerPool().async([file = document.file, cancel] {
+        ContentDigest digest;
+        digestContent(file->data(), file->size(), digest, cancel.get());
+        return digest;
+    });
+    return false;
+}
+
+bool pollSession(SessionCache& cache, SessionState& state, const Document& document, VisParams& visParams,
+                 MemoryEditor& memEdit)
+{
+    if (!isFutureReady(state.pendingDigest)) return false;
+
+    ContentDigest digest = state.pendingDigest.get();
+    state.hashKnown = true;
+    cache.rememberHash(document.path, digest.hash);
+
+    // A copy or rename of a file we've seen before still restores its session
+    if (cache.load(digest.hash, state.session)) {
+        applySession(state.session, visParams, memEdit);
+        return true;
+    }
+
+    state.session.digest = std::move(digest);
+    return false;
+}
+
+struct ReloadResult
+{
+    std::shared_ptr<const MappedFile> file;
+    ContentDigest digest;
+};
+
+// Maps the rewritten file and hashes it in the background, reusing what the previous digest already knows
+std::future<ReloadResult> startReload(const std::string& path, SessionState& state)
+{
+    // The old mapping may have just been truncated underneath a digest still running over it
+    if (state.cancelDigest) *state.cancelDigest = true;
+    state.pendingDigest = {};
+
+    ContentDigest previous = state.hashKnown ? state.session.digest : ContentDigest();
+    return workerPool().async([path, previous = std::move(previous)] {
+        ReloadResult result;
+        auto file = std::make_shared<MappedFile>();
+        if (!file->open(path)) return result;
+
+        digestContent(file->data(), file->size(), result.digest, nullptr, &previous);
+        result.file = std::move(file);
+        return result;
+    });
+}
+
+// Swaps the rewritten file in, leaving the view parameters and hex position alone so a file being regenerated by
+// another tool can be watched live. When the old digest is trustworthy only the changed blocks are re-uploaded.
+void applyReload(ReloadResult& result, Document& document, SessionCache& cache, SessionState& state,
+                 DrawWindows& windows)
+{
+    if (!result.file) return;
+
+    const ContentDigest& before = state.session.digest;
+    bool incremental = state.hashKnown && !document.isModified() && before.size == document.size() &&
+                       before.size == result.file->size();
+    std::vector<ByteRange> ranges;
+    if (incremental) ranges = changedRanges(before, result.digest);
+
+    document.reload(result.file);
+    windows.measuredRevision = UINT64_MAX;
+    for (GpuWindow *window: { &windows.vertices, &windows.indices }) {
+        if (!incremental) {
+            window->loaded = false;
+            continue;
+        }
+        for (const ByteRange& range: ranges) copyRangeToGPU(*window, document, range.offset, range.length);
+        window->revision = document.table.revision();
+    }
+
+    state.session.digest = std::move(result.digest);
+    state.hashKnown = true;
+    cache.rememberHash(document.path, state.session.digest.hash);
+}
+
+// The mapping must never outlive the bytes behind it; reading past a truncated end faults the whole process
+void guardTruncation(Document& document)
+{
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(document.path, ec);
+    if (ec || size >= document.file->size()) return;
+
+    auto file = std::make_shared<MappedFile>();
+    if (!file->open(document.path)) return;
+    if (document.isModified()) {
+        std::cerr << "File truncated on disk, discarding unsaved edits: " << document.path << std::endl;
+    }
+    document.reload(std::move(file));
+}
+
+void drawChangedOnDiskWindow(bool& changedOnDisk, bool& reloadRequested)
+{
+    ImGui::Begin("Changed on Disk", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::Text("The file was modified by another program, but has unsaved edits here.");
+    if (ImGui::Button("Reload and Discard Edits")) {
+        reloadRequested = true;
+        changedOnDisk = false;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Keep Edits")) {
+        changedOnDisk = false;
+    }
+    ImGui::End();
+}
+
+float entropyAt(void *data, int index)
+{
+    return ((const ContentDigest *) data)->blockEntropy[index] / 255.0f * 8.0f;
+}
+
+// Handed to a diff hex view as its mem_data, so the read and highlight callbacks know which side they draw
+struct DiffSide
+{
+    const BinaryDiff *diff;
+    int side;
+    std::shared_ptr<const MappedFile> file;
+};
+
+struct DiffView
+{
+    bool open = false;
+    BinaryDiff diff;
+    std::string rightPath;
+    DiffSide left { &diff, 0, nullptr };
+    DiffSide right { &diff, 1, nullptr };
+    MemoryEditor leftEdit, rightEdit;
+    size_t current = (size_t) -1;
+    bool evicted = false;  // the ranges were dropped to save memory, compare again when next shown
+};
+
+ImU8 readDiffByte(const ImU8 *data, size_t off)
+{
+    return ((const DiffSide *) data)->file->data()[off];
+}
+
+bool isDiffByte(const ImU8 *data, size_t off)
+{
+    const auto *side = (const DiffSide *) data;
+    return side->diff->contains(side->side, off);
+}
+
+void setupDiffEditor(MemoryEditor& editor)
+{
+    editor.ReadOnly = true;
+    editor.ReadFn = readDiffByte;
+    editor.HighlightFn = isDiffByte;
+    editor.HighlightColor = IM_COL32(255, 80, 80, 90);
+    editor.OptShowDataPreview = false;
+}
+
+// Compares the saved contents of the open document against another file
+bool startDiff(DiffView& view, const Document& document, const std::string& rightPath)
+{
+    auto right = std::make_shared<MappedFile>();
+    if (!document.isOpen() || !right->open(rightPath)) return false;
+
+    view.left.file = document.file;
+    view.right.file = std::move(right);
+    view.rightPath = rightPath;
+    view.current = (size_t) -1;
+    view.open = true;
+    view.diff.start(view.left.file, view.right.file);
+    return true;
+}
+
+void gotoDiff(DiffView& view, size_t index)
+{
+    if (index >= view.diff.ranges().size()) return;
+
+    // Pure insertions have nothing to highlight on one side, so mark the byte they were inserted before
+    const DiffRange& range = view.diff.ranges()[index];
+    view.current = index;
+    view.leftEdit.GotoAddrAndHighlight(range.leftOffset, range.leftOffset + std::max<uint64_t>(range.leftLength, 1));
+    view.rightEdit.GotoAddrAndHighlight(range.rightOffset,
+                                        range.rightOffset + std::max<uint64_t>(range.rightLength, 1));
+}
+
+void drawDiffWindow(DiffView& view, bool documentModified)
+{
+    if (view.evicted) {
+        view.evicted = false;
+        view.current = (size_t) -1;
+        view.diff.start(view.left.file, view.right.file);
+    }
+    view.diff.poll();
+    const auto& ranges = view.diff.ranges();
+
+    ImGui::SetNextWindowSize(ImVec2(1200, 600), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Diff", &view.open);
+
+    bool previous = ImGui::Button("Previous") || ImGui::IsKeyChordPressed(ImGuiMod_Shift | ImGuiKey_F8);
+    ImGui::SameLine();
+    bool next = ImGui::Button("Next") || ImGui::IsKeyChordPressed(ImGuiKey_F8);
+    if (previous && view.current != (size_t) -1) {
+        gotoDiff(view, view.current - 1);
+    }
+    if (next) {
+        gotoDiff(view, view.current != (size_t) -1 ? view.current + 1 : 0);
+    }
+
+    ImGui::SameLine();
+    if (view.current < ranges.size()) {
+        const DiffRange& range = ranges[view.current];
+        ImGui::Text("%zu / %zu: %llX+%llu -> %llX+%llu", view.current + 1, ranges.size(),
+                    (unsigned long long) range.leftOffset, (unsigned long long) range.leftLength,
+                    (unsigned long long) range.rightOffset, (unsigned long long) range.rightLength);
+    } else {
+        ImGui::Text("%zu differences", ranges.size());
+    }
+    if (view.diff.isRunning()) {
+        ImGui::SameLine();
+        ImGui::ProgressBar(view.diff.progress(), ImVec2(ImGui::GetFontSize() * 10, 0));
+    }
+    if (documentModified) {
+        ImGui::TextDisabled("Comparing the saved file; unsaved edits are not included.");
+    }
+
+    float half = ImGui::GetContentRegionAvail().x * 0.5f;
+    ImGui::BeginChild("##left", ImVec2(half, 0));
+    ImGui::TextUnformatted("Current file");
+    view.leftEdit.DrawContents(&view.left, view.left.file->size());
+    ImGui::EndChild();
+    ImGui::SameLine();
+    ImGui::BeginChild("##right", ImVec2(0, 0));
+    ImGui::TextUnformatted(view.rightPath.c_str());
+    view.rightEdit.DrawContents(&view.right, view.right.file->size());
+    ImGui::EndChild();
+
+    ImGui::End();
+
+    if (!view.open) {
+        view.diff.cancel();
+        view.left.file.reset();
+        view.right.file.reset();
+    }
+}
+
+struct TemplateView
+{
+    char source[16384] = "{ \"name\": \"Vertex\", \"endian\": \"big\", \"fields\": [\n"
+                         "  { \"name\": \"position\", \"type\": \"f32\", \"count\": 3 }\n] }";
+    StructTemplate compiled;
+    bool isCompiled = false;
+    std::string error;
+    uint64_t start = 0;
+    int recordCount = 1;
+    bool applied = false;
+    bool layoutDirty = false;
+    RecordLayout layout;
+    uint64_t layoutRevision = 0;
+    std::future<RecordLayout> pendingLayout;
+    std::shared_ptr<std::atomic<bool>> cancelLayout;
+    std::vector<uint64_t> bases;
+};
+
+void compileTemplateSource(TemplateView& view)
+{
+    auto source = nlohmann::json::parse(view.source, nullptr, false);
+    view.applied = false;
+    view.error.clear();
+    if (source.is_discarded()) {
+        view.error = "Template is not valid JSON";
+        view.isCompiled = false;
+        return;
+    }
+    view.isCompiled = compileTemplate(source, view.compiled, view.error);
+}
+
+void drawTemplateWindow(TemplateView& view, const Document& document, MemoryEditor& memEdit, bool& loadRequested)
+{
+    // ImGui's tables top out well below what a careless template could produce
+    constexpr size_t MaxTableColumns = 64;
+
+    ImGui::Begin("Struct Template");
+    ImGui::InputTextMultiline("##source", view.source, sizeof(view.source),
+                              ImVec2(-FLT_MIN, ImGui::GetTextLineHeight() * 8));
+    if (ImGui::Button("Compile")) {
+        compileTemplateSource(view);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Load...")) {
+        loadRequested = true;
+    }
+    if (!view.error.empty()) {
+        ImGui::TextColored(ImVec4(1, 0.4f, 0.4f, 1), "%s", view.error.c_str());
+    }
+
+    ImGui::InputScalar("Address", ImGuiDataType_U64, &view.start, nullptr, nullptr, "%llX",
+                       ImGuiInputTextFlags_CharsHexadecimal);
+    if (ImGui::Button("Set to Highlighted Address##template") && memEdit.DataEditingAddr != (size_t) -1) {
+        view.start = memEdit.DataEditingAddr;
+    }
+    ImGui::InputInt("Records", &view.recordCount, 1, 100);
+    view.recordCount = std::max(view.recordCount, 1);
+
+    if (ImGui::Button("Apply") && view.isCompiled) {
+        view.applied = true;
+        view.layoutDirty = true;
+    }
+
+    // Edits can move every record of a variable-size template, so the layout follows the document. It's walked on
+    // the pool, superseding any walk still running; the previous layout stays on screen until it's done.
+    if (view.applied && (view.layoutDirty || view.layoutRevision != document.table.revision())) {
+        if (view.cancelLayout) *view.cancelLayout = true;
+        view.cancelLayout = std::make_shared<std::atomic<bool>>(false);
+        view.pendingLayout = workerPool().async([snapshot = document.table.snapshot(), tmpl = view.compiled,
+                                                 start = view.start, count = (uint64_t) view.recordCount,
+                                                 cancel = view.cancelLayout] {
+            RecordLayout layout;
+            layoutRecords(tmpl, *snapshot, start, count, layout, cancel.get());
+            return layout;
+        });
+        view.layoutRevision = document.table.revision();
+        view.layoutDirty = false;
+    }
+    if (isFutureReady(view.pendingLayout)) view.layout = view.pendingLayout.get();
+
+    if (!view.applied) {
+        ImGui::End();
+        return;
+    }
+
+    ImGui::SameLine();
+    ImGui::Text("%llu records", (unsigned long long) view.layout.count);
+    if (view.pendingLayout.valid()) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("(laying out)");
+    }
+
+    size_t columnCount = std::min(view.compiled.columns.size(), MaxTableColumns - 1);
+    ImGuiTableFlags flags = ImGuiTableFlags_ScrollX | ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg |
+                            ImGuiTableFlags_Borders | ImGuiTableFlags_Resizable;
+    if (ImGui::BeginTable("##records", (int) columnCount + 1, flags)) {
+        ImGui::TableSetupScrollFreeze(1, 1);
+        ImGui::TableSetupColumn("Offset");
+        for (size_t c = 0; c < columnCount; c++) {
+            ImGui::TableSetupColumn(view.compiled.columns[c].name.c_str());
+        }
+        ImGui::TableHeadersRow();
+
+        // Only the visible rows are decoded, so a million records cost the same per frame as ten
+        char text[256];
+        ImGuiListClipper clipper;
+        clipper.Begin((int) std::min<uint64_t>(view.layout.count, INT_MAX));
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                uint64_t offset = view.layout.offsetOf(row);
+                segmentBases(view.compiled, document.table, offset, view.bases);
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                snprintf(text, sizeof(text), "%llX##%d", (unsigned long long) offset, row);
+                if (ImGui::Selectable(text, false, ImGuiSelectableFlags_SpanAllColumns)) {
+                    memEdit.GotoAddrAndHighlight(offset, offset + view.layout.sizeOf(row));
+                }
+                for (size_t c = 0; c < columnCount; c++) {
+                    ImGui::TableNextColumn();
+                    formatColumn(view.compiled, view.compiled.columns[c], document.table, view.bases, text,
+                                 sizeof(text));
+                    ImGui::TextUnformatted(text);
+                }
+            }
+        }
+        ImGui::EndTable();
+    }
+
+    ImGui::End();
+}
+
+const char *meshFormatExtensions[] = {
+    ".obj",
+    ".ply",
+    ".gltf"
+};
+
+struct ExportState
+{
+    MeshFormat format = MFObj;
+    std::future<std::string> pending;  // error message, empty on success
+    std::shared_ptr<std::atomic<float>> progress;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    std::string status;
+};
+
+// Exports from a snapshot on the worker pool, which keeps the mapping alive until it's done
+void startExport(ExportState& state, const Document& document, const VisParams& visParams, std::string path)
+{
+    std::string extension = meshFormatExtensions[state.format];
+    if (std::filesystem::path(path).extension() != extension) path += extension;
+
+    state.progress = std::make_shared<std::atomic<float>>(0.0f);
+    state.cancel = std::make_shared<std::atomic<bool>>(false);
+    state.status = "Exporting " + path;
+    state.pending = workerPool().async([snapshot = document.table.snapshot(), visParams, format = state.format, path,
+                                        progress = state.progress, cancel = state.cancel] {
+        std::string error;
+        exportMesh(*snapshot, visParams, format, path, error, progress.get(), cancel.get());
+        return error;
+    });
+}
+
+void drawExportWindow(ExportState& state)
+{
+    if (isFutureReady(state.pending)) {
+        std::string error = state.pending.get();
+        state.status = error.empty() ? "Export finished" : "Export failed: " + error;
+    }
+    if (state.status.empty()) return;
+
+    ImGui::Begin("Export", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::TextUnformatted(state.status.c_str());
+    if (state.pending.valid()) {
+        ImGui::ProgressBar(state.progress->load(), ImVec2(ImGui::GetFontSize() * 15, 0));
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) *state.cancel = true;
+    } else if (ImGui::Button("OK")) {
+        state.status.clear();
+    }
+    ImGui::End();
+}
+
+void startDetection(SessionState& state, const Document& document)
+{
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+    state.cancelDetection = cancel;
+    state.pendingDetection = workerPool().async([file = document.file, cancel] {
+        std::vector<MeshCandidate> candidates;
+        detectMeshes(file->data(), file->size(), candidates, DetectOptions(), cancel.get());
+        return candidates;
+    });
+}
+
+// Adds the detector's confident finds to the session's candidates, skipping layouts already there
+void pollDetection(SessionState& state)
+{
+    if (!isFutureReady(state.pendingDetection)) return;
+
+    std::vector<VisParams>& candidates = state.session.candidates;
+    for (const MeshCandidate& found: state.pendingDetection.get()) {
+        if (candidates.size() >= 64) break;
+        if (found.confidence < 0.5f) continue;
+
+        const VisParams& params = found.params;
+        bool known = std::any_of(candidates.begin(), candidates.end(), [&](const VisParams& candidate) {
+            return candidate.vertexBufferStart == params.vertexBufferStart &&
+                   candidate.vertexStride == params.vertexStride && candidate.bigEndian == params.bigEndian;
+        });
+        if (!known) candidates.push_back(params);
+    }
+}
+
+void drawSessionWindow(SessionState& state, const Document& document, VisParams& visParams, MemoryEditor& memEdit,
+                       bool& needsReupload)
+{
+    static char annotationText[256] = "";
+
+    pollDetection(state);
+    FileSession& session = state.session;
+
+    ImGui::Begin("Session");
+
+    const ContentDigest& digest = session.digest;
+    if (!digest.blockEntropy.empty()) {
+        ImGui::Text("Entropy per %u KiB block (click to jump)", digest.blockSize / 1024);
+        ImGui::PlotHistogram("##entropy", entropyAt, (void *) &digest, (int) digest.blockEntropy.size(), 0,
+                             nullptr, 0.0f, 8.0f, ImVec2(-FLT_MIN, ImGui::GetFrameHeight() * 2));
+        if (ImGui::IsItemClicked()) {
+            ImVec2 min = ImGui::GetItemRectMin(), max = ImGui::GetItemRectMax();
+            float t = (ImGui::GetIO().MousePos.x - min.x) / (max.x - min.x);
+            auto block = (size_t) (t * (float) digest.blockEntropy.size());
+            memEdit.GotoAddrAndHighlight(block * digest.blockSize, block * digest.blockSize + 1);
+        }
+    } else {
+        ImGui::TextDisabled("Scanning file...");
+    }
+
+    if (ImGui::CollapsingHeader("Candidates", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (ImGui::Button("Save Current Parameters")) {
+            session.candidates.push_back(visParams);
+        }
+        ImGui::SameLine();
+        if (state.pendingDetection.valid()) {
+            ImGui::TextDisabled("Detecting meshes...");
+        } else if (ImGui::Button("Detect Meshes")) {
+            startDetection(state, document);
+        }
+        for (size_t i = 0; i < session.candidates.size(); i++) {
+            const VisParams& candidate = session.candidates[i];
+            ImGui::PushID((int) i);
+            if (ImGui::SmallButton("Apply")) {
+                needsReupload |= candidate.bigEndian != visParams.bigEndian;
+                visParams = candidate;
+            }
+            ImGui::SameLine();
+            bool remove = ImGui::SmallButton("Remove");
+            ImGui::SameLine();
+            ImGui::Text("%llX stride %u count %llu %s", (unsigned long long) candidate.vertexBufferStart,
+                        candidate.vertexStride, (unsigned long long) candidate.vertexCount,
+                        candidate.bigEndian ? "BE" : "LE");
+            ImGui::PopID();
+            if (remove) {
+                session.candidates.erase(session.candidates.begin() + (ptrdiff_t) i--);
+            }
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Annotations", ImGuiTreeNodeFlags_DefaultOpen)) {
+        ImGui::InputText("##note", annotationText, sizeof(annotationText));
+        ImGui::SameLine();
+        if (ImGui::Button("Annotate Highlighted Address") && memEdit.DataEditingAddr != (size_t) -1) {
+            session.annotations.push_back({ memEdit.DataEditingAddr, 1, annotationText });
+            annotationText[0] = '\0';
+        }
+        for (size_t i = 0; i < session.annotations.size(); i++) {
+            const Annotation& annotation = session.annotations[i];
+            ImGui::PushID((int) i);
+            if (ImGui::SmallButton("Go")) {
+                memEdit.GotoAddrAndHighlight(annotation.offset, annotation.offset + annotation.length);
+            }
+            ImGui::SameLine();
+            bool remove = ImGui::SmallButton("Remove");
+            ImGui::SameLine();
+            ImGui::Text("%llX: %s", (unsigned long long) annotation.offset, annotation.text.c_str());
+            ImGui::PopID();
+            if (remove) {
+                session.annotations.erase(session.annotations.begin() + (ptrdiff_t) i--);
+            }
+        }
+    }
+
+    ImGui::End();
+}
+
+struct ScoreView
+{
+    bool valid = false;
+    uint64_t generation = 0;  // the document's, to notice reloads and saves
+    uint64_t revision = 0;    // of the contents scored
+    VisParams scored;
+    MeshScore score;
+    std::future<MeshScore> pending;
+};
+
+// Rescored on the pool from the edited contents when the layout or the contents change, like the template layout.
+// Scoring reads a bounded sample, so a superseded run is left to finish rather than cancelled.
+void drawScoreWindow(ScoreView& view, const Document& document, const VisParams& visParams)
+{
+    if (!view.valid || view.generation != document.generation || view.revision != document.table.revision() ||
+        !sameLayout(view.scored, visParams) || view.scored.meshType != visParams.meshType) {
+        view.valid = true;
+        view.generation = document.generation;
+        view.revision = document.table.revision();
+        view.scored = visParams;
+        view.pending = workerPool().async([snapshot = document.table.snapshot(), params = visParams] {
+            MeshScore score;
+            scoreMesh(*snapshot, params, score);
+            return score;
+        });
+    }
+    if (isFutureReady(view.pending)) view.score = view.pending.get();
+
+    const MeshScore& score = view.score;
+    ImGui::Begin("Plausibility");
+    if (score.triangles == 0) {
+        ImGui::TextDisabled(view.pending.valid() ? "Scoring..." : "No triangles to score");
+        ImGui::End();
+        return;
+    }
+    ImGui::ProgressBar(score.score, ImVec2(-1, 0));
+    ImGui::Text("Triangles scored: %u", score.triangles);
+    ImGui::Text("Degenerate: %.1f%%", score.degenerateFraction * 100.0f);
+    ImGui::Text("Edge length spread: %.2f octaves", score.edgeSpread);
+    if (visParams.indexedDraw || visParams.meshType == MTTriangleStrip || visParams.meshType == MTTriangleFan) {
+        ImGui::Text("Manifold edges: %.1f%%", score.manifoldRatio * 100.0f);
+        ImGui::Text("Vertex reuse: %.2f (spread %.2f)", score.meanReuse, score.reuseSpread);
+    }
+    ImGui::End();
+}
+
+struct LaneView
+{
+    bool valid = false;
+    uint64_t generation = 0;  // the document's, to notice reloads and saves
+    uint64_t revision = 0;    // of the contents classified
+    VisParams classified;
+    std::vector<AttributeLane> lanes;
+    std::future<std::vector<AttributeLane>> pending;
+    std::shared_ptr<std::atomic<bool>> cancel;
+};
+
+// Only normals, texture coordinates and colors have somewhere to go in the shader
+bool bindLane(const AttributeLane& lane, VisParams& visParams)
+{
+    if (lane.kind == LKNormal && lane.format == LFFloat) {
+        visParams.normalOffset = (int) lane.offset;
+    } else if (lane.kind == LKTexCoord) {
+        visParams.texCoordOffset = (int) lane.offset;
+        visParams.halfTexCoords = lane.format == LFHalf;
+    } else if (lane.kind == LKColor) {
+        visParams.colorOffset = (int) lane.offset;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool isLaneBound(const AttributeLane& lane, const VisParams& visParams)
+{
+    return (int) lane.offset == (lane.kind == LKNormal ? visParams.normalOffset
+                                 : lane.kind == LKTexCoord ? visParams.texCoordOffset
+                                 : lane.kind == LKColor ? visParams.colorOffset : -2);
+}
+
+void drawAttributeWindow(LaneView& view, const Document& document, VisParams& visParams)
+{
+    // Classified on the pool from the edited contents, superseding any run still going, so typing a layout doesn't
+    // stall on a long index buffer; the previous lanes stay listed until it's done
+    if (!view.valid || view.generation != document.generation || view.revision != document.table.revision() ||
+        !sameLayout(view.classified, visParams)) {
+        view.valid = true;
+        view.generation = document.generation;
+        view.revision = document.table.revision();
+        view.classified = visParams;
+        if (view.cancel) *view.cancel = true;
+        view.cancel = std::make_shared<std::atomic<bool>>(false);
+        view.pending = workerPool().async([snapshot = document.table.snapshot(), params = visParams,
+                                           cancel = view.cancel] {
+            std::vector<AttributeLane> lanes;
+            classifyLanes(*snapshot, params, lanes, cancel.get());
+            return lanes;
+        });
+    }
+    if (isFutureReady(view.pending)) view.lanes = view.pending.get();
+
+    ImGui::Begin("Vertex Attributes");
+    if (view.lanes.empty()) {
+        ImGui::TextDisabled(view.pending.valid() ? "Classifying..." : "No bytes after the position to classify");
+        ImGui::End();
+        return;
+    }
+
+    if (ImGui::Button("Bind All Detected")) {
+        bool normal = false, texCoord = false, color = false;
+        for (const AttributeLane& lane: view.lanes) {
+            bool *taken = lane.kind == LKNormal ? &normal : lane.kind == LKTexCoord ? &texCoord
+                        : lane.kind == LKColor ? &color : nullptr;
+            if (taken && !*taken) *taken = bindLane(lane, visParams);
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Unbind All")) {
+        visParams.normalOffset = visParams.texCoordOffset = visParams.colorOffset = -1;
+    }
+
+    for (size_t i = 0; i < view.lanes.size(); i++) {
+        const AttributeLane& lane = view.lanes[i];
+        ImGui::PushID((int) i);
+        bool bindable = lane.kind == LKNormal || lane.kind == LKTexCoord || lane.kind == LKColor;
+        if (isLaneBound(lane, visParams)) {
+            ImGui::TextDisabled("Bound");
+        } else if (bindable) {
+            if (ImGui::SmallButton("Bind")) bindLane(lane, visParams);
+        } else {
+            ImGui::TextDisabled("     ");
+        }
+        ImGui::SameLine();
+        ImGui::Text("+%-3u %-20s %s x%u  %.0f%%", lane.offset, laneKindName(lane.kind), laneFormatName(lane.format),
+                    lane.components, lane.confidence * 100.0f);
+        ImGui::PopID();
+    }
+    ImGui::End();
+}
+
+const char *pointerKindNames[] = {
+    "u32 LE",
+    "u32 BE",
+    "u64 LE",
+    "u64 BE"
+};
+
+struct PointerView
+{
+    bool open = false;
+    const MappedFile *file = nullptr;  // the graph's file, to notice reloads
+    uint64_t revision = 0;             // of the contents scanned
+    std::shared_ptr<const PointerGraph> graph;
+    std::future<std::shared_ptr<const PointerGraph>> pending;
+    std::shared_ptr<std::atomic<float>> progress;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    size_t lookedUp = (size_t) -1;
+    std::vector<Pointer> outgoing;
+    std::vector<Pointer> incoming;
+};
+
+void startPointerScan(PointerView& view, const Document& document)
+{
+    if (view.cancel) *view.cancel = true;
+    view.file = document.file.get();
+    view.graph.reset();
+    view.lookedUp = (size_t) -1;
+    view.progress = std::make_shared<std::atomic<float>>(0.0f);
+    view.cancel = std::make_shared<std::atomic<bool>>(false);
+    view.revision = document.table.revision();
+    view.pending = workerPool().async([snapshot = document.table.snapshot(), progress = view.progress,
+                                       cancel = view.cancel] {
+        auto graph = std::make_shared<PointerGraph>();
+        buildPointerGraph(*snapshot, *graph, PointerOptions(), progress.get(), cancel.get());
+        return std::shared_ptr<const PointerGraph>(std::move(graph));
+    });
+}
+
+// "Follow pointer" for whatever covers the highlighted byte, and "who points here" for its offset
+void drawPointerWindow(PointerView& view, const Document& document, MemoryEditor& memEdit)
+{
+    if (view.file && view.file != document.file.get()) {
+        if (view.cancel) *view.cancel = true;
+        view.pending = {};
+        view.graph.reset();
+        view.file = nullptr;
+    }
+    if (isFutureReady(view.pending)) {
+        view.graph = view.pending.get();
+        view.lookedUp = (size_t) -1;
+    }
+
+    ImGui::Begin("Pointers", &view.open);
+    if (view.pending.valid()) {
+        ImGui::ProgressBar(view.progress->load(), ImVec2(ImGui::GetFontSize() * 15, 0));
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            *view.cancel = true;
+            view.pending = {};
+            view.file = nullptr;
+        }
+        ImGui::End();
+        return;
+    }
+    if (!view.graph) {
+        if (ImGui::Button("Scan for Pointers")) startPointerScan(view, document);
+        ImGui::End();
+        return;
+    }
+
+    const PointerGraph& graph = *view.graph;
+    ImGui::Text("%zu pointers%s", graph.pointers.size(), graph.truncated ? " (limit reached)" : "");
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Rescan")) startPointerScan(view, document);
+    if (view.revision != document.table.revision()) ImGui::TextDisabled("Scanned before the latest edits");
+
+    size_t address = memEdit.DataEditingAddr;
+    if (address == (size_t) -1) {
+        ImGui::TextDisabled("Select a byte in the hex view");
+        ImGui::End();
+        return;
+    }
+    if (address != view.lookedUp) {
+        view.lookedUp = address;
+        findPointersAt(graph, address, view.outgoing);
+        findReferencesTo(graph, address, address + 1, view.incoming, 256);
+    }
+
+    ImGui::SeparatorText("Follow Pointer");
+    if (view.outgoing.empty()) ImGui::TextDisabled("No pointer covers %zX", address);
+    for (size_t i = 0; i < view.outgoing.size(); i++) {
+        const Pointer& pointer = view.outgoing[i];
+        ImGui::PushID((int) i);
+        if (ImGui::SmallButton("Follow")) memEdit.GotoAddrAndHighlight(pointer.target, pointer.target + 1);
+        ImGui::SameLine();
+        ImGui::Text("%s at %llX -> %llX", pointerKindNames[pointer.kind], (unsigned long long) pointer.source,
+                    (unsigned long long) pointer.target);
+        ImGui::PopID();
+    }
+
+    ImGui::SeparatorText("Who Points Here");
+    if (view.incoming.empty()) ImGui::TextDisabled("Nothing points to %zX", address);
+    for (size_t i = 0; i < view.incoming.size(); i++) {
+        const Pointer& pointer = view.incoming[i];
+        ImGui::PushID((int) (i + view.outgoing.size()));
+        if (ImGui::SmallButton("Go")) {
+            memEdit.GotoAddrAndHighlight(pointer.source, pointer.source + pointer.width());
+        }
+        ImGui::SameLine();
+        ImGui::Text("%s at %llX", pointerKindNames[pointer.kind], (unsigned long long) pointer.source);
+        ImGui::PopID();
+    }
+    ImGui::End();
+}
+
+const char *stringEncodingNames[] = {
+    "ASCII",
+    "UTF-16LE",
+    "UTF-16BE"
+};
+
+struct StringView
+{
+    bool open = false;
+    int minLength = 6;
+    char prefix[128] = "";
+    const MappedFile *file = nullptr;  // the index's file, to notice reloads
+    uint64_t revision = 0;             // of the contents extracted from
+    std::shared_ptr<const StringIndex> index;
+    std::future<std::shared_ptr<const StringIndex>> pending;
+    std::shared_ptr<std::atomic<float>> progress;
+    std::shared_ptr<std::atomic<bool>> cancel;
+    size_t first = 0, last = 0;  // range of index->sorted matching the prefix
+};
+
+void startStringScan(StringView& view, const Document& document)
+{
+    if (view.cancel) *view.cancel = true;
+    view.file = document.file.get();
+    view.index.reset();
+    view.progress = std::make_shared<std::atomic<float>>(0.0f);
+    view.cancel = std::make_shared<std::atomic<bool>>(false);
+    StringOptions options;
+    options.minLength = (uint32_t) view.minLength;
+    view.revision = document.table.revision();
+    view.pending = workerPool().async([snapshot = document.table.snapshot(), options, progress = view.progress,
+                                       cancel = view.cancel] {
+        auto index = std::make_shared<StringIndex>();
+        extractStrings(*snapshot, *index, options, progress.get(), cancel.get());
+        return std::shared_ptr<const StringIndex>(std::move(index));
+    });
+}
+
+// Every string in the file by offset, or those starting with the filter in text order; clicking one jumps to it
+void drawStringWindow(StringView& view, const Document& document, MemoryEditor& memEdit)
+{
+    if (view.file && view.file != document.file.get()) {
+        if (view.cancel) *view.cancel = true;
+        view.pending = {};
+        view.index.reset();
+        view.file = nullptr;
+    }
+    bool filterChanged = false;
+    if (isFutureReady(view.pending)) {
+        view.index = view.pending.get();
+        filterChanged = true;
+    }
+
+    ImGui::Begin("Strings", &view.open);
+    if (view.pending.valid()) {
+        ImGui::ProgressBar(view.progress->load(), ImVec2(ImGui::GetFontSize() * 15, 0));
+        ImGui::SameLine();
+        if (ImGui::Button("Cancel")) {
+            *view.cancel = true;
+            view.pending = {};
+            view.file = nullptr;
+        }
+        ImGui::End();
+        return;
+    }
+
+    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 6);
+    if (ImGui::InputInt("Min Length", &view.minLength)) view.minLength = std::clamp(view.minLength, 2, 256);
+    ImGui::SameLine();
+    if (ImGui::Button(view.index ? "Rescan" : "Extract Strings")) startStringScan(view, document);
+    if (!view.index) {
+        ImGui::End();
+        return;
+    }
+
+    const StringIndex& index = *view.index;
+    filterChanged |= ImGui::InputTextWithHint("##prefix", "Starts with...", view.prefix, sizeof(view.prefix));
+    if (filterChanged) findByPrefix(index, view.prefix, view.first, view.last);
+
+    bool filtered = view.prefix[0] != '\0';
+    size_t rows = filtered ? view.last - view.first : index.strings.size();
+    ImGui::Text("%zu of %zu strings%s", rows, index.strings.size(), index.truncated ? " (limit reached)" : "");
+    if (view.revision != document.table.revision()) ImGui::TextDisabled("Extracted before the latest edits");
+
+    // Only the visible rows are formatted, so a few million strings cost the same per frame as a handful
+    ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders |
+                            ImGuiTableFlags_Resizable;
+    if (ImGui::BeginTable("strings", 3, flags)) {
+        ImGui::TableSetupScrollFreeze(0, 1);
+        ImGui::TableSetupColumn("Offset", ImGuiTableColumnFlags_WidthFixed, ImGui::GetFontSize() * 7);
+        ImGui::TableSetupColumn("Encoding", ImGuiTableColumnFlags_WidthFixed, ImGui::GetFontSize() * 5);
+        ImGui::TableSetupColumn("Text");
+        ImGui::TableHeadersRow();
+
+        ImGuiListClipper clipper;
+        clipper.Begin((int) std::min<size_t>(rows, INT_MAX));
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                const FoundString& found = index.strings[filtered ? index.sorted[view.first + row] : row];
+                std::string_view text = index.textOf(found);
+                ImGui::PushID(row);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                char label[24];
+                snprintf(label, sizeof(label), "%llX", (unsigned long long) found.offset);
+                if (ImGui::Selectable(label, false, ImGuiSelectableFlags_SpanAllColumns)) {
+                    memEdit.GotoAddrAndHighlight(found.offset, found.offset + found.byteLength());
+                }
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(stringEncodingNames[found.encoding]);
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(text.data(), text.data() + text.size());
+                if (found.length > found.textLength) {
+                    ImGui::SameLine(0, 0);
+                    ImGui::TextDisabled("... (%u chars)", found.length);
+                }
+                ImGui::PopID();
+            }
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+const char *chunkPresets[] = {
+    "RIFF (WAV, AVI, WebP)",
+    "IFF (AIFF, ILBM)",
+    "PNG",
+    "Custom"
+};
+
+enum ChunkPreset
+{
+    CPRiff,
+    CPIff,
+    CPPng,
+    CPCustom
+};
+
+const char *chunkSizeWidths[] = {
+    "1",
+    "2",
+    "4",
+    "8"
+};
+
+struct ChunkView
+{
+    bool open = false;
+    int preset = CPRiff;
+    ChunkFormat format;
+    char containers[128] = "RIFF,LIST";
+    uint64_t start = 0;
+    bool dirty = true;
+    ChunkTree tree;
+};
+
+constexpr size_t ChunkPage = 256;
+
+void applyChunkPreset(ChunkView& view)
+{
+    ChunkFormat format;
+    switch (view.preset) {
+        case CPRiff:
+            strcpy(view.containers, "RIFF,LIST");
+            view.start = 0;
+            break;
+        case CPIff:
+            format.bigEndian = true;
+            strcpy(view.containers, "FORM,LIST,CAT ,PROP");
+            view.start = 0;
+            break;
+        case CPPng:
+            format.bigEndian = true;
+            format.sizeFirst = true;
+            format.alignment = 1;
+            format.trailerWidth = 4;
+            view.containers[0] = '\0';
+            view.start = 8;  // past the signature
+            break;
+        default:
+            return;
+    }
+    view.format = format;
+}
+
+// Comma-separated tags, each padded with spaces to the tag width
+void parseContainerTags(const char *text, ChunkFormat& format)
+{
+    format.containerTags.clear();
+    std::string tag;
+    for (const char *p = text;; p++) {
+        if (*p == ',' || *p == '\0') {
+            if (!tag.empty()) {
+                tag.resize(std::max<size_t>(tag.size(), format.tagWidth), ' ');
+                format.containerTags.push_back(packTag(tag.c_str(), format.tagWidth));
+            }
+            tag.clear();
+            if (*p == '\0') break;
+        } else {
+            tag.push_back(*p);
+        }
+    }
+}
+
+void useChunkAs(const Chunk& chunk, int use, VisParams& visParams)
+{
+    if (use == 0) {
+        visParams.vertexBufferStart = chunk.payload;
+        visParams.vertexCount = std::max<uint64_t>(chunk.size / std::max<uint32_t>(visParams.vertexStride, 1), 3);
+        visParams.indexedDraw = false;
+    } else {
+        visParams.indexBufferStart = chunk.payload;
+        visParams.halfWidthIndexes = use == 1;
+        visParams.vertexCount = std::max<uint64_t>(chunk.size / (use == 1 ? 2 : 4), 3);
+        visParams.indexedDraw = true;
+    }
+}
+
+// One level of the tree, parsed only as far as it has been scrolled open. Children are drawn by recursion, which
+// only happens for nodes the user has expanded.
+void drawChunkLevel(ChunkView& view, uint64_t begin, uint64_t end, MemoryEditor& memEdit, VisParams& visParams)
+{
+    ChunkTree::Level& level = view.tree.level(begin, end, 0);
+    level.shown = std::max(level.shown, ChunkPage);
+    view.tree.level(begin, end, level.shown);
+
+    const ChunkFormat& format = view.tree.format();
+    size_t count = std::min(level.shown, level.chunks.size());
+    for (size_t i = 0; i < count; i++) {
+        // Copied, since opening a child may parse more of this level
+        Chunk chunk = level.chunks[i];
+        ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_SpanAvailWidth;
+        if (!chunk.container) flags |= ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
+
+        std::string label = tagText(chunk.tag, format.tagWidth);
+        if (chunk.container) label += " " + tagText(chunk.formType, format.formTypeWidth);
+        bool opened = ImGui::TreeNodeEx((void *) (uintptr_t) chunk.offset, flags, "%s  %llX  %llu bytes%s",
+                                        label.c_str(), (unsigned long long) chunk.offset,
+                                        (unsigned long long) chunk.size, chunk.truncated ? " (truncated)" : "");
+        if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) {
+            memEdit.GotoAddrAndHighlight(chunk.payload, chunk.payload + chunk.size);
+        }
+        if (ImGui::BeginPopupContextItem()) {
+            if (ImGui::MenuItem("Use as Vertices")) useChunkAs(chunk, 0, visParams);
+            if (ImGui::MenuItem("Use as 16-bit Indices")) useChunkAs(chunk, 1, visParams);
+            if (ImGui::MenuItem("Use as 32-bit Indices")) useChunkAs(chunk, 2, visParams);
+            ImGui::EndPopup();
+        }
+        if (opened && chunk.container) {
+            drawChunkLevel(view, chunk.payload, chunk.payload + chunk.size, memEdit, visParams);
+            ImGui::TreePop();
+        }
+    }
+
+    if (count < level.chunks.size() || !level.complete) {
+        ImGui::PushID((void *) (uintptr_t) begin);
+        if (ImGui::SmallButton("Show More")) level.shown += ChunkPage;
+        ImGui::PopID();
+    } else if (level.malformed) {
+        ImGui::TextDisabled("No chunk fits at %llX", (unsigned long long) level.next);
+    }
+}
+
+// A tag/size/payload hierarchy such as RIFF or IFF, read from the edited document a level at a time as nodes open
+void drawChunkWindow(ChunkView& view, const Document& document, MemoryEditor& memEdit, VisParams& visParams)
+{
+    ImGui::Begin("Chunks", &view.open);
+    if (ImGui::Combo("Format", &view.preset, chunkPresets, sizeof(chunkPresets) / sizeof(char *))) {
+        applyChunkPreset(view);
+        view.dirty = true;
+    }
+
+    if (view.preset == CPCustom) {
+        ChunkFormat& format = view.format;
+        int tagWidth = (int) format.tagWidth;
+        if (ImGui::InputInt("Tag Bytes", &tagWidth)) {
+            format.tagWidth = (uint32_t) std::clamp(tagWidth, 0, 8);
+            view.dirty = true;
+        }
+        int sizeIndex = format.sizeWidth == 8 ? 3 : (int) format.sizeWidth / 2;
+        if (ImGui::Combo("Size Bytes", &sizeIndex, chunkSizeWidths, sizeof(chunkSizeWidths) / sizeof(char *))) {
+            format.sizeWidth = 1u << sizeIndex;
+            view.dirty = true;
+        }
+        view.dirty |= ImGui::Checkbox("Big-Endian Size", &format.bigEndian);
+        view.dirty |= ImGui::Checkbox("Size Before Tag", &format.sizeFirst);
+        view.dirty |= ImGui::Checkbox("Size Includes Header", &format.sizeIncludesHeader);
+        int alignment = (int) format.alignment, trailer = (int) format.trailerWidth;
+        int formType = (int) format.formTypeWidth;
+        if (ImGui::InputInt("Alignment", &alignment)) {
+            format.alignment = (uint32_t) std::clamp(alignment, 1, 4096);
+            view.dirty = true;
+        }
+        if (ImGui::InputInt("Trailer Bytes", &trailer)) {
+            format.trailerWidth = (uint32_t) std::clamp(trailer, 0, 64);
+            view.dirty = true;
+        }
+        if (ImGui::InputInt("Form Type Bytes", &formType)) {
+            format.formTypeWidth = (uint32_t) std::clamp(formType, 0, 8);
+            view.dirty = true;
+        }
+        view.dirty |= ImGui::InputText("Containers", view.containers, sizeof(view.containers));
+        view.dirty |= ImGui::InputScalar("Start", ImGuiDataType_U64, &view.start, nullptr, nullptr, "%llX",
+                                         ImGuiInputTextFlags_CharsHexadecimal);
+        if (ImGui::Button("Start at Highlighted Address") && memEdit.DataEditingAddr != (size_t) -1) {
+            view.start = memEdit.DataEditingAddr;
+            view.dirty = true;
+        }
+    }
+
+    // Edits can move every chunk after them, so the tree starts over; open nodes reopen by offset as they're drawn
+    if (view.dirty || view.tree.revision() != document.table.revision()) {
+        parseContainerTags(view.containers, view.format);
+        view.tree.reset(&document.table, view.format, view.start, document.size());
+        view.dirty = false;
+    }
+
+    ImGui::Text("%zu chunks parsed", view.tree.parsedCount());
+    ImGui::TextDisabled("Click a chunk to select its payload, right-click to draw it");
+    ImGui::BeginChild("tree");
+    drawChunkLevel(view, view.start, document.size(), memEdit, visParams);
+    ImGui::EndChild();
+    ImGui::End();
+}
+
+const char *gallerySources[] = {
+    "Saved Candidates",
+    "Sweep Around Start"
+};
+
+enum GallerySource
+{
+    GSCandidates,
+    GSSweep
+};
+
+struct GalleryView
+{
+    bool open = false;
+    int source = GSCandidates;
+    int page = 0;
+    std::vector<VisParams> shown;  // what the atlas tiles should hold this frame
+};
+
+// Strides 12 to 40 at four word offsets from the current start, in both byte orders, each covering about the same
+// bytes as the current layout. That's one full page of the atlas.
+void sweepLayouts(const VisParams& visParams, std::vector<VisParams>& out)
+{
+    uint64_t span = std::max<uint64_t>(visParams.vertexCount, 3) * std::max<uint32_t>(visParams.vertexStride, 12);
+    for (int bigEndian = 1; bigEndian >= 0; bigEndian--) {
+        for (int shift = 0; shift < 16; shift += 4) {
+            for (int stride = 12; stride <= 40; stride += 4) {
+                VisParams params = visParams;
+                params.vertexBufferStart = visParams.vertexBufferStart + shift;
+                params.vertexStride = stride;
+                params.vertexCount = std::max<uint64_t>(span / stride, 3);
+                params.bigEndian = bigEndian;
+                params.indexedDraw = false;
+                params.meshType = MTPoint;
+                out.push_back(params);
+            }
+        }
+    }
+}
+
+void drawGalleryWindow(GalleryView& view, const ThumbnailAtlas& atlas, const std::vector<VisParams>& candidates,
+                       VisParams& visParams, bool& needsReupload)
+{
+    view.shown.clear();
+    ImGui::Begin("Candidate Gallery", &view.open);
+    ImGui::Combo("Source", &view.source, gallerySources, sizeof(gallerySources) / sizeof(char *));
+
+    if (view.source == GSSweep) {
+        sweepLayouts(visParams, view.shown);
+    } else {
+        int pages = std::max(1, (int) (candidates.size() + ThumbnailAtlas::TileCount - 1) / ThumbnailAtlas::TileCount);
+        view.page = std::clamp(view.page, 0, pages - 1);
+        if (pages > 1) ImGui::SliderInt("Page", &view.page, 0, pages - 1);
+
+        size_t first = (size_t) view.page * ThumbnailAtlas::TileCount;
+        size_t last = std::min(candidates.size(), first + ThumbnailAtlas::TileCount);
+        view.shown.assign(candidates.begin() + (ptrdiff_t) first, candidates.begin() + (ptrdiff_t) last);
+        if (view.shown.empty()) ImGui::TextDisabled("No candidates saved or detected yet");
+    }
+
+    for (int tile = 0; tile < (int) view.shown.size(); tile++) {
+        const VisParams& params = view.shown[tile];
+        float uv0[2], uv1[2];
+        atlas.tileUVs(tile, uv0, uv1);
+
+        ImGui::PushID(tile);
+        if (tile % ThumbnailAtlas::TilesPerRow) ImGui::SameLine();
+        if (ImGui::ImageButton("##tile", (ImTextureID) (intptr_t) atlas.texture(),
+                               ImVec2(ThumbnailAtlas::TileSize, ThumbnailAtlas::TileSize), ImVec2(uv0[0], uv0[1]),
+                               ImVec2(uv1[0], uv1[1]))) {
+            needsReupload |= params.bigEndian != visParams.bigEndian;
+            visParams = params;
+        }
+        ImGui::SetItemTooltip("%llX stride %u count %llu %s", (unsigned long long) params.vertexBufferStart,
+                              params.vertexStride, (unsigned long long) params.vertexCount,
+                              params.bigEndian ? "BE" : "LE");
+        ImGui::PopID();
+    }
+    ImGui::End();
+}
+
+// Draws from the windows prepareDraw mapped, so offsets are relative to where each window starts
+constexpr float CameraFovDegrees = 45.0f;
+
+// The orbit camera the viewport is drawn with, which picking unprojects the mouse through
+void cameraMatrices(const VisParams& visParams, glm::mat4& projection, glm::mat4& view)
+{
+    projection = glm::perspective(glm::radians(CameraFovDegrees), 1280.0f / 720.0f, 0.1f, 1000.0f);
+    view = glm::lookAt(glm::vec3(1, 1, 1) * visParams.viewDistance, glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+}
+
+void render(const VisParams& visParams, unsigned int vao, const DrawWindows& windows, unsigned int program)
+{
+    uint64_t vertexOffset = visParams.vertexBufferStart - windows.vertices.begin;
+    auto stride = (int) visParams.vertexStride;
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, windows.vertices.buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, windows.indices.buffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *) (uintptr_t) vertexOffset);
+    glEnableVertexAttribArray(0);
+
+    // Bound attributes must fit inside the vertex; anything else falls back to flat shading
+    auto bindAttribute = [&](unsigned location, int offset, int size, int components, unsigned type, bool normalized) {
+        bool bound = offset >= 0 && offset + size <= stride;
+        if (bound) {
+            glVertexAttribPointer(location, components, type, normalized, stride,
+                                  (void *) (uintptr_t) (vertexOffset + (uint64_t) offset));
+            glEnableVertexAttribArray(location);
+        } else {
+            glDisableVertexAttribArray(location);
+        }
+        return bound;
+    };
+    bool hasNormal = bindAttribute(1, visParams.normalOffset, 12, 3, GL_FLOAT, false);
+    bool hasTexCoord = visParams.halfTexCoords ? bindAttribute(2, visParams.texCoordOffset, 4, 2, GL_HALF_FLOAT, false)
+                                               : bindAttribute(2, visParams.texCoordOffset, 8, 2, GL_FLOAT, false);
+    bool hasColor = bindAttribute(3, visParams.colorOffset, 4, 4, GL_UNSIGNED_BYTE, true);
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "hasNormal"), hasNormal);
+    glUniform1i(glGetUniformLocation(program, "hasTexCoord"), hasTexCoord);
+    glUniform1i(glGetUniformLocation(program, "hasColor"), hasColor);
+    glUniform1i(glGetUniformLocation(program, "highlight"), false);
+
+    // Big-endian uploads reverse the bytes of every word, which reverses byte colors and swaps half pairs
+    glUniform1i(glGetUniformLocation(program, "colorReversed"), visParams.bigEndian);
+    glUniform1i(glGetUniformLocation(program, "texCoordSwapped"), visParams.bigEndian && visParams.halfTexCoords);
+
+    if (visParams.backfaceCulling) glEnable(GL_CULL_FACE);
+    else
+        glDisable(GL_CULL_FACE);
+
+    glPolygonMode(GL_FRONT_AND_BACK, polygonModeGLConstants[visParams.polygonMode]);
+
+    glm::mat4 projection, view;
+    cameraMatrices(visParams, projection, view);
+    auto model = glm::identity<glm::mat4>();
+    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(model));
+
+    unsigned mode = meshTypeGLConstants[visParams.meshType];
+
+    if (visParams.indexedDraw) {
+        glDrawElements(mode, (int) visParams.vertexCount,
+                       visParams.halfWidthIndexes ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                       ((void *) (uintptr_t) (visParams.indexBufferStart - windows.indices.begin)));
+    } else {
+        glDrawArrays(mode, 0, (int) visParams.vertexCount);
+    }
+}
+
+// How far from a vertex, in framebuffer pixels, a click still picks it
+constexpr float PickPixels = 8.0f;
+
+// The pick tree over the drawn vertices, built on the first click after the layout or its bytes change
+struct PickView
+{
+    std::shared_ptr<const PickTree> tree;
+    std::future<std::shared_ptr<const PickTree>> pending;
+    VisParams layout;  // what the tree, or the pending one, was built from
+    uint64_t revision = UINT64_MAX;
+    uint64_t vertexCount = 0;
+    bool clickWaiting = false;  // a click that arrived while the tree was building, answered once it's done
+    float origin[3] = {};
+    float direction[3] = {};
+    float spread = 0.0f;
+    uint64_t picked = UINT64_MAX;
+};
+
+// Vertices the layout reads: all of them, or as far as the index buffer reaches
+uint64_t drawnVertexCount(const VisParams& visParams, const DrawWindows& windows)
+{
+    return visParams.indexedDraw ? windows.maxIndex + 1 : (uint64_t) visParams.vertexCount;
+}
+
+// Builds the tree from a snapshot, so edits made meanwhile don't tear the positions it reads
+void startPickTree(PickView& view, const Document& document, const VisParams& visParams, uint64_t vertices)
+{
+    uint64_t stride = visParams.vertexStride ? visParams.vertexStride : 12;
+    view.tree.reset();
+    view.layout = visParams;
+    view.revision = document.table.revision();
+    view.vertexCount = vertices;
+    view.picked = UINT64_MAX;
+    view.pending = workerPool().async([snapshot = document.table.snapshot(), start = visParams.vertexBufferStart,
+                                       vertices, stride, bigEndian = visParams.bigEndian] {
+        std::vector<uint8_t> scratch;
+        const uint8_t *bytes = snapshot->contiguous(start, (vertices - 1) * stride + 12, scratch);
+        auto tree = std::make_shared<PickTree>();
+        buildPickTree(bytes, vertices, (uint32_t) stride, bigEndian, *tree);
+        return std::shared_ptr<const PickTree>(std::move(tree));
+    });
+}
+
+// Casts a ray through the mouse, which must be over the viewport. The viewport is drawn into whatever GL_VIEWPORT
+// was when the context was created, so the mouse is mapped through it rather than the window size.
+void requestPick(PickView& view, const Document& document, const VisParams& visParams, const DrawWindows& windows)
+{
+    const ImGuiIO& io = ImGui::GetIO();
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    if (viewport[2] <= 0 || viewport[3] <= 0) return;
+
+    float x = io.MousePos.x * io.DisplayFramebufferScale.x;
+    float y = (io.DisplaySize.y - io.MousePos.y) * io.DisplayFramebufferScale.y;
+    glm::vec2 ndc((x - (float) viewport[0]) / (float) viewport[2] * 2.0f - 1.0f,
+                  (y - (float) viewport[1]) / (float) viewport[3] * 2.0f - 1.0f);
+    if (std::abs(ndc.x) > 1.0f || std::abs(ndc.y) > 1.0f) return;
+
+    glm::mat4 projection, camera;
+    cameraMatrices(visParams, projection, camera);
+    glm::mat4 inverse = glm::inverse(projection * camera);
+    glm::vec4 nearPoint = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(1, 1, 1) * visParams.viewDistance;
+    glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - glm::vec3(nearPoint) / nearPoint.w);
+    for (int axis = 0; axis < 3; axis++) {
+        view.origin[axis] = origin[axis];
+        view.direction[axis] = direction[axis];
+    }
+    view.spread = 2.0f * std::tan(glm::radians(CameraFovDegrees) / 2.0f) * PickPixels *
+                  io.DisplayFramebufferScale.y / (float) viewport[3];
+    view.clickWaiting = true;
+
+    uint64_t vertices = drawnVertexCount(visParams, windows);
+    if (!sameLayout(view.layout, visParams) || view.revision != document.table.revision() ||
+        view.vertexCount != vertices) {
+        startPickTree(view, document, visParams, vertices);
+    }
+}
+
+// Answers a waiting click once pollTab has collected its tree, jumping the hex view to the picked vertex and
+// highlighting its stride
+void pollPick(PickView& view, const VisParams& visParams, MemoryEditor& memEdit)
+{
+    if (!view.clickWaiting || !view.tree) return;
+    view.clickWaiting = false;
+
+    uint64_t vertex;
+    if (!pickVertex(*view.tree, view.origin, view.direction, 0.0f, view.spread, vertex)) {
+        view.picked = UINT64_MAX;
+        return;
+    }
+    view.picked = vertex;
+    uint64_t stride = visParams.vertexStride ? visParams.vertexStride : 12;
+    uint64_t begin = visParams.vertexBufferStart + vertex * stride;
+    memEdit.GotoAddrAndHighlight(begin, begin + stride);
+}
+
+// The vertex under the mouse in the hex view, else the last one picked
+uint64_t highlightedVertex(const PickView& view, const VisParams& visParams, const DrawWindows& windows,
+                           const MemoryEditor& memEdit)
+{
+    uint64_t vertices = drawnVertexCount(visParams, windows);
+    uint64_t stride = visParams.vertexStride ? visParams.vertexStride : 12;
+    uint64_t hovered = memEdit.HoveredAddr;
+    if (hovered != (size_t) -1 && hovered >= visParams.vertexBufferStart &&
+        (hovered - visParams.vertexBufferStart) / stride < vertices) {
+        return (hovered - visParams.vertexBufferStart) / stride;
+    }
+    return view.picked < vertices ? view.picked : UINT64_MAX;
+}
+
+// Marks one vertex over the mesh render() just drew, reusing its bindings
+void renderHighlight(unsigned int program, uint64_t vertex)
+{
+    glUniform1i(glGetUniformLocation(program, "highlight"), true);
+    glDisable(GL_DEPTH_TEST);
+    glPointSize(12.0f);
+    glDrawArrays(GL_POINTS, (int) vertex, 1);
+    glPointSize(4.0f);
+    glEnable(GL_DEPTH_TEST);
+    glUniform1i(glGetUniformLocation(program, "highlight"), false);
+}
+
+enum ScanUnit
+{
+    SUStride,
+    SUByte
+};
+
+const char *scanUnitNames[] = {
+    "Stride",
+    "Byte"
+};
+
+// Bytes of a spare window uploaded per frame while scanning, few enough not to hold a frame up
+constexpr uint64_t ScanSliceBytes = 4 << 20;
+
+// A vertex window uploaded ahead of the layout reaching it, a slice per frame until it's loaded
+struct ScanSpare
+{
+    GpuWindow window;
+    uint64_t filled = 0;
+    std::future<std::vector<uint8_t>> staged;  // the next slice, read and swapped on the pool
+};
+
+// Steps the vertex start through the file, to watch for the mesh snapping into shape. The drawn window is padded,
+// so most steps upload nothing; the windows on either side of it are filled ahead of time in two spares, so crossing
+// into one is a buffer swap rather than a stall.
+struct ScanView
 {
-    MTTriangle,
-    MTTriangleStrip,
-    MTTriangleFan,
-    MTQuad,
-    MTQuadStrip,
-    MTLine,
-    MTLineStrip,
-    MTLineLoop,
-    MTPoint
+    bool open = false;
+    bool playing = false;
+    int unit = SUStride;
+    int direction = 1;
+    float rate = 30.0f;  // steps per second
+    double owed = 0.0;   // part of a step carried over to the next frame
+    ScanSpare spares[2];
 };
 
-const char *meshTypes[] = {
-    "Triangle",
-    "Triangle Strip",
-    "Triangle Fan",
-    "Quad",
-    "Quad Strip",
-    "Line",
-    "Line Strip",
-    "Line Loop",
-    "Point"
-};
+// Bytes one draw reads from its first vertex on
+uint64_t vertexSpan(const VisParams& visParams, const DrawWindows& windows)
+{
+    uint64_t stride = visParams.vertexStride ? visParams.vertexStride : 12;
+    uint64_t vertices = drawnVertexCount(visParams, windows);
+    return vertices ? (vertices - 1) * stride + std::max<uint64_t>(stride, 12) : 0;
+}
 
-unsigned meshTypeGLConstants[] = {
-    GL_TRIANGLES,
-    GL_TRIANGLE_STRIP,
-    GL_TRIANGLE_FAN,
-    GL_QUADS,
-    GL_QUAD_STRIP,
-    GL_LINES,
-    GL_LINE_STRIP,
-    GL_LINE_LOOP,
-    GL_POINTS
-};
+bool windowCovers(const GpuWindow& window, uint64_t begin, uint64_t end, uint64_t revision, bool bigEndian)
+{
+    return window.begin <= begin && end <= window.end && window.revision == revision && window.bigEndian == bigEndian;
+}
 
-struct VisParams
+// Moves the start by the steps played this frame plus any arrow presses. Playing stops at the start of the document,
+// or where the layout would read past its end.
+void advanceScan(ScanView& view, VisParams& visParams, const DrawWindows& windows, uint64_t documentSize)
 {
-    int vertexBufferStart = 0;
-    int indexBufferStart = 0;
-    int vertexCount = 3;
-    int vertexStride = 12;
-    bool bigEndian = true;
-    bool backfaceCulling = false;
-    float viewDistance = 3.0f;
-    bool indexedDraw = false;
-    bool halfWidthIndexes = false;
-    PolygonMode polygonMode = PMFill;
-    MeshType meshType = MTTriangle;
-};
+    int64_t steps = 0;
+    if (view.playing) {
+        view.owed += (double) ImGui::GetIO().DeltaTime * view.rate;
+        steps = (int64_t) view.owed;
+        view.owed -= (double) steps;
+        steps *= view.direction;
+    }
+    if (!ImGui::GetIO().WantCaptureKeyboard) {
+        if (ImGui::IsKeyPressed(ImGuiKey_RightArrow)) {
+            view.direction = 1;
+            steps++;
+        }
+        if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) {
+            view.direction = -1;
+            steps--;
+        }
+    }
+    if (steps == 0) return;
+
+    uint64_t step = view.unit == SUByte ? 1 : visParams.vertexStride ? visParams.vertexStride : 12;
+    uint64_t distance = (uint64_t) std::abs(steps) * step;
+    uint64_t span = vertexSpan(visParams, windows);
+    uint64_t last = documentSize > span ? documentSize - span : 0;
+    uint64_t start = visParams.vertexBufferStart;
+    if (steps < 0) {
+        start = distance > start ? 0 : start - distance;
+        if (start == 0) view.playing = false;
+    } else {
+        start = std::min(std::max(last, start), start + distance);
+        if (start >= last) view.playing = false;
+    }
+    visParams.vertexBufferStart = start;
+}
+
+// Swaps in a filled spare once the layout has moved out of the drawn window and into it. The window swapped out is
+// kept loaded, as it's the one to fall back into when scrubbing back.
+void adoptSpare(ScanView& view, DrawWindows& windows, const Document& document, const VisParams& visParams)
+{
+    uint64_t begin = visParams.vertexBufferStart;
+    uint64_t end = std::min<uint64_t>(document.size(), begin + vertexSpan(visParams, windows));
+    uint64_t revision = document.table.revision();
+    if (windows.vertices.loaded && windowCovers(windows.vertices, begin, end, revision, visParams.bigEndian)) return;
+
+    for (ScanSpare& spare: view.spares) {
+        if (!spare.window.loaded || !windowCovers(spare.window, begin, end, revision, visParams.bigEndian)) continue;
+        std::swap(windows.vertices, spare.window);
+        spare.filled = spare.window.loaded ? spare.window.end - spare.window.begin : 0;
+        return;
+    }
+}
 
-void copyToGPU(unsigned vbo, std::vector<uint8_t>& data, bool& bigEndian)
+// Uploads the next slice of a spare: first the window the scan is heading into, then the one behind it. Each spans
+// the drawn bytes plus both paddings, so it holds as many steps as a window mapWindow uploads.
+void fillSpares(ScanView& view, const DrawWindows& windows, const Document& document, const VisParams& visParams)
 {
-    // TODO: Endian swap should take into account offset, probably requiring a re-upload with each address change
-    std::vector<uint8_t> endianSwappedData;
-    std::vector<uint8_t> *pData = &data;
+    const GpuWindow& front = windows.vertices;
+    uint64_t size = document.size();
+    uint64_t span = std::min(vertexSpan(visParams, windows), size);
+    uint64_t revision = document.table.revision();
+    if (!front.loaded || span + 2 * WindowPadding > MaxWindowBytes) return;
 
-    if (bigEndian) {
-        endianSwappedData.resize(data.size());
+    // Each way, the first start past the drawn window and the window that would take over from there
+    struct Way
+    {
+        bool exists;
+        uint64_t next, begin, end;
+    };
+    auto way = [&](int direction) {
+        if (direction > 0) {
+            if (front.end >= size) return Way{ false, 0, 0, 0 };
+            uint64_t next = front.end - span + 1;
+            uint64_t begin = next & ~(uint64_t) 0xFFFF;
+            return Way{ true, next, begin, std::min(size, begin + span + 2 * WindowPadding) };
+        }
+        if (front.begin == 0) return Way{ false, 0, 0, 0 };
+        uint64_t end = std::min(size, front.begin + span);
+        uint64_t begin = (end > span + 2 * WindowPadding ? end - span - 2 * WindowPadding : 0) & ~(uint64_t) 0xFFFF;
+        return Way{ true, front.begin - 1, begin, end };
+    };
+    Way ways[2] = { way(view.direction), way(-view.direction) };
+    auto holds = [&](const ScanSpare& spare, const Way& w) {
+        return w.exists && windowCovers(spare.window, w.next, w.next + span, revision, visParams.bigEndian);
+    };
 
-        for (int i = 0; i < data.size(); i += 4) {
-            endianSwappedData[i] = data[i + 3];
-            endianSwappedData[i + 1] = data[i + 2];
-            endianSwappedData[i + 2] = data[i + 1];
-            endianSwappedData[i + 3] = data[i];
+    for (int k = 0; k < 2; k++) {
+        if (!ways[k].exists) continue;
+        ScanSpare *target = nullptr;
+        for (ScanSpare& spare: view.spares) {
+            if (holds(spare, ways[k])) target = &spare;
+        }
+        if (target && target->window.loaded) continue;
+        if (!target) {
+            target = holds(view.spares[0], ways[1 - k]) ? &view.spares[1] : &view.spares[0];
+            GpuWindow& window = target->window;
+            if (!window.buffer) glGenBuffers(1, &window.buffer);
+            window.begin = ways[k].begin;
+            window.end = ways[k].end;
+            window.revision = revision;
+            window.bigEndian = visParams.bigEndian;
+            window.loaded = false;
+            target->filled = 0;
+            target->staged = {};
+            glBindBuffer(GL_ARRAY_BUFFER, window.buffer);
+            glBufferData(GL_ARRAY_BUFFER, (long) (window.end - window.begin), nullptr, GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
         }
 
-        pData = &endianSwappedData;
+        // Slices are copied out of a snapshot on the pool, leaving only the GL upload to this thread. They start a
+        // multiple of their size past a 64 KiB boundary, so big-endian word swaps still line up.
+        GpuWindow& window = target->window;
+        if (target->staged.valid()) {
+            if (!isFutureReady(target->staged)) return;
+            std::vector<uint8_t> uploadData = target->staged.get();
+            glBindBuffer(GL_ARRAY_BUFFER, window.buffer);
+            glBufferSubData(GL_ARRAY_BUFFER, (long) target->filled, (long) uploadData.size(), uploadData.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            window.uploaded += uploadData.size();
+            target->filled += uploadData.size();
+            window.loaded = target->filled == window.end - window.begin;
+            if (window.loaded) return;
+        }
+        uint64_t offset = window.begin + target->filled;
+        uint64_t length = std::min(ScanSliceBytes, window.end - offset);
+        target->staged = workerPool().async([snapshot = document.table.snapshot(), offset, length,
+                                             bigEndian = window.bigEndian] {
+            std::vector<uint8_t> uploadData;
+            prepareUpload(*snapshot, offset, length, bigEndian, uploadData);
+            return uploadData;
+        });
+        return;
     }
-
-    // Update buffer bindings
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, (long) pData->size(), pData->data(), GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-unsigned compileShader(const char *source, unsigned type)
+void drawScanWindow(ScanView& view, VisParams& visParams, const DrawWindows& windows, uint64_t documentSize)
 {
-    unsigned shader = glCreateShader(type);
-    glShaderSource(shader, 1, &source, nullptr);
-    glCompileShader(shader);
+    ImGui::Begin("Scan", &view.open);
+    if (ImGui::Button("<")) {
+        view.direction = -1;
+        view.playing = true;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button(view.playing ? "Pause" : "Play")) view.playing = !view.playing;
+    ImGui::SameLine();
+    if (ImGui::Button(">")) {
+        view.direction = 1;
+        view.playing = true;
+    }
+    ImGui::SameLine();
+    ImGui::Text("Start %llX", (unsigned long long) visParams.vertexBufferStart);
 
-    int status;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    if (!status) {
-        std::cerr << "Error compiling shader: " << (type == GL_VERTEX_SHADER ? "Vertex" : "Fragment") << std::endl;
+    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+    ImGui::Combo("Step", &view.unit, scanUnitNames, sizeof(scanUnitNames) / sizeof(char *));
+    ImGui::SameLine();
+    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 10);
+    ImGui::SliderFloat("Steps per Second", &view.rate, 1.0f, 1000.0f, "%.0f", ImGuiSliderFlags_Logarithmic);
+    ImGui::TextDisabled("Left and right arrows step once");
+
+    for (const ScanSpare& spare: view.spares) {
+        uint64_t bytes = spare.window.end - spare.window.begin;
+        if (bytes == 0) continue;
+        ImGui::ProgressBar((float) spare.filled / (float) bytes, ImVec2(ImGui::GetFontSize() * 15, 0));
+        ImGui::SameLine();
+        ImGui::Text("%llX-%llX", (unsigned long long) spare.window.begin, (unsigned long long) spare.window.end);
     }
+    ImGui::End();
 
-    return shader;
+    advanceScan(view, visParams, windows, documentSize);
 }
 
-bool
-drawVisMenu(VisParams& visParams, int editAddress)
+struct BenchOptions
 {
-    bool needsReupload = false;
+    std::string path;              // empty unless --bench was given
+    int frames = 120;              // per polygon mode and mesh type
+    uint32_t stride = 12;
+    uint64_t count = 1 << 16;
+    uint64_t start = 0;            // the range the vertex buffer start sweeps, clamped to the file
+    uint64_t end = UINT64_MAX;
+    std::string output = "hexspanned-bench.json";
+};
 
-    ImGui::Begin("Vertex Visualization");
-    ImGui::InputInt("Start", &visParams.vertexBufferStart, 1, 100, ImGuiInputTextFlags_CharsHexadecimal);
-    if (ImGui::Button("Set to Highlighted Address")) {
-        visParams.vertexBufferStart = editAddress;
+json summarizeFrames(std::vector<double> values)
+{
+    if (values.empty()) return json::object();
+    double sum = 0.0;
+    for (double value: values) sum += value;
+    std::sort(values.begin(), values.end());
+    return { { "mean", sum / (double) values.size() }, { "median", values[values.size() / 2] },
+             { "p95", values[std::min(values.size() - 1, values.size() * 95 / 100)] }, { "max", values.back() } };
+}
+
+// Draws the file with a fixed stride and count while sweeping the start across it, or across the range given, the same
+// offsets for every polygon mode and mesh type, and writes per-frame CPU time, upload bytes and GPU draw time to JSON.
+// Every combination starts from empty windows and nothing depends on the clock, so runs on the same file compare
+// between builds.
+int runBench(const BenchOptions& options, GLFWwindow *window, unsigned vao, unsigned program)
+{
+    Document document;
+    if (!document.open(std::filesystem::absolute(options.path).string())) return 1;
+
+    uint64_t span = options.count * options.stride;
+    uint64_t end = std::min<uint64_t>(options.end, document.size());
+    if (options.frames <= 0 || options.count == 0 || options.stride < 12 || options.start > end ||
+        span > end - options.start) {
+        std::cerr << "Benchmark layout doesn't fit in " << options.path << std::endl;
+        return 1;
     }
+    uint64_t step = ((end - options.start - span) / (uint64_t) options.frames) & ~(uint64_t) 3;
 
-    if (visParams.indexedDraw) {
-        ImGui::InputInt("Index Start", &visParams.indexBufferStart, 1, 100, ImGuiInputTextFlags_CharsHexadecimal);
-        if (ImGui::Button("Set to Highlighted Address##STHA_IND")) {
-            visParams.indexBufferStart = editAddress;
+    DrawWindows windows;
+    glGenBuffers(1, &windows.vertices.buffer);
+    glGenBuffers(1, &windows.indices.buffer);
+    unsigned query;
+    glGenQueries(1, &query);
+    glfwSwapInterval(0);
+
+    json out;
+    out["file"] = { { "path", options.path }, { "bytes", document.size() } };
+    out["layout"] = { { "stride", options.stride }, { "count", options.count }, { "start", options.start },
+                      { "end", end }, { "step", step }, { "frames", options.frames } };
+    out["renderer"] = (const char *) glGetString(GL_RENDERER);
+    out["runs"] = json::array();
+
+    for (int polygonMode = PMFill; polygonMode <= PMPoint; polygonMode++) {
+        for (int meshType = MTTriangle; meshType <= MTPoint; meshType++) {
+            VisParams visParams;
+            visParams.vertexStride = options.stride;
+            visParams.vertexCount = options.count;
+            visParams.bigEndian = false;
+            visParams.polygonMode = (PolygonMode) polygonMode;
+            visParams.meshType = (MeshType) meshType;
+            windows.vertices.loaded = windows.indices.loaded = false;
+            while (glGetError() != GL_NO_ERROR) {}
+
+            std::vector<double> cpuTimes, drawTimes;
+            std::vector<uint64_t> uploads;
+            for (int frame = 0; frame < options.frames; frame++) {
+                visParams.vertexBufferStart = options.start + (uint64_t) frame * step;
+                uint64_t uploadedBefore = windows.vertices.uploaded;
+
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                auto start = std::chrono::steady_clock::now();
+                glBeginQuery(GL_TIME_ELAPSED, query);
+                if (prepareDraw(windows, document, visParams) == DCDrawable) {
+                    render(visParams, vao, windows, program);
+                }
+                glEndQuery(GL_TIME_ELAPSED);
+                std::chrono::duration<double, std::milli> cpu = std::chrono::steady_clock::now() - start;
+
+                uint64_t elapsed = 0;
+                glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+                cpuTimes.push_back(cpu.count());
+                drawTimes.push_back((double) elapsed / 1e6);
+                uploads.push_back(windows.vertices.uploaded - uploadedBefore);
+
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+
+            // Quads aren't part of core profiles, so some combinations are expected to report an error
+            unsigned error = glGetError();
+            uint64_t uploadTotal = 0;
+            for (uint64_t bytes: uploads) uploadTotal += bytes;
+            out["runs"].push_back({ { "polygon_mode", polygonModes[polygonMode] },
+                                    { "mesh_type", meshTypes[meshType] },
+                                    { "gl_error", error },
+                                    { "cpu_ms", summarizeFrames(cpuTimes) },
+                                    { "draw_ms", summarizeFrames(drawTimes) },
+                                    { "upload_bytes", uploadTotal },
+                                    { "frames", { { "cpu_ms", cpuTimes }, { "draw_ms", drawTimes },
+                                                  { "upload_bytes", uploads } } } });
         }
     }
 
-    ImGui::InputInt("Count", &visParams.vertexCount, 1, 100, 0);
-    ImGui::InputInt("Stride", &visParams.vertexStride, 1, 100, 0);
-    ImGui::Checkbox("Indexed Draw", &visParams.indexedDraw);
+    glDeleteQueries(1, &query);
+    glDeleteBuffers(1, &windows.vertices.buffer);
+    glDeleteBuffers(1, &windows.indices.buffer);
 
-    if (visParams.indexedDraw) {
-        ImGui::Checkbox("Half-Width (16-bit) Indexes", &visParams.halfWidthIndexes);
+    std::ofstream file(options.output);
+    if (!file.is_open()) {
+        std::cerr << "Error writing benchmark results: " << options.output << std::endl;
+        return 1;
     }
+    file << out.dump(2) << std::endl;
+    std::cout << "Wrote " << out["runs"].size() << " runs to " << options.output << std::endl;
+    return 0;
+}
 
-    if (ImGui::Checkbox("Big-Endian", &visParams.bigEndian)) {
-        needsReupload = true;
+// Frame times of a replay next to those the recording saw, to stdout or to `output`. Frames past 60 Hz are counted as
+// slow, since that's where lag starts to show.
+bool writeReplayReport(const InputRecording& recording, const std::vector<double>& frameTimes,
+                       const std::string& output)
+{
+    std::vector<double> recordedTimes;
+    for (const RecordedFrame& frame: recording.frames) recordedTimes.push_back(frame.deltaTime * 1000.0);
+    size_t slow = std::count_if(frameTimes.begin(), frameTimes.end(), [](double ms) { return ms > 1000.0 / 60.0; });
+
+    json out;
+    out["frames"] = frameTimes.size();
+    out["recorded_seconds"] = recording.frames.empty() ? 0.0 : recording.frames.back().time;
+    out["frame_ms"] = summarizeFrames(frameTimes);
+    out["recorded_frame_ms"] = summarizeFrames(recordedTimes);
+    out["slow_frames"] = slow;
+    out["per_frame_ms"] = frameTimes;
+
+    if (output.empty()) {
+        std::cout << out.dump(2) << std::endl;
+        return true;
+    }
+    std::ofstream file(output);
+    if (!file.is_open()) {
+        std::cerr << "Error writing replay report: " << output << std::endl;
+        return false;
     }
+    file << out.dump(2) << std::endl;
+    return true;
+}
 
-    ImGui::Combo("Polygon Mode", (int *) &visParams.polygonMode, polygonModes, sizeof(polygonModes) / sizeof(char *));
-    ImGui::Combo("Mesh Type", (int *) &visParams.meshType, meshTypes, sizeof(meshTypes) / sizeof(char *));
-    ImGui::Checkbox("Backface Culling", &visParams.backfaceCulling);
-    ImGui::InputFloat("View Distance", &visParams.viewDistance);
-    ImGui::End();
+// One open file and everything viewing it. Tabs share the worker pool, the session cache and the GL program.
+struct Tab
+{
+    int id = 0;
+    uint64_t lastActive = 0;  // frame the tab was last shown, for evicting the longest hidden first
+    bool confirmClose = false;
+    Document document;
+    MemoryEditor memEdit;
+    VisParams visParams;
+    SessionState sessionState;
+    FileWatcher fileWatcher;
+    std::future<ReloadResult> pendingReload;
+    bool changedOnDisk = false;
+    DrawWindows drawWindows;
+    ScoreView scoreView;
+    LaneView laneView;
+    PointerView pointerView;
+    StringView stringView;
+    ChunkView chunkView;
+    PickView pickView;
+    ScanView scanView;
+    DiffView diffView;
+    TemplateView templateView;
+};
+
+// Bytes a tab holds that can be rebuilt: uploaded windows and finished analyses. The mapping itself is left to the OS.
+uint64_t tabFootprint(const Tab& tab)
+{
+    uint64_t bytes = 0;
+    for (const GpuWindow *window: { &tab.drawWindows.vertices, &tab.drawWindows.indices }) {
+        if (window->loaded) bytes += window->end - window->begin;
+    }
+    if (const PointerGraph *graph = tab.pointerView.graph.get()) {
+        bytes += graph->pointers.size() * sizeof(Pointer) + graph->byTarget.size() * sizeof(uint32_t);
+    }
+    if (const StringIndex *index = tab.stringView.index.get()) {
+        bytes += index->strings.size() * sizeof(FoundString) + index->sorted.size() * sizeof(uint32_t) +
+                 index->pool.size();
+    }
+    bytes += tab.chunkView.tree.parsedCount() * sizeof(Chunk);
+    bytes += tab.laneView.lanes.size() * sizeof(AttributeLane);
+    // A spare's buffer is allocated at full size as soon as it starts filling
+    for (const ScanSpare& spare: tab.scanView.spares) {
+        if (spare.window.buffer) bytes += spare.window.end - spare.window.begin;
+    }
+    if (const PickTree *tree = tab.pickView.tree.get()) {
+        bytes += tree->positions.size() * sizeof(float) + tree->order.size() * sizeof(uint32_t) +
+                 tree->nodes.size() * sizeof(PickTree::Node);
+    }
+    bytes += tab.diffView.diff.ranges().size() * sizeof(DiffRange);
+    bytes += tab.templateView.layout.offsets.size() * sizeof(uint64_t);
+    return bytes;
+}
+
+// Drops what tabFootprint counts; each is rebuilt when the tab is shown again, or rescanned on request
+void evictCaches(Tab& tab)
+{
+    for (GpuWindow *window: { &tab.drawWindows.vertices, &tab.drawWindows.indices }) {
+        if (!window->loaded) continue;
+        glBindBuffer(GL_ARRAY_BUFFER, window->buffer);
+        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        window->loaded = false;
+    }
+    tab.drawWindows.measuredRevision = UINT64_MAX;
+    tab.pointerView.graph.reset();
+    tab.pointerView.file = nullptr;
+    tab.pointerView.lookedUp = (size_t) -1;
+    tab.stringView.index.reset();
+    tab.stringView.file = nullptr;
+    tab.chunkView.tree = ChunkTree();
+    tab.chunkView.dirty = true;
+    if (tab.laneView.cancel) *tab.laneView.cancel = true;
+    tab.laneView.pending = {};
+    tab.laneView.lanes.clear();
+    tab.laneView.valid = false;
+    tab.pickView.tree.reset();
+    tab.pickView.revision = UINT64_MAX;
+    for (ScanSpare& spare: tab.scanView.spares) {
+        if (!spare.window.buffer) continue;
+        glBindBuffer(GL_ARRAY_BUFFER, spare.window.buffer);
+        glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        spare.window.begin = spare.window.end = 0;
+        spare.window.loaded = false;
+        spare.filled = 0;
+        spare.staged = {};
+    }
+    if (tab.diffView.open && !tab.diffView.diff.ranges().empty()) {
+        tab.diffView.diff.clear();
+        tab.diffView.evicted = true;
+    }
+    if (tab.templateView.cancelLayout) *tab.templateView.cancelLayout = true;
+    tab.templateView.pendingLayout = {};
+    tab.templateView.layout = RecordLayout();
+    tab.templateView.layoutDirty = true;
+}
+
+// Evicts hidden tabs, longest hidden first, until everything fits in the budget. The active tab is never evicted.
+void enforceMemoryBudget(std::vector<std::unique_ptr<Tab>>& tabs, size_t activeTab, uint64_t budget)
+{
+    uint64_t total = 0;
+    std::vector<std::pair<uint64_t, size_t>> hidden;  // last active, tab
+    for (size_t i = 0; i < tabs.size(); i++) {
+        uint64_t bytes = tabFootprint(*tabs[i]);
+        total += bytes;
+        if (i != activeTab && bytes) hidden.emplace_back(tabs[i]->lastActive, i);
+    }
+    std::sort(hidden.begin(), hidden.end());
+    for (size_t k = 0; k < hidden.size() && total > budget; k++) {
+        Tab& tab = *tabs[hidden[k].second];
+        total -= tabFootprint(tab);
+        evictCaches(tab);
+    }
+}
+
+// Session, file watching and reloads carry on in every tab, though only the active one asks what to do with edits
+bool pollTab(Tab& tab, SessionCache& cache, bool active)
+{
+    Document& document = tab.document;
+    bool needsReupload = pollSession(cache, tab.sessionState, document, tab.visParams, tab.memEdit);
 
+    bool reloadRequested = false;
+    FileChange change = document.isOpen() ? tab.fileWatcher.poll() : FCNone;
+    if (change == FCPending) {
+        guardTruncation(document);
+    } else if (change == FCSettled) {
+        guardTruncation(document);
+        if (document.isModified()) tab.changedOnDisk = true;
+        else reloadRequested = true;
+    }
+    if (tab.changedOnDisk && active) {
+        drawChangedOnDiskWindow(tab.changedOnDisk, reloadRequested);
+    }
+    if (reloadRequested) {
+        // A reload already in flight may have missed the latest write, so start over
+        tab.pendingReload = startReload(document.path, tab.sessionState);
+    }
+    if (isFutureReady(tab.pendingReload)) {
+        ReloadResult result = tab.pendingReload.get();
+        applyReload(result, document, cache, tab.sessionState, tab.drawWindows);
+        storeSession(cache, tab.sessionState, tab.visParams, tab.memEdit);
+    }
+    if (isFutureReady(tab.pickView.pending)) tab.pickView.tree = tab.pickView.pending.get();
+    if (needsReupload) {
+        tab.drawWindows.vertices.loaded = tab.drawWindows.indices.loaded = false;
+    }
     return needsReupload;
 }
 
-void loadFile(const std::string& name, std::vector<uint8_t>& data, unsigned& vbo, VisParams& visParams)
+// Background jobs hold their own reference to the mapping, so they're only told to stop, not waited for
+void closeTab(Tab& tab, SessionCache& cache)
 {
-    // Load file to byte buffer
-    std::ifstream in(name, std::ios::binary | std::ios::ate);
-    auto size = in.tellg();
-    data.resize(size);
-    in.seekg(0, std::ios::beg);
-    in.read((char *) data.data(), size);
-    in.close();
+    storeSession(cache, tab.sessionState, tab.visParams, tab.memEdit);
+    for (const auto& cancel: { tab.sessionState.cancelDigest, tab.sessionState.cancelDetection, tab.pointerView.cancel,
+                         tab.stringView.cancel, tab.templateView.cancelLayout, tab.laneView.cancel }) {
+        if (cancel) *cancel = true;
+    }
+    glDeleteBuffers(1, &tab.drawWindows.vertices.buffer);
+    glDeleteBuffers(1, &tab.drawWindows.indices.buffer);
+    for (ScanSpare& spare: tab.scanView.spares) {
+        if (spare.window.buffer) glDeleteBuffers(1, &spare.window.buffer);
+    }
+}
 
-    copyToGPU(vbo, data, visParams.bigEndian);
+void drawUnsavedCloseWindow(Tab& tab, bool& closeRequested)
+{
+    std::string title = "Unsaved Edits##" + std::to_string(tab.id);
+    ImGui::Begin(title.c_str(), nullptr, ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::Text("%s has unsaved edits.", std::filesystem::path(tab.document.path).filename().string().c_str());
+    if (ImGui::Button("Close and Discard Edits")) {
+        closeRequested = true;
+        tab.confirmClose = false;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Keep Open")) {
+        tab.confirmClose = false;
+    }
+    ImGui::End();
 }
 
-void render(const VisParams& visParams, unsigned int vao, unsigned int vbo, unsigned int program)
+// The tab bar of open files; returns the tab the user picked, or `activeTab` if none was clicked
+size_t drawFilesWindow(std::vector<std::unique_ptr<Tab>>& tabs, size_t activeTab, int selectId, int& budgetMiB,
+                       size_t& closing)
 {
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, visParams.vertexStride,
-                          (void *) (uintptr_t) visParams.vertexBufferStart);
-    glEnableVertexAttribArray(0);
+    size_t shown = activeTab;
+    ImGui::Begin("Files");
+    if (ImGui::BeginTabBar("tabs", ImGuiTabBarFlags_Reorderable | ImGuiTabBarFlags_FittingPolicyScroll)) {
+        for (size_t i = 0; i < tabs.size(); i++) {
+            Tab& tab = *tabs[i];
+            std::string label = std::filesystem::path(tab.document.path).filename().string() + "###tab" +
+                                std::to_string(tab.id);
+            ImGuiTabItemFlags flags = tab.document.isModified() ? ImGuiTabItemFlags_UnsavedDocument
+                                                                : ImGuiTabItemFlags_None;
+            if (tab.id == selectId) flags |= ImGuiTabItemFlags_SetSelected;
 
-    glUseProgram(program);
+            bool open = true;
+            bool selected = ImGui::BeginTabItem(label.c_str(), &open, flags);
+            ImGui::SetItemTooltip("%s\n%.1f MiB cached", tab.document.path.c_str(),
+                                  (double) tabFootprint(tab) / (1 << 20));
+            if (selected) {
+                shown = i;
+                ImGui::EndTabItem();
+            }
+            if (!open) {
+                if (tab.document.isModified()) tab.confirmClose = true;
+                else closing = i;
+            }
+        }
+        ImGui::EndTabBar();
+    }
+    if (tabs.empty()) ImGui::TextDisabled("Open a file with Ctrl+O");
 
-    if (visParams.backfaceCulling) glEnable(GL_CULL_FACE);
-    else
-        glDisable(GL_CULL_FACE);
+    ImGui::SetNextItemWidth(ImGui::GetFontSize() * 8);
+    if (ImGui::InputInt("Memory Budget (MiB)", &budgetMiB, 64, 1024)) budgetMiB = std::max(budgetMiB, 64);
+    ImGui::SetItemTooltip("Caches of hidden tabs are dropped, longest hidden first, to stay under this");
+    ImGui::End();
+    return shown;
+}
 
-    glPolygonMode(GL_FRONT_AND_BACK, polygonModeGLConstants[visParams.polygonMode]);
+// Set by the GLFW callbacks below, which ImGui chains on to, whenever there's input or the window needs repainting
+bool inputArrived = true;
 
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1280.0f / 720.0f, 0.1f, 1000.0f);
-    glm::mat4 view = glm::lookAt(glm::vec3(1, 1, 1) * visParams.viewDistance, glm::vec3(0, 0, 0),
-                                 glm::vec3(0, 1, 0));
-    auto model = glm::identity<glm::mat4>();
-    glUniformMatrix4fv(glGetUniformLocation(program, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-    glUniformMatrix4fv(glGetUniformLocation(program, "view"), 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(glGetUniformLocation(program, "model"), 1, GL_FALSE, glm::value_ptr(model));
+// Where the callbacks also log input, with --record
+InputRecording *activeRecording = nullptr;
 
-    unsigned mode = meshTypeGLConstants[visParams.meshType];
+void noteInput(InputEventType type, int a = 0, int b = 0, int c = 0, double x = 0.0, double y = 0.0)
+{
+    inputArrived = true;
+    if (!activeRecording) return;
 
-    if (visParams.indexedDraw) {
-        glDrawElements(mode, visParams.vertexCount,
-                       visParams.halfWidthIndexes ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
-                       ((void *) (uintptr_t) visParams.indexBufferStart));
-    } else {
-        glDrawArrays(mode, 0, visParams.vertexCount);
+    InputEvent event;
+    event.type = type;
+    event.a = a;
+    event.b = b;
+    event.c = c;
+    event.x = x;
+    event.y = y;
+    activeRecording->pending.push_back(event);
+}
+
+// Must run before ImGui installs its own callbacks, so that it calls these in turn
+void watchForInput(GLFWwindow *window)
+{
+    glfwSetKeyCallback(window, [](GLFWwindow *, int key, int, int action, int mods) {
+        noteInput(IEKey, key, action, mods);
+    });
+    glfwSetCharCallback(window, [](GLFWwindow *, unsigned int c) { noteInput(IEChar, (int) c); });
+    glfwSetMouseButtonCallback(window, [](GLFWwindow *, int button, int action, int mods) {
+        noteInput(IEMouseButton, button, action, mods);
+    });
+    glfwSetCursorPosCallback(window, [](GLFWwindow *, double x, double y) { noteInput(IECursorPos, 0, 0, 0, x, y); });
+    glfwSetScrollCallback(window, [](GLFWwindow *, double x, double y) { noteInput(IEScroll, 0, 0, 0, x, y); });
+    glfwSetCursorEnterCallback(window, [](GLFWwindow *, int entered) { noteInput(IECursorEnter, entered); });
+    glfwSetWindowFocusCallback(window, [](GLFWwindow *, int focused) { noteInput(IEFocus, focused); });
+    glfwSetWindowRefreshCallback(window, [](GLFWwindow *) { inputArrived = true; });
+}
+
+// Drawing carries on this long after the last input, for hover delays, tooltips and scrolling to settle
+constexpr double SettleSeconds = 1.0;
+
+// How often to wake while progress bars move, and otherwise to poll the file watchers and blink the text cursor
+constexpr double BusyWaitSeconds = 1.0 / 30.0;
+constexpr double IdleWaitSeconds = 0.25;
+
+// Whether any tab, the export or a file dialog has a background job whose progress is on screen or whose result is
+// awaited. The diff and template layout are only polled while their tab is shown.
+bool jobsRunning(const std::vector<std::unique_ptr<Tab>>& tabs, size_t activeTab, const ExportState& exportState,
+                 std::initializer_list<const ImGui::FileBrowser *> dialogs)
+{
+    if (activeTab < tabs.size()) {
+        const Tab& tab = *tabs[activeTab];
+        if (tab.diffView.diff.isRunning() || tab.templateView.pendingLayout.valid() || tab.laneView.pending.valid() ||
+            tab.scoreView.pending.valid() || (tab.scanView.open && tab.scanView.playing)) {
+            return true;
+        }
+    }
+    for (size_t i = 0; i < tabs.size(); i++) {
+        const Tab& tab = *tabs[i];
+
+        // A hidden tab's finished results wait for it to be shown again, so only its unfinished jobs count
+        auto awaited = [&](const auto& future) { return future.valid() && (i == activeTab || !isFutureReady(future)); };
+        if (awaited(tab.sessionState.pendingDigest) || awaited(tab.sessionState.pendingDetection) ||
+            awaited(tab.pendingReload) || awaited(tab.pointerView.pending) || awaited(tab.stringView.pending) ||
+            awaited(tab.pickView.pending)) {
+            return true;
+        }
+        for (const ScanSpare& spare: tab.scanView.spares) {
+            if (awaited(spare.staged)) return true;
+        }
     }
+    for (const ImGui::FileBrowser *dialog: dialogs) {
+        if (dialog->IsListing()) return true;
+    }
+    return exportState.pending.valid();
+}
+
+// Most recent files to prefetch at startup, and how much of them in total
+constexpr size_t PrefetchFileCount = 3;
+constexpr uint64_t PrefetchBytes = 4ull << 30;
+
+// Warms the page cache with the most recent files, and the sessions of those unchanged since, so reopening them
+// doesn't start with a cold read. Known files go first since their session means nothing else needs to be read.
+std::shared_ptr<std::atomic<bool>> startPrefetch(const json& prevFiles, const SessionCache& cache)
+{
+    std::vector<std::string> sessions, files;
+    for (auto it = prevFiles.rbegin(); it != prevFiles.rend() && files.size() < PrefetchFileCount; ++it) {
+        if (!it->is_string()) continue;
+        std::string path = it->get<std::string>();
+        uint64_t hash;
+        if (cache.lookupHash(path, hash)) sessions.push_back(cache.sessionPath(hash).string());
+        files.push_back(path);
+    }
+    if (files.empty()) return nullptr;
+
+    sessions.insert(sessions.end(), files.begin(), files.end());
+    auto cancel = std::make_shared<std::atomic<bool>>(false);
+    workerPool().submit([paths = std::move(sessions), cancel] {
+        prefetchFiles(paths, PrefetchBytes, cancel.get());
+    });
+    return cancel;
 }
 
-int main()
+int main(int argc, char **argv)
 {
+    bool prefetch = true;
+    bool continuous = false;
+    BenchOptions bench;
+    std::string recordPath, replayPath, replayOutput;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--bench" && hasValue) {
+            bench.path = argv[++i];
+        } else if (arg == "--bench-frames" && hasValue) {
+            bench.frames = std::stoi(argv[++i]);
+        } else if (arg == "--bench-stride" && hasValue) {
+            bench.stride = (uint32_t) std::stoul(argv[++i]);
+        } else if (arg == "--bench-count" && hasValue) {
+            bench.count = std::stoull(argv[++i]);
+        } else if (arg == "--bench-start" && hasValue) {
+            bench.start = std::stoull(argv[++i], nullptr, 0);
+        } else if (arg == "--bench-end" && hasValue) {
+            bench.end = std::stoull(argv[++i], nullptr, 0);
+        } else if (arg == "--bench-out" && hasValue) {
+            bench.output = argv[++i];
+        } else if (arg == "--record" && hasValue) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && hasValue) {
+            replayPath = argv[++i];
+        } else if (arg == "--replay-out" && hasValue) {
+            replayOutput = argv[++i];
+        } else if (arg == "--no-prefetch") {
+            prefetch = false;
+        } else if (arg == "--startup-trace") {
+            startupTrace().enable();
+        } else if (arg == "--continuous") {
+            continuous = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--no-prefetch] [--startup-trace] [--continuous]\n"
+                      << "       " << argv[0] << " --bench FILE [--bench-frames N] [--bench-stride N] [--bench-count N]"
+                      << " [--bench-start OFFSET] [--bench-end OFFSET] [--bench-out PATH]\n"
+                      << "       " << argv[0] << " --record PATH | --replay PATH [--replay-out PATH]" << std::endl;
+            return 1;
+        }
+    }
+
+    // Replays run hidden, flat out and without touching the page cache, so frame times only measure the UI
+    InputRecording recording;
+    bool replaying = !replayPath.empty();
+    if (replaying) {
+        if (!loadRecording(replayPath, recording)) return 1;
+        continuous = true;
+        prefetch = false;
+    }
+
     glfwInit();
+    startupTrace().mark("glfw init");
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_COCOA_RETINA_FRAMEBUFFER, GLFW_TRUE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
     glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+    if (replaying) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     GLFWwindow *window = glfwCreateWindow(1280, 720, "hexspanned", nullptr, nullptr);
 
     glfwMakeContextCurrent(window);
+    glfwSwapInterval(replaying ? 0 : 1);
+    watchForInput(window);
+    startupTrace().mark("create window");
     gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
+    startupTrace().mark("gl loader");
 
     ImGui::CreateContext();
 
     ImGuiIO& io = ImGui::GetIO();
-    ImGui::GetStyle().ScaleAllSizes(3f);
+    ImGui::GetStyle().ScaleAllSizes(3.0f);
     
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330 core");
+    startupTrace().mark("imgui context");
+
+    // The window layout decides what input lands on, so a recording carries the layout it started from
+    if (replaying) {
+        io.IniFilename = nullptr;
+        ImGui::LoadIniSettingsFromMemory(recording.iniSettings.c_str(), recording.iniSettings.size());
+    } else if (!recordPath.empty()) {
+        std::ifstream in(io.IniFilename ? io.IniFilename : "", std::ios::binary);
+        if (in.is_open()) recording.iniSettings.assign(std::istreambuf_iterator<char>(in), {});
+        activeRecording = &recording;
+    }
+    size_t replayFrame = 0;
+    std::vector<double> replayTimes;
+    double recordStart = glfwGetTime();
 
-    MemoryEditor memEdit;
     ImGui::FileBrowser fileDialog;
-    std::vector<uint8_t> data;
-    unsigned vao, vbo;
-    VisParams visParams;
+    ImGui::FileBrowser diffDialog;
+    ImGui::FileBrowser templateDialog;
+    ImGui::FileBrowser exportDialog(ImGuiFileBrowserFlags_EnterNewFilename | ImGuiFileBrowserFlags_CreateNewDir);
+    ImGui::FileBrowser saveDialog(ImGuiFileBrowserFlags_EnterNewFilename | ImGuiFileBrowserFlags_CreateNewDir);
+    SessionCache sessionCache(".hexspanned-cache");
+    std::vector<std::unique_ptr<Tab>> tabs;
+    size_t activeTab = 0;
+    size_t closing = (size_t) -1;  // tab to close at the start of the next frame
+    int nextTabId = 0;
+    int selectId = 0;              // tab to bring to the front once the tab bar catches up
+    int shownId = 0;
+    uint64_t frame = 0;
+    int budgetMiB = 2048;
+    double lastInput = 0.0;
+    bool busy = false;             // something last frame wants another one soon without any input
+    VisParams drawnParams;
+    Tab emptyTab;                  // stands in when no file is open
+    ExportState exportState;
+    GalleryView galleryView;
+    ThumbnailAtlas thumbnailAtlas;
+    unsigned vao;
     json prevFiles = json::array();
 
     {
@@ -251,45 +2543,206 @@ int main()
         }
     }
 
+    startupTrace().mark("history and session index");
+
+    // Started after the first frame, along with anything else no window needs before a file is open
+    std::shared_ptr<std::atomic<bool>> cancelPrefetch;
+    bool atlasCreated = false;
+
     glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
     glEnable(GL_DEPTH_TEST);
     glPointSize(4.0f);
 
-    unsigned vertex_shader = compileShader(
+    unsigned program = linkCachedProgram(
         "#version 330 core\n"
         "layout (location = 0) in vec3 pos;"
+        "layout (location = 1) in vec3 normal;"
+        "layout (location = 2) in vec2 texCoord;"
+        "layout (location = 3) in vec4 color;"
         "uniform mat4 projection;"
         "uniform mat4 view;"
         "uniform mat4 model;"
+        "uniform bool colorReversed;"
+        "uniform bool texCoordSwapped;"
+        "out vec3 vNormal;"
+        "out vec2 vTexCoord;"
+        "out vec4 vColor;"
         "void main() {"
         "   gl_Position = projection * view * model * vec4(pos, 1.0);"
+        "   vNormal = mat3(model) * normal;"
+        "   vTexCoord = texCoordSwapped ? texCoord.yx : texCoord;"
+        "   vColor = colorReversed ? color.abgr : color;"
         "}",
-        GL_VERTEX_SHADER);
-
-    unsigned fragment_shader = compileShader(
         "#version 330 core\n"
+        "in vec3 vNormal;"
+        "in vec2 vTexCoord;"
+        "in vec4 vColor;"
+        "uniform bool hasNormal;"
+        "uniform bool hasTexCoord;"
+        "uniform bool hasColor;"
+        "uniform bool highlight;"
         "out vec4 color;"
         "void main() {"
-        "   color = vec4(1, 0, 0, 1);"
+        "   vec3 base = hasColor ? vColor.rgb : vec3(1, 0, 0);"
+        "   if (hasTexCoord) {"
+        "       vec2 cell = floor(vTexCoord * 8.0);"
+        "       base *= 0.6 + 0.4 * mod(cell.x + cell.y, 2.0);"
+        "   }"
+        "   if (hasNormal) {"
+        "       float light = abs(dot(normalize(vNormal), normalize(vec3(0.4, 1.0, 0.6))));"
+        "       base *= 0.25 + 0.75 * light;"
+        "   }"
+        "   color = highlight ? vec4(1, 1, 0, 1) : vec4(base, 1);"
         "}",
-        GL_FRAGMENT_SHADER);
+        ".hexspanned-cache/programs");
+
+    emptyTab.memEdit.ReadFn = readDocumentByte;
+    emptyTab.memEdit.WriteFn = writeDocumentByte;
+    saveDialog.SetTitle("Save As");
+    diffDialog.SetTitle("Compare With");
+    templateDialog.SetTitle("Load Template");
+    exportDialog.SetTitle("Export Mesh");
+    templateDialog.SetTypeFilters({ ".json" });
+
+    // A file that's already open just comes to the front
+    auto openFile = [&](const std::string& name) {
+        // Whatever is opened now matters more than what was open last time
+        if (cancelPrefetch) *cancelPrefetch = true;
+        std::string path = std::filesystem::absolute(name).string();
+        if (activeRecording) {
+            noteInput(IEOpenFile);
+            activeRecording->pending.back().path = path;
+        }
+        for (const auto& open: tabs) {
+            if (open->document.path == path) {
+                selectId = open->id;
+                return;
+            }
+        }
+
+        auto tab = std::make_unique<Tab>();
+        if (!loadFile(path, tab->document, tab->drawWindows)) return;
+        glGenBuffers(1, &tab->drawWindows.vertices.buffer);
+        glGenBuffers(1, &tab->drawWindows.indices.buffer);
+        tab->id = ++nextTabId;
+        tab->memEdit.ReadFn = readDocumentByte;
+        tab->memEdit.WriteFn = writeDocumentByte;
+        setupDiffEditor(tab->diffView.leftEdit);
+        setupDiffEditor(tab->diffView.rightEdit);
+
+        // A new tab starts from the template the current one uses, as files opened together tend to share formats
+        if (activeTab < tabs.size()) {
+            const char *source = tabs[activeTab]->templateView.source;
+            std::copy(source, source + sizeof(tab->templateView.source), tab->templateView.source);
+        }
+        compileTemplateSource(tab->templateView);
+        tab->fileWatcher.watch(tab->document.path);
+        startSession(sessionCache, tab->sessionState, tab->document, tab->visParams, tab->memEdit, false);
+        selectId = tab->id;
+        tabs.push_back(std::move(tab));
+    };
+
+    // Saving changes the content hash, so carry the current session over to the new one
+    auto saveFile = [&](Tab& tab, const std::string& name) {
+        if (replaying) {
+            std::cerr << "Not saving during a replay" << std::endl;
+            return;
+        }
+        storeSession(sessionCache, tab.sessionState, tab.visParams, tab.memEdit);
+        bool saved = name.empty() ? tab.document.save() : tab.document.saveAs(name);
+        if (saved) {
+            // Re-arming drops the events our own write just produced
+            tab.fileWatcher.watch(tab.document.path);
+            tab.changedOnDisk = false;
+            startSession(sessionCache, tab.sessionState, tab.document, tab.visParams, tab.memEdit, true);
+        }
+    };
+
+    // A benchmark run skips the UI altogether
+    int exitCode = bench.path.empty() ? 0 : runBench(bench, window, vao, program);
 
-    unsigned program = glCreateProgram();
-    glAttachShader(program, vertex_shader);
-    glAttachShader(program, fragment_shader);
-    glLinkProgram(program);
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+    while (bench.path.empty() && !glfwWindowShouldClose(window)) {
+        // Frames are only drawn on input, for a moment after it, and while jobs run; otherwise the loop sleeps.
+        // A replay instead feeds each recorded frame its input as fast as frames can be drawn.
+        auto frameStart = std::chrono::steady_clock::now();
+        if (replaying) {
+            if (replayFrame == recording.frames.size()) break;
+            glfwPollEvents();
+            for (const InputEvent& event: recording.frames[replayFrame].events) {
+                if (event.type == IEOpenFile) openFile(event.path);
+                else replayEvent(io, event);
+            }
+        } else if (continuous || glfwGetTime() - lastInput < SettleSeconds) {
+            glfwPollEvents();
+        } else {
+            glfwWaitEventsTimeout(busy ? BusyWaitSeconds : IdleWaitSeconds);
+        }
+        if (inputArrived) {
+            inputArrived = false;
+            lastInput = glfwGetTime();
+        }
 
-    while (!glfwWindowShouldClose(window)) {
         ImGui_ImplGlfw_NewFrame();
+        if (replaying) {
+            const RecordedFrame& recorded = recording.frames[replayFrame++];
+            if (recorded.deltaTime > 0.0f) io.DeltaTime = recorded.deltaTime;
+            io.DisplaySize = ImVec2(recorded.width, recorded.height);
+        } else if (activeRecording) {
+            RecordedFrame recorded;
+            recorded.time = glfwGetTime() - recordStart;
+            recorded.deltaTime = io.DeltaTime;
+            recorded.width = io.DisplaySize.x;
+            recorded.height = io.DisplaySize.y;
+            recorded.events.swap(recording.pending);
+            recording.frames.push_back(std::move(recorded));
+        }
         ImGui_ImplOpenGL3_NewFrame();
         ImGui::NewFrame();
+        frame++;
+
+        if (closing < tabs.size()) {
+            closeTab(*tabs[closing], sessionCache);
+            tabs.erase(tabs.begin() + (ptrdiff_t) closing);
+            if (activeTab > closing || activeTab == tabs.size()) activeTab = activeTab ? activeTab - 1 : 0;
+            if (!tabs.empty()) selectId = tabs[activeTab]->id;
+        }
+        closing = (size_t) -1;
+
+        size_t shown = drawFilesWindow(tabs, activeTab, selectId, budgetMiB, closing);
+        if (selectId) {
+            for (size_t i = 0; i < tabs.size(); i++) {
+                if (tabs[i]->id == selectId) activeTab = i;
+            }
+            if (shown == activeTab) selectId = 0;
+        } else {
+            activeTab = shown;
+        }
 
-        glfwPollEvents();
+        // The rest of the frame works on the active tab, as if it were the only file open
+        Tab& tab = activeTab < tabs.size() ? *tabs[activeTab] : emptyTab;
+        Document& document = tab.document;
+        MemoryEditor& memEdit = tab.memEdit;
+        VisParams& visParams = tab.visParams;
+        tab.lastActive = frame;
+        if (tab.id != shownId) {
+            shownId = tab.id;
+            thumbnailAtlas.invalidate();
+            for (const auto& hidden: tabs) {
+                if (hidden.get() != &tab) hidden->scanView.playing = false;
+            }
+        }
 
         if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_O)) fileDialog.Open();
+        if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_S)) saveFile(tab, "");
+        if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_W) && document.isOpen()) {
+            if (document.isModified()) tab.confirmClose = true;
+            else closing = activeTab;
+        }
+        if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Z)) document.table.undo();
+        if (ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiKey_Y) ||
+            ImGui::IsKeyChordPressed(ImGuiMod_Ctrl | ImGuiMod_Shift | ImGuiKey_Z)) {
+            document.table.redo();
+        }
 
         ImGui::BeginMainMenuBar();
         if (ImGui::BeginMenu("File")) {
@@ -301,25 +2754,146 @@ int main()
                     auto path = std::filesystem::path(recentFile.get<std::string>());
                     auto str_name = path.filename().string() + " (" + path.string() + ")";
                     if (ImGui::MenuItem(str_name.c_str())) {
-                        loadFile(path.string(), data, vbo, visParams);
+                        openFile(path.string());
                     }
                 }
                 ImGui::EndMenu();
             }
+            if (ImGui::MenuItem("Compare With...", nullptr, false, document.isOpen())) {
+                diffDialog.Open();
+            }
+            if (ImGui::BeginMenu("Export Mesh", document.isOpen() && !exportState.pending.valid())) {
+                if (ImGui::MenuItem("OBJ...")) {
+                    exportState.format = MFObj;
+                    exportDialog.Open();
+                }
+                if (ImGui::MenuItem("Binary PLY...")) {
+                    exportState.format = MFPly;
+                    exportDialog.Open();
+                }
+                if (ImGui::MenuItem("glTF...")) {
+                    exportState.format = MFGltf;
+                    exportDialog.Open();
+                }
+                ImGui::EndMenu();
+            }
+            if (ImGui::MenuItem("Save", "Ctrl+S", false, document.isModified())) {
+                saveFile(tab, "");
+            }
+            if (ImGui::MenuItem("Save As...", nullptr, false, document.isOpen())) {
+                saveDialog.Open();
+            }
+            if (ImGui::MenuItem("Close", "Ctrl+W", false, document.isOpen())) {
+                if (document.isModified()) tab.confirmClose = true;
+                else closing = activeTab;
+            }
+            ImGui::EndMenu();
+        }
+        if (ImGui::BeginMenu("Edit")) {
+            if (ImGui::MenuItem("Undo", "Ctrl+Z", false, document.table.canUndo())) {
+                document.table.undo();
+            }
+            if (ImGui::MenuItem("Redo", "Ctrl+Y", false, document.table.canRedo())) {
+                document.table.redo();
+            }
+            ImGui::EndMenu();
+        }
+        if (ImGui::BeginMenu("View")) {
+            ImGui::MenuItem("Candidate Gallery", nullptr, &galleryView.open, document.isOpen());
+            ImGui::MenuItem("Pointers", nullptr, &tab.pointerView.open, document.isOpen());
+            ImGui::MenuItem("Strings", nullptr, &tab.stringView.open, document.isOpen());
+            ImGui::MenuItem("Chunks", nullptr, &tab.chunkView.open, document.isOpen());
+            ImGui::MenuItem("Scan", nullptr, &tab.scanView.open, document.isOpen());
             ImGui::EndMenu();
         }
         ImGui::EndMainMenuBar();
 
-        if (drawVisMenu(visParams, (int) memEdit.DataEditingAddr)) {
-            copyToGPU(vbo, data, visParams.bigEndian);
+        bool needsReupload = false;
+        for (size_t i = 0; i < tabs.size(); i++) {
+            bool changed = pollTab(*tabs[i], sessionCache, i == activeTab);
+            if (i == activeTab) needsReupload = changed;
+
+            bool closeRequested = false;
+            if (tabs[i]->confirmClose) drawUnsavedCloseWindow(*tabs[i], closeRequested);
+            if (closeRequested) closing = i;
+        }
+        if (document.isOpen()) {
+            drawSessionWindow(tab.sessionState, document, visParams, memEdit, needsReupload);
+        }
+        if (document.isOpen()) {
+            drawScoreWindow(tab.scoreView, document, visParams);
+            drawAttributeWindow(tab.laneView, document, visParams);
+            if (tab.pointerView.open) drawPointerWindow(tab.pointerView, document, memEdit);
+            if (tab.stringView.open) drawStringWindow(tab.stringView, document, memEdit);
+            if (tab.chunkView.open) drawChunkWindow(tab.chunkView, document, memEdit, visParams);
+        }
+        if (galleryView.open && !atlasCreated) {
+            // Only the gallery uses the atlas, so its program and framebuffer wait until it's first opened
+            atlasCreated = true;
+            if (!thumbnailAtlas.create()) {
+                std::cerr << "Couldn't create the thumbnail atlas framebuffer" << std::endl;
+            }
+        }
+        if (galleryView.open && document.isOpen()) {
+            drawGalleryWindow(galleryView, thumbnailAtlas, tab.sessionState.session.candidates, visParams,
+                              needsReupload);
+        }
+
+        if (tab.scanView.open && document.isOpen()) {
+            drawScanWindow(tab.scanView, visParams, tab.drawWindows, document.size());
+        }
+        // Playback only advances while its window is drawn, so closing the window pauses it
+        if (!tab.scanView.open) tab.scanView.playing = false;
+        if (drawVisMenu(visParams, memEdit.DataEditingAddr) || needsReupload) {
+            tab.drawWindows.vertices.loaded = tab.drawWindows.indices.loaded = false;
+        }
+
+        memEdit.DrawWindow("Hex View", &document, document.size());
+
+        if (tab.diffView.open) {
+            drawDiffWindow(tab.diffView, document.isModified());
         }
 
-        memEdit.DrawWindow("Hex View", data.data(), data.size());
+        if (document.isOpen()) {
+            bool loadTemplate = false;
+            drawTemplateWindow(tab.templateView, document, memEdit, loadTemplate);
+            if (loadTemplate) templateDialog.Open();
+        }
 
         fileDialog.Display();
+        saveDialog.Display();
+        diffDialog.Display();
+        templateDialog.Display();
+        exportDialog.Display();
+
+        if (exportDialog.HasSelected()) {
+            startExport(exportState, document, visParams, exportDialog.GetSelected().string());
+            exportDialog.Close();
+        }
+        drawExportWindow(exportState);
+
+        if (templateDialog.HasSelected()) {
+            std::ifstream in(templateDialog.GetSelected());
+            if (in.is_open()) {
+                in.read(tab.templateView.source, sizeof(tab.templateView.source) - 1);
+                tab.templateView.source[in.gcount()] = '\0';
+                compileTemplateSource(tab.templateView);
+            }
+            templateDialog.Close();
+        }
+
+        if (diffDialog.HasSelected()) {
+            startDiff(tab.diffView, document, diffDialog.GetSelected().string());
+            diffDialog.Close();
+        }
+
+        if (saveDialog.HasSelected()) {
+            saveFile(tab, saveDialog.GetSelected().string());
+            saveDialog.Close();
+        }
 
         if (fileDialog.HasSelected()) {
-            loadFile(fileDialog.GetSelected().string(), data, vbo, visParams);
+            openFile(fileDialog.GetSelected().string());
 
             auto absPath = std::filesystem::absolute(fileDialog.GetSelected()).string();
             if (std::find(prevFiles.begin(), prevFiles.end(), absPath) == prevFiles.end()) {
@@ -334,32 +2908,70 @@ int main()
             fileDialog.Close();
         }
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        if (galleryView.open && document.isOpen()) {
+            thumbnailAtlas.update(galleryView.shown, document.table, document.table.revision());
+        }
 
-        bool canRenderRegular =
-            visParams.vertexStride * visParams.vertexCount + visParams.vertexBufferStart < data.size();
-        bool canRenderIndexed = visParams.vertexCount * 4 + visParams.indexBufferStart < data.size();
-        bool canRender = visParams.indexedDraw ? canRenderIndexed : canRenderRegular;
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        if (canRender) {
-            render(visParams, vao, vbo, program);
+        // Edits, undo and redo all bump the revision, which re-uploads the windows here once per frame at most
+        if (tab.scanView.open) adoptSpare(tab.scanView, tab.drawWindows, document, visParams);
+        DrawCheck check = prepareDraw(tab.drawWindows, document, visParams);
+        if (check == DCDrawable) {
+            if (ImGui::IsMouseClicked(0) && !io.WantCaptureMouse) {
+                requestPick(tab.pickView, document, visParams, tab.drawWindows);
+            }
+            pollPick(tab.pickView, visParams, memEdit);
+            render(visParams, vao, tab.drawWindows, program);
+            uint64_t highlighted = highlightedVertex(tab.pickView, visParams, tab.drawWindows, memEdit);
+            if (highlighted != UINT64_MAX) renderHighlight(program, highlighted);
+            if (tab.scanView.open) fillSpares(tab.scanView, tab.drawWindows, document, visParams);
         } else {
             ImGui::Begin("Oops!", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
-            ImGui::Text("The current render parameters would read past the end of the file!");
+            if (check == DCTooLarge) {
+                ImGui::Text("The current render parameters read more than the %llu MiB a draw may upload!",
+                            (unsigned long long) (MaxWindowBytes >> 20));
+            } else {
+                ImGui::Text("The current render parameters would read past the end of the file!");
+            }
             ImGui::End();
         }
+        enforceMemoryBudget(tabs, activeTab, (uint64_t) budgetMiB << 20);
+
+        // Layout changes that came from a finished job rather than input still need the next frames drawn
+        if (visParams != drawnParams) {
+            drawnParams = visParams;
+            lastInput = glfwGetTime();
+        }
+        busy = jobsRunning(tabs, activeTab, exportState,
+                           { &fileDialog, &saveDialog, &diffDialog, &templateDialog, &exportDialog });
 
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
         glfwSwapBuffers(window);
+        if (replaying) {
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - frameStart;
+            replayTimes.push_back(elapsed.count());
+        }
+
+        if (frame == 1) {
+            startupTrace().mark("first frame");
+            startupTrace().report(std::cerr);
+            if (prefetch) cancelPrefetch = startPrefetch(prevFiles, sessionCache);
+        }
     }
 
+    for (const auto& open: tabs) closeTab(*open, sessionCache);
+    if (cancelPrefetch) *cancelPrefetch = true;
+    if (activeRecording && !saveRecording(recordPath, recording)) exitCode = 1;
+    if (replaying) exitCode = writeReplayReport(recording, replayTimes, replayOutput) ? exitCode : 1;
+
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
     glfwDestroyWindow(window);
     glfwTerminate();
-    return 0;
+    return exitCode;
 }
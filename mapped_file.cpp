@@ -0,0 +1,163 @@
+#include "mapped_file.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+    moveFrom(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other) {
+        close();
+        moveFrom(other);
+    }
+    return *this;
+}
+
+void MappedFile::moveFrom(MappedFile& other) noexcept
+{
+    isOpen_ = other.isOpen_;
+    data_ = other.data_;
+    size_ = other.size_;
+#ifdef _WIN32
+    fileHandle_ = other.fileHandle_;
+    mappingHandle_ = other.mappingHandle_;
+    other.fileHandle_ = nullptr;
+    other.mappingHandle_ = nullptr;
+#else
+    fd_ = other.fd_;
+    other.fd_ = -1;
+#endif
+    other.isOpen_ = false;
+    other.data_ = nullptr;
+    other.size_ = 0;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    // Share write access so the file can still be patched in place (or rewritten by other tools) while mapped
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size)) {
+        std::cerr << "Error reading file size: " << path << std::endl;
+        CloseHandle(file);
+        return false;
+    }
+
+    fileHandle_ = file;
+    size_ = (size_t) size.QuadPart;
+    isOpen_ = true;
+
+    // Empty files can't be mapped, but are still valid documents
+    if (size_ == 0) return true;
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        std::cerr << "Error mapping file: " << path << std::endl;
+        close();
+        return false;
+    }
+    mappingHandle_ = mapping;
+
+    data_ = (const uint8_t *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data_) {
+        std::cerr << "Error mapping file: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_) UnmapViewOfFile(data_);
+    if (mappingHandle_) CloseHandle((HANDLE) mappingHandle_);
+    if (fileHandle_) CloseHandle((HANDLE) fileHandle_);
+
+    data_ = nullptr;
+    mappingHandle_ = nullptr;
+    fileHandle_ = nullptr;
+    size_ = 0;
+    isOpen_ = false;
+}
+
+#else
+
+bool MappedFile::open(const std::string& path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        std::cerr << "Error reading file size: " << path << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    size_ = (size_t) st.st_size;
+    isOpen_ = true;
+
+    // Empty files can't be mapped, but are still valid documents
+    if (size_ == 0) return true;
+
+    // MAP_SHARED so in-place saves through a separate descriptor are visible through the mapping
+    void *mapped = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Error mapping file: " << path << std::endl;
+        close();
+        return false;
+    }
+
+    data_ = (const uint8_t *) mapped;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data_) munmap((void *) data_, size_);
+    if (fd_ >= 0) ::close(fd_);
+
+    data_ = nullptr;
+    fd_ = -1;
+    size_ = 0;
+    isOpen_ = false;
+}
+
+#endif
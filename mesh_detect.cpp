@@ -0,0 +1,463 @@
+#include "mesh_detect.h"
+#include "mesh_score.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <mutex>
+
+namespace
+{
+    // Beyond this, consecutive vertices jump around too much relative to the mesh's size to be a surface
+    constexpr float MaxStepRatio = 0.7f;
+
+    // Vertices whose step to the next is this many times the median are trimmed off the ends of a run
+    constexpr float OutlierStep = 8.0f;
+    constexpr uint64_t TrimWindow = 16;
+    constexpr uint64_t MedianSamples = 1024;
+
+    constexpr uint32_t MinIndices = 48;
+
+    // Index buffers whose triangles score below this are more likely a neighbour's data, so the run stays unindexed
+    constexpr float MinPairingScore = 0.35f;
+    constexpr size_t MaxCandidates = 256;
+
+    struct Run
+    {
+        uint64_t firstWord;
+        uint64_t count;
+        uint32_t strideWords;
+        bool bigEndian;
+        bool zeroInFirst;  // a word of the first vertex is zero, as when it reaches back into padding
+        float confidence;
+    };
+
+    inline float loadFloat(const uint8_t *data, uint64_t word, bool bigEndian)
+    {
+        uint32_t bits;
+        memcpy(&bits, data + word * 4, 4);
+        if (bigEndian) {
+            bits = (bits >> 24) | ((bits >> 8) & 0x0000FF00u) | ((bits << 8) & 0x00FF0000u) | (bits << 24);
+        }
+        float f;
+        memcpy(&f, &bits, 4);
+        return f;
+    }
+
+    // Bit flags, so a vertex is plausible if all of its words share bit 0
+    enum WordClass : uint8_t
+    {
+        WCNoise = 0,
+        WCPlausible = 1,
+        WCTiny = 3,  // plausible too, but only as an occasional coordinate that lands next to zero
+        WCZero = 5
+    };
+
+    // Model-space coordinates are almost never denormal-small or astronomically large; random bytes usually are.
+    // Classes go by the exponent alone: plausible from about 1e-5 to 1e5, tiny from about 1e-10. Tiny values are
+    // allowed but can't repeat in consecutive vertices, which is what an index buffer read as floats looks like.
+    struct ExponentClasses
+    {
+        uint8_t table[256];
+
+        ExponentClasses()
+        {
+            for (int e = 0; e < 256; e++) {
+                table[e] = e >= 110 && e <= 143 ? WCPlausible : e >= 94 && e < 110 ? WCTiny : WCNoise;
+            }
+        }
+    };
+
+    inline uint8_t classifyWord(uint32_t bits)
+    {
+        static const ExponentClasses classes;
+        return (bits << 1) == 0 ? (uint8_t) WCZero : classes.table[(bits >> 23) & 0xFF];
+    }
+
+    // Class of the xyz starting at each word: WCNoise if any word is, otherwise plausible with the tiny bit set if any
+    // word is tiny and the zero bit set if all words are zero
+    void classifyVertices(const uint8_t *data, size_t words, bool bigEndian, std::vector<uint8_t>& wordClass,
+                          std::vector<uint8_t>& vertexClass)
+    {
+        wordClass.resize(words);
+        vertexClass.resize(words);
+        workerPool().parallelFor(words, 1 << 20, [&](size_t begin, size_t end) {
+            for (size_t w = begin; w < end; w++) {
+                uint32_t bits;
+                memcpy(&bits, data + w * 4, 4);
+                if (bigEndian) {
+                    bits = (bits >> 24) | ((bits >> 8) & 0x0000FF00u) | ((bits << 8) & 0x00FF0000u) | (bits << 24);
+                }
+                wordClass[w] = classifyWord(bits);
+            }
+        });
+        workerPool().parallelFor(words, 1 << 20, [&](size_t begin, size_t end) {
+            for (size_t w = begin; w < end; w++) {
+                if (w + 3 > words) {
+                    vertexClass[w] = WCNoise;
+                    continue;
+                }
+                uint8_t all = wordClass[w] & wordClass[w + 1] & wordClass[w + 2];
+                uint8_t any = wordClass[w] | wordClass[w + 1] | wordClass[w + 2];
+                vertexClass[w] = all ? (uint8_t) (WCPlausible | (any & 2) | (all & 4)) : (uint8_t) WCNoise;
+            }
+        });
+    }
+
+    float stepLength(const uint8_t *data, uint64_t a, uint64_t b, bool bigEndian)
+    {
+        float dx = loadFloat(data, b, bigEndian) - loadFloat(data, a, bigEndian);
+        float dy = loadFloat(data, b + 1, bigEndian) - loadFloat(data, a + 1, bigEndian);
+        float dz = loadFloat(data, b + 2, bigEndian) - loadFloat(data, a + 2, bigEndian);
+        return std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+
+    // Trims outlying vertices off both ends, then scores how smoothly the rest moves: the mean step between consecutive
+    // vertices against the mean distance to the vertex half the run away. Random floats score near 1 however they're
+    // distributed; surfaces are written out row by row and score far lower. A run read at the wrong phase picks up a
+    // stray word at its first vertex, so trimming is also what lets the correctly aligned run be the longest.
+    bool evaluateRun(const uint8_t *data, Run& run, uint32_t minVertices, std::vector<float>& steps,
+                     std::vector<float>& scratch)
+    {
+        uint64_t stride = run.strideWords;
+        steps.resize(run.count - 1);
+        for (uint64_t k = 0; k + 1 < run.count; k++) {
+            uint64_t w = run.firstWord + k * stride;
+            steps[k] = stepLength(data, w, w + stride, run.bigEndian);
+        }
+
+        // The median step, estimated from an even sample; long runs would otherwise spend most of their time here
+        uint64_t sampleStep = std::max<uint64_t>(1, steps.size() / MedianSamples);
+        scratch.clear();
+        for (uint64_t k = 0; k < steps.size(); k += sampleStep) scratch.push_back(steps[k]);
+        std::nth_element(scratch.begin(), scratch.begin() + (ptrdiff_t) scratch.size() / 2, scratch.end());
+        float limit = std::max(scratch[scratch.size() / 2] * OutlierStep, 1e-6f);
+
+        // Along a surface, a vertex two steps on is nearly two steps away; in plausible-looking noise it's no further
+        // than the next one. Windows of mostly outlying steps are noise too.
+        auto rough = [&](uint64_t from) {
+            double near = 0.0, skip = 0.0;
+            uint64_t outliers = 0;
+            for (uint64_t k = from; k < from + TrimWindow; k++) {
+                if (steps[k] > limit || steps[k + 1] > limit) {
+                    outliers++;
+                    continue;
+                }
+                uint64_t w = run.firstWord + k * stride;
+                near += steps[k];
+                skip += stepLength(data, w, w + 2 * stride, run.bigEndian);
+            }
+            return outliers * 2 > TrimWindow || skip < near * 1.4;
+        };
+
+        // Stretches of noise that run into the mesh go first, then any single stray vertex
+        uint64_t first = 0, last = run.count - 1;
+        while (first + TrimWindow + 1 <= last && rough(first)) first += TrimWindow / 2;
+        while (last >= first + TrimWindow + 1 && rough(last - TrimWindow - 1)) last -= TrimWindow / 2;
+        while (first < last && steps[first] > limit) first++;
+        while (last > first && steps[last - 1] > limit) last--;
+        uint64_t count = last - first + 1;
+        if (count < minVertices) return false;
+
+        float min[3] = { INFINITY, INFINITY, INFINITY };
+        float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+        uint64_t zeros = 0;
+        double stepSum = 0.0, farSum = 0.0;
+        for (uint64_t k = 0; k < count; k++) {
+            uint64_t w = run.firstWord + (first + k) * stride;
+            bool zero = true;
+            for (int axis = 0; axis < 3; axis++) {
+                float f = loadFloat(data, w + axis, run.bigEndian);
+                min[axis] = std::min(min[axis], f);
+                max[axis] = std::max(max[axis], f);
+                zero &= f == 0.0f;
+            }
+            zeros += zero;
+            if (k + 1 < count) stepSum += steps[first + k];
+            farSum += stepLength(data, w, run.firstWord + (first + (k + count / 2) % count) * stride, run.bigEndian);
+        }
+        if (zeros * 2 > count) return false;
+
+        // Flat meshes are fine, but a line or a point repeated over and over isn't a mesh
+        float extent[3] = { max[0] - min[0], max[1] - min[1], max[2] - min[2] };
+        float largest = std::max({ extent[0], extent[1], extent[2] });
+        int spannedAxes = (extent[0] > largest * 1e-3f) + (extent[1] > largest * 1e-3f) + (extent[2] > largest * 1e-3f);
+        if (!(largest > 0.0f) || !std::isfinite(largest) || spannedAxes < 2 || !(farSum > 0.0)) return false;
+
+        float ratio = (float) ((stepSum / (double) (count - 1)) / (farSum / (double) count));
+        if (!(ratio < MaxStepRatio)) return false;
+
+        run.firstWord += first * stride;
+        run.count = count;
+        run.zeroInFirst = loadFloat(data, run.firstWord, false) == 0.0f ||
+                          loadFloat(data, run.firstWord + 1, false) == 0.0f ||
+                          loadFloat(data, run.firstWord + 2, false) == 0.0f;
+        run.confidence = 1.0f - ratio / MaxStepRatio;
+        return true;
+    }
+
+    // Collects runs of consecutive plausible vertices at every phase of one stride. Words are visited in order, each
+    // extending the run of its own phase, so memory is read sequentially; stretches of noise are skipped eight at a
+    // time while no run is open.
+    void findRuns(const uint8_t *data, const std::vector<uint8_t>& vertexClass, uint32_t strideWords, bool bigEndian,
+                  uint32_t minVertices, std::vector<Run>& runs, const std::atomic<bool> *cancel)
+    {
+        struct Open
+        {
+            uint64_t start = 0;
+            uint64_t length = 0;
+        };
+
+        uint64_t words = vertexClass.size();
+        std::vector<Open> phases(strideWords);
+        std::vector<float> steps, scratch;
+        size_t openCount = 0;
+
+        auto close = [&](Open& open) {
+            if (open.length >= minVertices) {
+                Run run { open.start, open.length, strideWords, bigEndian, false, 0.0f };
+                if (evaluateRun(data, run, minVertices, steps, scratch)) runs.push_back(run);
+            }
+            open.length = 0;
+            openCount--;
+        };
+
+        for (uint64_t w = 0; w < words; w++) {
+            if ((w & ((1 << 20) - 1)) == 0 && cancel && cancel->load(std::memory_order_relaxed)) return;
+
+            if (openCount == 0 && (w & 7) == 0 && w + 8 <= words) {
+                uint64_t block;
+                memcpy(&block, vertexClass.data() + w, 8);
+                if (block == 0) {
+                    w += 7;
+                    continue;
+                }
+            }
+
+            // Tiny values can't repeat in consecutive vertices, and zero fill neither starts a run nor continues one
+            // for more than a vertex
+            uint8_t vertex = vertexClass[w];
+            uint8_t previous = w >= strideWords ? vertexClass[w - strideWords] : (uint8_t) WCNoise;
+            Open& open = phases[w % strideWords];
+            bool accepted = vertex != WCNoise && !(vertex & previous & 2) &&
+                            !((vertex & 4) && ((previous & 4) || open.length == 0));
+
+            if (accepted) {
+                if (open.length++ == 0) {
+                    open.start = w;
+                    openCount++;
+                }
+            } else if (open.length > 0) {
+                close(open);
+            }
+        }
+        for (Open& open: phases) {
+            if (open.length > 0) close(open);
+        }
+    }
+
+    uint64_t overlap(uint64_t aStart, uint64_t aEnd, uint64_t bStart, uint64_t bEnd)
+    {
+        return std::min(aEnd, bEnd) > std::max(aStart, bStart) ? std::min(aEnd, bEnd) - std::max(aStart, bStart) : 0;
+    }
+
+    bool overlapsMostly(const Run& a, const Run& b)
+    {
+        uint64_t aStart = a.firstWord, aEnd = a.firstWord + a.count * a.strideWords;
+        uint64_t bStart = b.firstWord, bEnd = b.firstWord + b.count * b.strideWords;
+        return overlap(aStart, aEnd, bStart, bEnd) * 2 > std::min(aEnd - aStart, bEnd - bStart);
+    }
+
+    // Whether `run` should stand for a cluster of overlapping runs with the same layout over `kept`
+    bool preferredWithinLayout(const Run& run, const Run& kept)
+    {
+        if (run.count > kept.count + 2) return true;
+        if (run.count + 2 < kept.count) return false;
+        if (run.zeroInFirst != kept.zeroInFirst) return !run.zeroInFirst;
+        return run.firstWord < kept.firstWord;
+    }
+
+    // The other attributes of an interleaved vertex and misaligned phases of the positions form runs too. Within one
+    // layout the longest run is kept; between runs within a couple of vertices of each other, one whose first vertex
+    // is free of zero words, then the earliest, as positions usually lead. Across layouts, the smoothest is kept.
+    void resolveOverlaps(std::vector<Run>& runs)
+    {
+        std::sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) {
+            if (a.bigEndian != b.bigEndian) return a.bigEndian < b.bigEndian;
+            if (a.strideWords != b.strideWords) return a.strideWords < b.strideWords;
+            return a.firstWord < b.firstWord;
+        });
+
+        std::vector<Run> perLayout;
+        uint64_t clusterEnd = 0;
+        for (size_t i = 0; i < runs.size(); i++) {
+            const Run& run = runs[i];
+            bool sameLayout = i > 0 && runs[i - 1].bigEndian == run.bigEndian &&
+                              runs[i - 1].strideWords == run.strideWords;
+            uint64_t end = run.firstWord + run.count * run.strideWords;
+
+            if (sameLayout && run.firstWord < clusterEnd) {
+                if (preferredWithinLayout(run, perLayout.back())) perLayout.back() = run;
+                clusterEnd = std::max(clusterEnd, end);
+            } else {
+                perLayout.push_back(run);
+                clusterEnd = end;
+            }
+        }
+
+        std::sort(perLayout.begin(), perLayout.end(), [](const Run& a, const Run& b) {
+            if (std::fabs(a.confidence - b.confidence) > 0.02f) return a.confidence > b.confidence;
+            return a.strideWords < b.strideWords;
+        });
+
+        runs.clear();
+        for (const Run& run: perLayout) {
+            bool taken = std::any_of(runs.begin(), runs.end(), [&](const Run& kept) {
+                return overlapsMostly(kept, run);
+            });
+            if (!taken) runs.push_back(run);
+            if (runs.size() == MaxCandidates) break;
+        }
+    }
+
+    // Run of `width`-byte values below `vertexCount` in [begin, end) that also reaches at least half of the vertices,
+    // which rules out zero fill and small counters. Returns the first such run, or the last one when `fromEnd`.
+    bool findIndexRun(const uint8_t *data, uint64_t begin, uint64_t end, unsigned width, bool bigEndian,
+                      uint64_t vertexCount, bool fromEnd, uint64_t& foundStart, uint64_t& foundLength)
+    {
+        foundLength = 0;
+        begin = (begin + width - 1) / width * width;
+
+        uint64_t runStart = begin, runLength = 0, runMax = 0;
+        bool done = false;
+        auto close = [&] {
+            if (runLength >= MinIndices && runMax * 2 >= vertexCount) {
+                foundStart = runStart;
+                foundLength = runLength;
+                done = !fromEnd;
+            }
+            runLength = 0;
+            runMax = 0;
+        };
+
+        for (uint64_t offset = begin; offset + width <= end && !done; offset += width) {
+            const uint8_t *p = data + offset;
+            uint64_t value = width == 2 ? (bigEndian ? (uint64_t) p[0] << 8 | p[1] : (uint64_t) p[1] << 8 | p[0])
+                                        : (bigEndian ? (uint64_t) p[0] << 24 | (uint64_t) p[1] << 16 |
+                                                       (uint64_t) p[2] << 8 | p[3]
+                                                     : (uint64_t) p[3] << 24 | (uint64_t) p[2] << 16 |
+                                                       (uint64_t) p[1] << 8 | p[0]);
+            if (value < vertexCount) {
+                if (runLength++ == 0) runStart = offset;
+                runMax = std::max(runMax, value);
+            } else {
+                close();
+            }
+        }
+        if (!done) close();
+        return foundLength > 0;
+    }
+
+    // Index buffers usually sit right next to their vertices, so the closest run on either side within a window wins.
+    // 32-bit indices also read as valid 16-bit ones, so on equal distance they're preferred.
+    void pairIndices(const uint8_t *data, size_t size, const Run& run, MeshCandidate& candidate)
+    {
+        uint64_t start = run.firstWord * 4;
+        uint64_t end = start + run.count * run.strideWords * 4;
+        uint64_t window = std::max<uint64_t>(64 * 1024, end - start);
+        uint64_t before = start > window ? start - window : 0;
+        uint64_t after = std::min<uint64_t>(size, end + window);
+
+        uint64_t bestDistance = UINT64_MAX, bestStart = 0, bestLength = 0;
+        unsigned bestWidth = 0;
+        for (unsigned width: { 4u, 2u }) {
+            if (width == 2 && run.count > 65536) continue;
+
+            uint64_t runStart, runLength;
+            if (findIndexRun(data, end, after, width, run.bigEndian, run.count, false, runStart, runLength) &&
+                runStart - end < bestDistance) {
+                bestDistance = runStart - end;
+                bestStart = runStart;
+                bestLength = runLength;
+                bestWidth = width;
+            }
+            if (findIndexRun(data, before, start, width, run.bigEndian, run.count, true, runStart, runLength) &&
+                start - (runStart + runLength * width) < bestDistance) {
+                bestDistance = start - (runStart + runLength * width);
+                bestStart = runStart;
+                bestLength = runLength;
+                bestWidth = width;
+            }
+        }
+
+        if (bestLength > 0) {
+            candidate.params.indexedDraw = true;
+            candidate.params.halfWidthIndexes = bestWidth == 2;
+            candidate.params.indexBufferStart = bestStart;
+            candidate.params.vertexCount = bestLength / 3 * 3;
+            candidate.params.meshType = MTTriangle;
+        }
+    }
+}
+
+void detectMeshes(const uint8_t *data, size_t size, std::vector<MeshCandidate>& candidates,
+                  const DetectOptions& options, const std::atomic<bool> *cancel)
+{
+    candidates.clear();
+    size_t words = size / 4;
+    if (words < 3) return;
+
+    std::vector<uint32_t> strides;
+    for (uint32_t stride = std::max(options.minStride, 12u) / 4 * 4; stride <= options.maxStride; stride += 4) {
+        strides.push_back(stride / 4);
+    }
+
+    uint32_t minVertices = std::max(options.minVertices, 3u);
+    std::vector<Run> runs;
+    std::mutex runsMutex;
+    std::vector<uint8_t> wordClass, vertexClass;
+
+    for (bool bigEndian: { false, true }) {
+        classifyVertices(data, words, bigEndian, wordClass, vertexClass);
+
+        workerPool().parallelFor(strides.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                std::vector<Run> found;
+                findRuns(data, vertexClass, strides[i], bigEndian, minVertices, found, cancel);
+
+                std::lock_guard<std::mutex> lock(runsMutex);
+                runs.insert(runs.end(), found.begin(), found.end());
+            }
+        });
+        if (cancel && cancel->load()) return;
+    }
+
+    resolveOverlaps(runs);
+
+    candidates.resize(runs.size());
+    workerPool().parallelFor(runs.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const Run& run = runs[i];
+            MeshCandidate& candidate = candidates[i];
+            candidate.confidence = run.confidence;
+            candidate.params.vertexBufferStart = (uint64_t) run.firstWord * 4;
+            candidate.params.vertexStride = run.strideWords * 4;
+            candidate.params.vertexCount = run.count;
+            candidate.params.bigEndian = run.bigEndian;
+            candidate.params.meshType = MTPoint;
+
+            VisParams unpaired = candidate.params;
+            pairIndices(data, size, run, candidate);
+            MeshScore score;
+            if (candidate.params.indexedDraw && scoreMesh(data, size, candidate.params, score)) {
+                if (score.score >= MinPairingScore) candidate.plausibility = score.score;
+                else candidate.params = unpaired;
+            }
+        }
+    });
+
+    std::stable_sort(candidates.begin(), candidates.end(), [](const MeshCandidate& a, const MeshCandidate& b) {
+        return a.confidence + a.plausibility > b.confidence + b.plausibility;
+    });
+}
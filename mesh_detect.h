@@ -0,0 +1,29 @@
+#pragma once
+
+#include "vis_params.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct MeshCandidate
+{
+    VisParams params;
+    float confidence = 0.0f;    // 0..1, from how smoothly consecutive vertices move relative to the mesh's size
+    float plausibility = 0.0f;  // 0..1 geometric score of the paired index buffer's triangles, 0 when unpaired
+};
+
+struct DetectOptions
+{
+    uint32_t minVertices = 32;
+    uint32_t minStride = 12;
+    uint32_t maxStride = 64;
+};
+
+// Looks for runs of plausible xyz float positions at every 4-byte-aligned offset, each stride and both byte orders,
+// then pairs each run with a nearby 16- or 32-bit index buffer whose values fit it and whose triangles score as a
+// plausible surface. Positions are assumed to lead each vertex, so of equally long overlapping runs with the same
+// layout the earliest is kept. Candidates come back ranked by confidence and plausibility together, best first.
+void detectMeshes(const uint8_t *data, size_t size, std::vector<MeshCandidate>& candidates,
+                  const DetectOptions& options = DetectOptions(), const std::atomic<bool> *cancel = nullptr);
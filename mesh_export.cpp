@@ -0,0 +1,445 @@
+#include "mesh_export.h"
+#include "piece_table.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+namespace
+{
+    constexpr size_t ChunkSize = 4 << 20;
+
+    // Accumulates output and hands it to the stream in ChunkSize pieces
+    class ChunkedWriter
+    {
+    public:
+        explicit ChunkedWriter(const std::string& path)
+            : out_(path, std::ios::binary | std::ios::trunc)
+        {
+            buffer_.reserve(ChunkSize);
+        }
+
+        bool isOpen() const { return out_.is_open(); }
+
+        void put(const void *data, size_t size)
+        {
+            if (buffer_.size() + size > ChunkSize) flush();
+            buffer_.insert(buffer_.end(), (const char *) data, (const char *) data + size);
+        }
+
+        void putText(const char *text)
+        {
+            put(text, strlen(text));
+        }
+
+        template<class T>
+        void putValue(T value)
+        {
+            put(&value, sizeof(T));
+        }
+
+        bool finish()
+        {
+            flush();
+            out_.close();
+            return (bool) out_;
+        }
+
+    private:
+        void flush()
+        {
+            out_.write(buffer_.data(), (std::streamsize) buffer_.size());
+            buffer_.clear();
+        }
+
+        std::ofstream out_;
+        std::vector<char> buffer_;
+    };
+
+    enum PrimitiveKind
+    {
+        PKTriangles,
+        PKLines,
+        PKPoints
+    };
+
+    PrimitiveKind primitiveKind(MeshType type)
+    {
+        switch (type) {
+            case MTLine:
+            case MTLineStrip:
+            case MTLineLoop:
+                return PKLines;
+            case MTPoint:
+                return PKPoints;
+            default:
+                return PKTriangles;
+        }
+    }
+
+    // Reads the draw's elements and vertex positions the way render() feeds them to the GPU
+    struct MeshReader
+    {
+        const PieceSnapshot& snapshot;
+        const VisParams& params;
+        uint64_t stride;
+        uint64_t elementCount;
+        uint64_t vertexCount = 0;
+
+        // The index and vertex buffers, set by prepare() once their extents are known
+        const uint8_t *indices = nullptr;
+        const uint8_t *vertices = nullptr;
+        std::vector<uint8_t> indexScratch;
+        std::vector<uint8_t> vertexScratch;
+
+        uint32_t load32(const uint8_t *p) const
+        {
+            uint8_t b[4];
+            memcpy(b, p, 4);
+            return params.bigEndian ? (uint32_t) b[0] << 24 | (uint32_t) b[1] << 16 | (uint32_t) b[2] << 8 | b[3]
+                                    : (uint32_t) b[3] << 24 | (uint32_t) b[2] << 16 | (uint32_t) b[1] << 8 | b[0];
+        }
+
+        uint32_t element(uint64_t k) const
+        {
+            if (!params.indexedDraw) return (uint32_t) k;
+
+            if (params.halfWidthIndexes) {
+                const uint8_t *p = indices + k * 2;
+                return params.bigEndian ? (uint32_t) p[0] << 8 | p[1] : (uint32_t) p[1] << 8 | p[0];
+            }
+            return load32(indices + k * 4);
+        }
+
+        // Garbage offsets decode to NaNs and infinities all the time; they're written as 0 so every format loads
+        float coordinate(uint64_t vertex, int axis) const
+        {
+            uint32_t bits = load32(vertices + vertex * stride + axis * 4);
+            float value;
+            memcpy(&value, &bits, 4);
+            return std::isfinite(value) ? value : 0.0f;
+        }
+
+        uint64_t primitiveCount() const
+        {
+            uint64_t n = elementCount;
+            switch (params.meshType) {
+                case MTTriangle: return n / 3;
+                case MTTriangleStrip:
+                case MTTriangleFan: return n >= 3 ? n - 2 : 0;
+                case MTQuad: return n / 4 * 2;
+                case MTQuadStrip: return n >= 4 ? (n - 2) / 2 * 2 : 0;
+                case MTLine: return n / 2;
+                case MTLineStrip: return n >= 2 ? n - 1 : 0;
+                case MTLineLoop: return n >= 2 ? n : 0;
+                default: return 0;
+            }
+        }
+
+        // Calls emit(a, b, c) per triangle, or emit(a, b, 0) per line, in draw order
+        template<class F>
+        bool forEachPrimitive(F&& emit, std::atomic<float> *progress, const std::atomic<bool> *cancel) const
+        {
+            uint64_t n = elementCount;
+            auto e = [this](uint64_t k) { return element(k); };
+
+            for (uint64_t k = 0; k < n; k++) {
+                if ((k & 0xFFFF) == 0) {
+                    if (cancel && cancel->load(std::memory_order_relaxed)) return false;
+                    if (progress) progress->store(0.5f + 0.5f * (float) k / (float) n, std::memory_order_relaxed);
+                }
+
+                switch (params.meshType) {
+                    case MTTriangle:
+                        if (k % 3 == 2) emit(e(k - 2), e(k - 1), e(k));
+                        break;
+                    case MTTriangleStrip:
+                        // Every other triangle of a strip is wound the other way
+                        if (k >= 2) {
+                            if (k % 2 == 0) emit(e(k - 2), e(k - 1), e(k));
+                            else emit(e(k - 1), e(k - 2), e(k));
+                        }
+                        break;
+                    case MTTriangleFan:
+                        if (k >= 2) emit(e(0), e(k - 1), e(k));
+                        break;
+                    case MTQuad:
+                        if (k % 4 == 3) {
+                            emit(e(k - 3), e(k - 2), e(k - 1));
+                            emit(e(k - 3), e(k - 1), e(k));
+                        }
+                        break;
+                    case MTQuadStrip:
+                        if (k >= 3 && k % 2 == 1) {
+                            emit(e(k - 3), e(k - 2), e(k));
+                            emit(e(k - 3), e(k), e(k - 1));
+                        }
+                        break;
+                    case MTLine:
+                        if (k % 2 == 1) emit(e(k - 1), e(k), 0);
+                        break;
+                    case MTLineStrip:
+                    case MTLineLoop:
+                        if (k >= 1) emit(e(k - 1), e(k), 0);
+                        if (params.meshType == MTLineLoop && k == n - 1 && n >= 2) emit(e(k), e(0), 0);
+                        break;
+                    default:
+                        break;
+                }
+            }
+            return true;
+        }
+    };
+
+    // Checks every read the export will make up front, so the decoding loops don't need to, and fetches just the
+    // bytes they'll read. Those come straight from the snapshot's pieces unless an edit falls inside them.
+    bool prepare(MeshReader& mesh, std::string& error)
+    {
+        const VisParams& p = mesh.params;
+        uint64_t size = mesh.snapshot.size();
+        if (p.vertexCount == 0) {
+            error = "The current parameters don't describe a mesh";
+            return false;
+        }
+
+        // Like OpenGL, a stride of 0 means tightly packed positions
+        uint64_t vertexStart = p.vertexBufferStart;
+        if (vertexStart >= size || size - vertexStart < 12) {
+            error = "The vertex buffer starts past the end of the file";
+            return false;
+        }
+        uint64_t capacity = (size - vertexStart - 12) / mesh.stride + 1;
+        auto fetchVertices = [&] {
+            uint64_t length = (mesh.vertexCount - 1) * mesh.stride + 12;
+            mesh.vertices = mesh.snapshot.contiguous(vertexStart, length, mesh.vertexScratch);
+        };
+
+        if (!p.indexedDraw) {
+            if (mesh.elementCount > capacity) {
+                error = "The vertices run past the end of the file";
+                return false;
+            }
+            mesh.vertexCount = mesh.elementCount;
+            fetchVertices();
+            return true;
+        }
+
+        uint64_t indexWidth = p.halfWidthIndexes ? 2 : 4;
+        if (p.indexBufferStart > size || mesh.elementCount > (size - p.indexBufferStart) / indexWidth) {
+            error = "The index buffer runs past the end of the file";
+            return false;
+        }
+        mesh.indices = mesh.snapshot.contiguous(p.indexBufferStart, mesh.elementCount * indexWidth, mesh.indexScratch);
+
+        // Indexed draws only reference as many vertices as the largest index, which needs one pass over the indices
+        uint32_t maxIndex = 0;
+        for (uint64_t k = 0; k < mesh.elementCount; k++) {
+            maxIndex = std::max(maxIndex, mesh.element(k));
+        }
+        if (maxIndex >= capacity) {
+            error = "Index " + std::to_string(maxIndex) + " points past the end of the file";
+            return false;
+        }
+        mesh.vertexCount = (uint64_t) maxIndex + 1;
+        fetchVertices();
+        return true;
+    }
+
+    void appendFloat(char *&cursor, char *end, float value)
+    {
+        *cursor++ = ' ';
+        cursor = std::to_chars(cursor, end, value).ptr;
+    }
+
+    void appendIndex(char *&cursor, char *end, uint64_t value)
+    {
+        *cursor++ = ' ';
+        cursor = std::to_chars(cursor, end, value).ptr;
+    }
+
+    template<class F>
+    bool forEachVertex(const MeshReader& mesh, F&& emit, std::atomic<float> *progress,
+                       const std::atomic<bool> *cancel)
+    {
+        for (uint64_t v = 0; v < mesh.vertexCount; v++) {
+            if ((v & 0xFFFF) == 0) {
+                if (cancel && cancel->load(std::memory_order_relaxed)) return false;
+                if (progress) progress->store(0.5f * (float) v / (float) mesh.vertexCount, std::memory_order_relaxed);
+            }
+            emit(mesh.coordinate(v, 0), mesh.coordinate(v, 1), mesh.coordinate(v, 2));
+        }
+        return true;
+    }
+
+    bool writeObj(const MeshReader& mesh, ChunkedWriter& out, std::atomic<float> *progress,
+                  const std::atomic<bool> *cancel)
+    {
+        out.putText("# exported by hexspanned\n");
+
+        char line[128];
+        bool complete = forEachVertex(mesh, [&](float x, float y, float z) {
+            char *cursor = line, *end = line + sizeof(line);
+            *cursor++ = 'v';
+            appendFloat(cursor, end, x);
+            appendFloat(cursor, end, y);
+            appendFloat(cursor, end, z);
+            *cursor++ = '\n';
+            out.put(line, cursor - line);
+        }, progress, cancel);
+        if (!complete) return false;
+
+        PrimitiveKind kind = primitiveKind(mesh.params.meshType);
+        if (kind == PKPoints) return true;
+
+        // OBJ indices are 1-based
+        return mesh.forEachPrimitive([&](uint32_t a, uint32_t b, uint32_t c) {
+            char *cursor = line, *end = line + sizeof(line);
+            *cursor++ = kind == PKTriangles ? 'f' : 'l';
+            appendIndex(cursor, end, (uint64_t) a + 1);
+            appendIndex(cursor, end, (uint64_t) b + 1);
+            if (kind == PKTriangles) appendIndex(cursor, end, (uint64_t) c + 1);
+            *cursor++ = '\n';
+            out.put(line, cursor - line);
+        }, progress, cancel);
+    }
+
+    // Values are written in host order, which is little-endian on every platform we build for
+    bool writePly(const MeshReader& mesh, ChunkedWriter& out, std::atomic<float> *progress,
+                  const std::atomic<bool> *cancel)
+    {
+        PrimitiveKind kind = primitiveKind(mesh.params.meshType);
+        std::string header = "ply\nformat binary_little_endian 1.0\ncomment exported by hexspanned\n"
+                             "element vertex " + std::to_string(mesh.vertexCount) + "\n"
+                             "property float x\nproperty float y\nproperty float z\n";
+        if (kind == PKTriangles) {
+            header += "element face " + std::to_string(mesh.primitiveCount()) + "\n"
+                      "property list uchar int vertex_indices\n";
+        } else if (kind == PKLines) {
+            header += "element edge " + std::to_string(mesh.primitiveCount()) + "\n"
+                      "property int vertex1\nproperty int vertex2\n";
+        }
+        header += "end_header\n";
+        out.put(header.data(), header.size());
+
+        bool complete = forEachVertex(mesh, [&](float x, float y, float z) {
+            float xyz[3] = { x, y, z };
+            out.put(xyz, sizeof(xyz));
+        }, progress, cancel);
+        if (!complete || kind == PKPoints) return complete;
+
+        return mesh.forEachPrimitive([&](uint32_t a, uint32_t b, uint32_t c) {
+            if (kind == PKTriangles) {
+                uint8_t face[13] = { 3 };
+                int32_t indices[3] = { (int32_t) a, (int32_t) b, (int32_t) c };
+                memcpy(face + 1, indices, sizeof(indices));
+                out.put(face, sizeof(face));
+            } else {
+                int32_t edge[2] = { (int32_t) a, (int32_t) b };
+                out.put(edge, sizeof(edge));
+            }
+        }, progress, cancel);
+    }
+
+    bool writeGltf(const MeshReader& mesh, ChunkedWriter& out, const std::string& path, const std::string& binPath,
+                   std::string& error, std::atomic<float> *progress, const std::atomic<bool> *cancel)
+    {
+        float min[3] = { INFINITY, INFINITY, INFINITY };
+        float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+        bool complete = forEachVertex(mesh, [&](float x, float y, float z) {
+            float xyz[3] = { x, y, z };
+            for (int axis = 0; axis < 3; axis++) {
+                min[axis] = std::min(min[axis], xyz[axis]);
+                max[axis] = std::max(max[axis], xyz[axis]);
+            }
+            out.put(xyz, sizeof(xyz));
+        }, progress, cancel);
+        if (!complete) return false;
+
+        PrimitiveKind kind = primitiveKind(mesh.params.meshType);
+        uint64_t indexCount = 0;
+        if (kind != PKPoints) {
+            complete = mesh.forEachPrimitive([&](uint32_t a, uint32_t b, uint32_t c) {
+                out.putValue(a);
+                out.putValue(b);
+                if (kind == PKTriangles) out.putValue(c);
+                indexCount += kind == PKTriangles ? 3 : 2;
+            }, progress, cancel);
+            if (!complete) return false;
+        }
+
+        uint64_t positionBytes = mesh.vertexCount * 12;
+        nlohmann::json gltf = {
+            { "asset", { { "version", "2.0" }, { "generator", "hexspanned" } } },
+            { "buffers", { { { "uri", std::filesystem::path(binPath).filename().string() },
+                             { "byteLength", positionBytes + indexCount * 4 } } } },
+            { "bufferViews", { { { "buffer", 0 }, { "byteOffset", 0 }, { "byteLength", positionBytes },
+                                 { "target", 34962 } } } },
+            { "accessors", { { { "bufferView", 0 }, { "componentType", 5126 }, { "count", mesh.vertexCount },
+                               { "type", "VEC3" }, { "min", { min[0], min[1], min[2] } },
+                               { "max", { max[0], max[1], max[2] } } } } },
+            { "nodes", { { { "mesh", 0 } } } },
+            { "scenes", { { { "nodes", { 0 } } } } },
+            { "scene", 0 }
+        };
+
+        nlohmann::json primitive = { { "attributes", { { "POSITION", 0 } } } };
+        primitive["mode"] = kind == PKTriangles ? 4 : kind == PKLines ? 1 : 0;
+        if (indexCount > 0) {
+            gltf["bufferViews"].push_back({ { "buffer", 0 }, { "byteOffset", positionBytes },
+                                            { "byteLength", indexCount * 4 }, { "target", 34963 } });
+            gltf["accessors"].push_back({ { "bufferView", 1 }, { "componentType", 5125 }, { "count", indexCount },
+                                          { "type", "SCALAR" } });
+            primitive["indices"] = 1;
+        }
+        gltf["meshes"] = { { { "primitives", { primitive } } } };
+
+        std::ofstream json(path, std::ios::trunc);
+        if (!json.is_open()) {
+            error = "Couldn't open " + path + " for writing";
+            return false;
+        }
+        json << gltf.dump(2);
+        return (bool) json;
+    }
+}
+
+bool exportMesh(const PieceSnapshot& snapshot, const VisParams& params, MeshFormat format, const std::string& path,
+                std::string& error, std::atomic<float> *progress, const std::atomic<bool> *cancel)
+{
+    MeshReader mesh { snapshot, params, params.vertexStride ? (uint64_t) params.vertexStride : 12,
+                      params.vertexCount };
+    if (!prepare(mesh, error)) return false;
+
+    // glTF keeps the geometry in the .bin and writes its JSON last, once bounds and counts are known
+    std::string dataPath = path;
+    if (format == MFGltf) dataPath = std::filesystem::path(path).replace_extension(".bin").string();
+
+    ChunkedWriter out(dataPath);
+    if (!out.isOpen()) {
+        error = "Couldn't open " + dataPath + " for writing";
+        return false;
+    }
+
+    bool complete;
+    switch (format) {
+        case MFObj:
+            complete = writeObj(mesh, out, progress, cancel);
+            break;
+        case MFPly:
+            complete = writePly(mesh, out, progress, cancel);
+            break;
+        default:
+            complete = writeGltf(mesh, out, path, dataPath, error, progress, cancel);
+            break;
+    }
+
+    if (!out.finish() && error.empty()) error = "Error writing " + dataPath;
+    if (!complete && error.empty()) error = "Export cancelled";
+    if (progress) progress->store(1.0f);
+    return complete && error.empty();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "vis_params.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class PieceSnapshot;
+
+enum MeshFormat
+{
+    MFObj,
+    MFPly,  // binary little-endian
+    MFGltf  // .gltf JSON next to a .bin with the same name
+};
+
+// Writes the mesh the visualizer would draw with `params`, decoding positions and indices out of `snapshot` with the
+// selected endianness, stride and index width. Strips, fans and quads are written as triangle lists and
+// line strips and loops as line lists, so every format sees the same primitives. Output is written in large chunks
+// as it's decoded, never holding the whole mesh in memory.
+//
+// Meant to run on the worker pool. Only the index and vertex buffers are read, straight from the mapping where no
+// edits fall inside them.
+bool exportMesh(const PieceSnapshot& snapshot, const VisParams& params, MeshFormat format, const std::string& path,
+                std::string& error, std::atomic<float> *progress = nullptr, const std::atomic<bool> *cancel = nullptr);
@@ -0,0 +1,324 @@
+#include "mesh_score.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define HEXSPANNED_SSE2 1
+#endif
+
+namespace
+{
+    // A triangle is degenerate when its area is this small next to its longest edge, about a 0.01 degree sliver
+    constexpr float DegenerateSine = 1e-4f;
+
+    // Positions gathered structure-of-arrays so the edge math runs four triangles to a vector
+    struct Corners
+    {
+        std::vector<float> x[3], y[3], z[3];
+        std::vector<uint32_t> vertex[3];
+
+        void resize(size_t count)
+        {
+            for (int c = 0; c < 3; c++) {
+                x[c].resize(count);
+                y[c].resize(count);
+                z[c].resize(count);
+                vertex[c].resize(count);
+            }
+        }
+    };
+
+    struct Measures
+    {
+        std::vector<float> edge[3];  // squared lengths of b - a, c - b and a - c
+        std::vector<float> area;     // squared length of (b - a) x (c - a), four times the squared area
+
+        void resize(size_t count)
+        {
+            for (auto& lengths: edge) lengths.resize(count);
+            area.resize(count);
+        }
+    };
+
+    inline uint32_t swapWord(uint32_t w)
+    {
+        return (w >> 24) | ((w >> 8) & 0x0000FF00u) | ((w << 8) & 0x00FF0000u) | (w << 24);
+    }
+
+    inline float loadFloat(const uint8_t *p, bool bigEndian)
+    {
+        uint32_t bits;
+        memcpy(&bits, p, 4);
+        if (bigEndian) bits = swapWord(bits);
+        float f;
+        memcpy(&f, &bits, 4);
+        return f;
+    }
+
+    inline uint32_t loadIndex(const uint8_t *p, bool bigEndian, bool halfWidth)
+    {
+        if (halfWidth) return bigEndian ? (uint32_t) (p[0] << 8 | p[1]) : (uint32_t) (p[0] | p[1] << 8);
+        uint32_t index;
+        memcpy(&index, p, 4);
+        return bigEndian ? swapWord(index) : index;
+    }
+
+    bool isConnected(const VisParams& params)
+    {
+        return params.indexedDraw || params.meshType == MTTriangleStrip || params.meshType == MTTriangleFan;
+    }
+
+    uint32_t triangleCount(const VisParams& params)
+    {
+        auto count = (uint32_t) std::min<uint64_t>(params.vertexCount, UINT32_MAX);
+        if (params.meshType == MTTriangleStrip || params.meshType == MTTriangleFan) return count >= 3 ? count - 2 : 0;
+        return count / 3;
+    }
+
+    // Element numbers of triangle k's corners, before any index lookup
+    void triangleElements(const VisParams& params, uint32_t k, uint32_t elements[3])
+    {
+        if (params.meshType == MTTriangleStrip) {
+            elements[0] = k;
+            elements[1] = k + 1;
+            elements[2] = k + 2;
+        } else if (params.meshType == MTTriangleFan) {
+            elements[0] = 0;
+            elements[1] = k + 1;
+            elements[2] = k + 2;
+        } else {
+            elements[0] = 3 * k;
+            elements[1] = 3 * k + 1;
+            elements[2] = 3 * k + 2;
+        }
+    }
+
+    // A mapped buffer read like a PieceSnapshot, so the detector's scoring compiles down to plain loads
+    struct FlatBytes
+    {
+        const uint8_t *data;
+        size_t length;
+
+        size_t size() const { return length; }
+        size_t read(size_t offset, uint8_t *out, size_t count) const
+        {
+            memcpy(out, data + offset, count);
+            return count;
+        }
+    };
+
+    // Out-of-range corners decode as NaN, which fails every area test and so counts as degenerate
+    template<class Source>
+    void gather(const Source& data, const VisParams& params, uint32_t triangles, Corners& corners)
+    {
+        size_t size = data.size();
+        corners.resize(triangles);
+        uint64_t indexWidth = params.halfWidthIndexes ? 2 : 4;
+        uint64_t stride = params.vertexStride;
+
+        for (uint32_t k = 0; k < triangles; k++) {
+            uint32_t elements[3];
+            triangleElements(params, k, elements);
+            for (int c = 0; c < 3; c++) {
+                uint32_t vertex = elements[c];
+                if (params.indexedDraw) {
+                    uint64_t at = params.indexBufferStart + elements[c] * indexWidth;
+                    uint8_t index[4];
+                    vertex = at + indexWidth <= size && data.read((size_t) at, index, indexWidth) == indexWidth
+                           ? loadIndex(index, params.bigEndian, params.halfWidthIndexes) : UINT32_MAX;
+                }
+                corners.vertex[c][k] = vertex;
+
+                uint64_t base = params.vertexBufferStart + vertex * stride;
+                uint8_t position[12];
+                if (vertex != UINT32_MAX && base + 12 <= size && data.read((size_t) base, position, 12) == 12) {
+                    corners.x[c][k] = loadFloat(position, params.bigEndian);
+                    corners.y[c][k] = loadFloat(position + 4, params.bigEndian);
+                    corners.z[c][k] = loadFloat(position + 8, params.bigEndian);
+                } else {
+                    corners.x[c][k] = corners.y[c][k] = corners.z[c][k] = NAN;
+                }
+            }
+        }
+    }
+
+    void measureScalar(const Corners& t, size_t i, Measures& m)
+    {
+        float ux = t.x[1][i] - t.x[0][i], uy = t.y[1][i] - t.y[0][i], uz = t.z[1][i] - t.z[0][i];
+        float vx = t.x[2][i] - t.x[0][i], vy = t.y[2][i] - t.y[0][i], vz = t.z[2][i] - t.z[0][i];
+        float wx = t.x[2][i] - t.x[1][i], wy = t.y[2][i] - t.y[1][i], wz = t.z[2][i] - t.z[1][i];
+        m.edge[0][i] = ux * ux + uy * uy + uz * uz;
+        m.edge[1][i] = wx * wx + wy * wy + wz * wz;
+        m.edge[2][i] = vx * vx + vy * vy + vz * vz;
+
+        float cx = uy * vz - uz * vy, cy = uz * vx - ux * vz, cz = ux * vy - uy * vx;
+        m.area[i] = cx * cx + cy * cy + cz * cz;
+    }
+
+    void measure(const Corners& t, size_t count, Measures& m)
+    {
+        m.resize(count);
+        size_t i = 0;
+#ifdef HEXSPANNED_SSE2
+        for (; i + 4 <= count; i += 4) {
+            __m128 ax = _mm_loadu_ps(&t.x[0][i]), ay = _mm_loadu_ps(&t.y[0][i]), az = _mm_loadu_ps(&t.z[0][i]);
+            __m128 bx = _mm_loadu_ps(&t.x[1][i]), by = _mm_loadu_ps(&t.y[1][i]), bz = _mm_loadu_ps(&t.z[1][i]);
+            __m128 cx = _mm_loadu_ps(&t.x[2][i]), cy = _mm_loadu_ps(&t.y[2][i]), cz = _mm_loadu_ps(&t.z[2][i]);
+
+            __m128 ux = _mm_sub_ps(bx, ax), uy = _mm_sub_ps(by, ay), uz = _mm_sub_ps(bz, az);
+            __m128 vx = _mm_sub_ps(cx, ax), vy = _mm_sub_ps(cy, ay), vz = _mm_sub_ps(cz, az);
+            __m128 wx = _mm_sub_ps(cx, bx), wy = _mm_sub_ps(cy, by), wz = _mm_sub_ps(cz, bz);
+
+            auto dot = [](__m128 x, __m128 y, __m128 z) {
+                return _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+            };
+            _mm_storeu_ps(&m.edge[0][i], dot(ux, uy, uz));
+            _mm_storeu_ps(&m.edge[1][i], dot(wx, wy, wz));
+            _mm_storeu_ps(&m.edge[2][i], dot(vx, vy, vz));
+
+            __m128 nx = _mm_sub_ps(_mm_mul_ps(uy, vz), _mm_mul_ps(uz, vy));
+            __m128 ny = _mm_sub_ps(_mm_mul_ps(uz, vx), _mm_mul_ps(ux, vz));
+            __m128 nz = _mm_sub_ps(_mm_mul_ps(ux, vy), _mm_mul_ps(uy, vx));
+            _mm_storeu_ps(&m.area[i], dot(nx, ny, nz));
+        }
+#endif
+        for (; i < count; i++) measureScalar(t, i, m);
+    }
+
+    // log2 from the float's bits: exact at powers of two and within 0.09 between, plenty for a spread
+    inline float fastLog2(float x)
+    {
+        uint32_t bits;
+        memcpy(&bits, &x, 4);
+        return (float) bits * (1.0f / 8388608.0f) - 127.0f;
+    }
+
+    float interquartileRange(std::vector<float>& values)
+    {
+        if (values.size() < 4) return 0.0f;
+        auto lower = values.begin() + (ptrdiff_t) (values.size() / 4);
+        auto upper = values.begin() + (ptrdiff_t) (values.size() * 3 / 4);
+        std::nth_element(values.begin(), lower, values.end());
+        float low = *lower;
+        std::nth_element(lower, upper, values.end());
+        return *upper - low;
+    }
+
+    // Manifold ratio and reuse over the vertex numbers of non-degenerate triangles
+    void scoreConnectivity(const Corners& t, const std::vector<bool>& degenerate, MeshScore& score)
+    {
+        std::vector<uint64_t> edges;
+        std::vector<uint32_t> uses;
+        for (size_t k = 0; k < degenerate.size(); k++) {
+            if (degenerate[k]) continue;
+            for (int c = 0; c < 3; c++) {
+                uint32_t a = t.vertex[c][k], b = t.vertex[(c + 1) % 3][k];
+                edges.push_back((uint64_t) std::min(a, b) << 32 | std::max(a, b));
+                uses.push_back(a);
+            }
+        }
+        if (edges.empty()) return;
+
+        std::sort(edges.begin(), edges.end());
+        size_t distinct = 0, shared = 0;
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i;
+            while (j < edges.size() && edges[j] == edges[i]) j++;
+            distinct++;
+            shared += j - i == 2;
+            i = j;
+        }
+        score.manifoldRatio = (float) shared / (float) distinct;
+
+        std::sort(uses.begin(), uses.end());
+        double sum = 0.0, sumSquares = 0.0;
+        size_t vertices = 0;
+        for (size_t i = 0; i < uses.size();) {
+            size_t j = i;
+            while (j < uses.size() && uses[j] == uses[i]) j++;
+            auto count = (double) (j - i);
+            sum += count;
+            sumSquares += count * count;
+            vertices++;
+            i = j;
+        }
+        double mean = sum / (double) vertices;
+        score.meanReuse = (float) mean;
+        score.reuseSpread = (float) (std::sqrt(std::max(0.0, sumSquares / (double) vertices - mean * mean)) / mean);
+    }
+
+    template<class Source>
+    bool scoreSource(const Source& data, const VisParams& params, MeshScore& score, uint32_t maxTriangles)
+    {
+        score = MeshScore();
+        uint32_t triangles = std::min(triangleCount(params), maxTriangles);
+        if (triangles == 0 || params.vertexStride == 0) return false;
+
+        Corners corners;
+        Measures measures;
+        gather(data, params, triangles, corners);
+        measure(corners, triangles, measures);
+
+        std::vector<bool> degenerate(triangles);
+        std::vector<float> logLengths;
+        logLengths.reserve((size_t) triangles * 3);
+        size_t degenerateCount = 0;
+        for (uint32_t k = 0; k < triangles; k++) {
+            float longest = std::max({ measures.edge[0][k], measures.edge[1][k], measures.edge[2][k] });
+            bool repeated = corners.vertex[0][k] == corners.vertex[1][k] ||
+                            corners.vertex[1][k] == corners.vertex[2][k] ||
+                            corners.vertex[0][k] == corners.vertex[2][k];
+
+            // Written so NaN and infinity land on the degenerate side
+            bool flat = !(measures.area[k] > DegenerateSine * DegenerateSine * longest * longest) ||
+                        !(longest < INFINITY);
+            degenerate[k] = repeated || flat;
+            if (degenerate[k]) {
+                degenerateCount++;
+                continue;
+            }
+            for (const auto& lengths: measures.edge) logLengths.push_back(0.5f * fastLog2(lengths[k]));
+        }
+
+        score.triangles = triangles;
+        score.degenerateFraction = (float) degenerateCount / (float) triangles;
+        score.edgeSpread = interquartileRange(logLengths);
+
+        float flatness = std::clamp(1.0f - score.degenerateFraction * 4.0f, 0.0f, 1.0f);
+        float evenness = std::clamp(1.0f - (score.edgeSpread - 1.0f) / 3.0f, 0.0f, 1.0f);
+        if (!isConnected(params)) {
+            score.score = 0.6f * flatness + 0.4f * evenness;
+            return true;
+        }
+
+        // A real surface shares most edges between two triangles and each vertex between several of them
+        scoreConnectivity(corners, degenerate, score);
+        float reuse = std::clamp((score.meanReuse - 1.0f) / 3.0f, 0.0f, 1.0f) *
+                      (1.0f - 0.5f * std::min(score.reuseSpread, 1.0f));
+        score.score = 0.3f * flatness + 0.2f * evenness + 0.3f * score.manifoldRatio + 0.2f * reuse;
+        return true;
+    }
+}
+
+bool scoreMesh(const uint8_t *data, size_t size, const VisParams& params, MeshScore& score, uint32_t maxTriangles)
+{
+    return scoreSource(FlatBytes{ data, size }, params, score, maxTriangles);
+}
+
+bool scoreMesh(const PieceSnapshot& data, const VisParams& params, MeshScore& score, uint32_t maxTriangles)
+{
+    return scoreSource(data, params, score, maxTriangles);
+}
+
+void scoreMeshes(const uint8_t *data, size_t size, const std::vector<VisParams>& params, std::vector<MeshScore>& scores,
+                 uint32_t maxTriangles)
+{
+    scores.resize(params.size());
+    workerPool().parallelFor(params.size(), 4, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) scoreMesh(data, size, params[i], scores[i], maxTriangles);
+    });
+}
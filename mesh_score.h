@@ -0,0 +1,33 @@
+#pragma once
+
+#include "piece_table.h"
+#include "vis_params.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How much a candidate's triangles look like a modelled surface rather than bytes that happen to decode
+struct MeshScore
+{
+    uint32_t triangles = 0;         // triangles scored, at most the sample limit
+    float degenerateFraction = 1;   // zero-area, repeated-vertex, out-of-range or non-finite triangles
+    float edgeSpread = 0;           // interquartile range of log2 edge length; tessellation is usually even
+    float manifoldRatio = 0;        // distinct edges shared by exactly two triangles; indexed meshes only
+    float meanReuse = 0;            // triangles using each referenced vertex, on average; indexed meshes only
+    float reuseSpread = 0;          // coefficient of variation of that count
+    float score = 0;                // 0..1 blend of the above, higher is more plausible
+};
+
+// Scores the first `maxTriangles` triangles `params` would draw, decoding straight out of `data`. Strips and fans are
+// walked as such; every other mesh type is read as a triangle list, so point clouds from the detector are scored as
+// triangle soup and only their degenerate fraction and edge spread count. Returns false if nothing could be decoded.
+bool scoreMesh(const uint8_t *data, size_t size, const VisParams& params, MeshScore& score,
+               uint32_t maxTriangles = 2048);
+
+// The same, reading a snapshot of the edited contents so it can run on the pool
+bool scoreMesh(const PieceSnapshot& data, const VisParams& params, MeshScore& score, uint32_t maxTriangles = 2048);
+
+// Scores many layouts at once on the worker pool
+void scoreMeshes(const uint8_t *data, size_t size, const std::vector<VisParams>& params, std::vector<MeshScore>& scores,
+                 uint32_t maxTriangles = 2048);
@@ -0,0 +1,105 @@
+#include "pattern_search.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    constexpr size_t ChunkSize = 4 << 20;
+
+    // Rough frequency of each byte value in binary files; zeros and 0xFF padding dominate, so they're poor anchors
+    int byteCommonness(uint8_t b)
+    {
+        if (b == 0x00 || b == 0xFF) return 3;
+        if (b < 0x10 || b == 0x20 || b >= 0xF0) return 2;
+        if (isalnum(b)) return 1;
+        return 0;
+    }
+
+    // Runs `scan(begin, end, out)` over chunks in parallel, each chunk reporting matches that start inside it,
+    // then joins the per-chunk results in order
+    template<class F>
+    void scanChunks(size_t size, size_t overlap, std::vector<uint64_t>& matches, size_t maxMatches,
+                    const std::atomic<bool> *cancel, F&& scan)
+    {
+        size_t chunkCount = (size + ChunkSize - 1) / ChunkSize;
+        std::vector<std::vector<uint64_t>> found(chunkCount);
+
+        workerPool().parallelFor(chunkCount, 1, [&](size_t first, size_t last) {
+            for (size_t chunk = first; chunk < last; chunk++) {
+                if (cancel && cancel->load(std::memory_order_relaxed)) return;
+                size_t begin = chunk * ChunkSize;
+                size_t end = std::min(size, begin + ChunkSize);
+                scan(begin, end, std::min(size, end + overlap), found[chunk]);
+            }
+        });
+
+        matches.clear();
+        for (auto& chunk: found) {
+            size_t take = std::min(chunk.size(), maxMatches - matches.size());
+            matches.insert(matches.end(), chunk.begin(), chunk.begin() + (ptrdiff_t) take);
+            if (matches.size() == maxMatches) break;
+        }
+    }
+}
+
+void findPattern(const uint8_t *data, size_t size, const uint8_t *pattern, size_t patternSize,
+                 std::vector<uint64_t>& matches, size_t maxMatches, const std::atomic<bool> *cancel)
+{
+    matches.clear();
+    if (patternSize == 0 || patternSize > size) return;
+
+    size_t anchor = 0;
+    for (size_t i = 1; i < patternSize; i++) {
+        if (byteCommonness(pattern[i]) < byteCommonness(pattern[anchor])) anchor = i;
+    }
+
+    scanChunks(size, patternSize - 1, matches, maxMatches, cancel,
+               [&](size_t begin, size_t end, size_t limit, std::vector<uint64_t>& out) {
+        // Candidates are positions of the anchor byte; a match starting at p has it at p + anchor
+        const uint8_t *cursor = data + begin + anchor;
+        const uint8_t *stop = data + std::min(end + anchor, limit - patternSize + anchor + 1);
+        while (cursor < stop) {
+            auto *hit = (const uint8_t *) memchr(cursor, pattern[anchor], (size_t) (stop - cursor));
+            if (!hit) break;
+
+            const uint8_t *start = hit - anchor;
+            if (memcmp(start, pattern, patternSize) == 0) {
+                out.push_back((uint64_t) (start - data));
+                if (out.size() >= maxMatches) return;
+            }
+            cursor = hit + 1;
+        }
+    });
+}
+
+void findFloat(const uint8_t *data, size_t size, float value, float tolerance, bool bigEndian, size_t alignment,
+               std::vector<uint64_t>& matches, size_t maxMatches, const std::atomic<bool> *cancel)
+{
+    matches.clear();
+    if (size < 4) return;
+    alignment = std::max<size_t>(alignment, 1);
+
+    // Compare as doubles so a zero tolerance still finds exact matches without rounding surprises
+    double low = (double) value - tolerance, high = (double) value + tolerance;
+
+    scanChunks(size, 3, matches, maxMatches, cancel,
+               [&](size_t begin, size_t end, size_t limit, std::vector<uint64_t>& out) {
+        size_t first = (begin + alignment - 1) / alignment * alignment;
+        for (size_t offset = first; offset < end && offset + 4 <= limit; offset += alignment) {
+            uint32_t bits;
+            memcpy(&bits, data + offset, 4);
+            if (bigEndian) {
+                bits = (bits >> 24) | ((bits >> 8) & 0x0000FF00u) | ((bits << 8) & 0x00FF0000u) | (bits << 24);
+            }
+            float f;
+            memcpy(&f, &bits, 4);
+            if (f >= low && f <= high) {
+                out.push_back(offset);
+                if (out.size() >= maxMatches) return;
+            }
+        }
+    });
+}
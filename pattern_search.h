@@ -0,0 +1,16 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Offsets of every occurrence of `pattern` in `data`, in order, up to `maxMatches`.
+// Scans for the pattern's rarest byte with memchr and verifies around it, split across the worker pool.
+void findPattern(const uint8_t *data, size_t size, const uint8_t *pattern, size_t patternSize,
+                 std::vector<uint64_t>& matches, size_t maxMatches = SIZE_MAX,
+                 const std::atomic<bool> *cancel = nullptr);
+
+// Offsets of floats within `tolerance` of `value`, checked at every `alignment` bytes
+void findFloat(const uint8_t *data, size_t size, float value, float tolerance, bool bigEndian, size_t alignment,
+               std::vector<uint64_t>& matches, size_t maxMatches = SIZE_MAX, const std::atomic<bool> *cancel = nullptr);
@@ -0,0 +1,315 @@
+#include "piece_table.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Hands `fn` the pieces covering [offset, offset + length), starting from `first`, the piece holding `offset`
+    template<class PieceData>
+    void visitSpans(const std::vector<PieceTable::Piece>& pieces, const std::vector<size_t>& offsets, size_t first,
+                    size_t offset, size_t length, PieceData pieceData,
+                    const std::function<void(const uint8_t *, size_t)>& fn)
+    {
+        for (size_t i = first; i < pieces.size() && length > 0; i++) {
+            const PieceTable::Piece& piece = pieces[i];
+            size_t within = offset - offsets[i];
+            size_t spanLength = std::min(piece.length - within, length);
+
+            fn(pieceData(piece) + within, spanLength);
+
+            offset += spanLength;
+            length -= spanLength;
+        }
+    }
+
+    size_t pieceAt(const std::vector<size_t>& offsets, size_t offset)
+    {
+        return (size_t) (std::upper_bound(offsets.begin(), offsets.end(), offset) - offsets.begin()) - 1;
+    }
+}
+
+void PieceTable::reset(const uint8_t *original, size_t size, std::shared_ptr<const void> owner)
+{
+    original_ = original;
+    owner_ = std::move(owner);
+    pages_.clear();
+    addedSize_ = 0;
+    pieces_.clear();
+    if (size > 0) {
+        pieces_.push_back({ SourceOriginal, 0, size });
+    }
+    size_ = size;
+    rebuildOffsets(0);
+
+    history_.clear();
+    undoPosition_ = savedPosition_ = 0;
+    cachedPiece_ = 0;
+    revision_++;
+}
+
+size_t PieceTable::findPiece(size_t offset) const
+{
+    // Sequential access (hex view rows, streaming reads) almost always lands in the last piece we looked at
+    if (cachedPiece_ < pieces_.size() && offset >= offsets_[cachedPiece_] &&
+        offset < offsets_[cachedPiece_] + pieces_[cachedPiece_].length) {
+        return cachedPiece_;
+    }
+
+    cachedPiece_ = pieceAt(offsets_, offset);
+    return cachedPiece_;
+}
+
+const uint8_t *PieceTable::pieceData(const Piece& piece) const
+{
+    if (piece.source == SourceOriginal) return original_ + piece.start;
+    return pages_[piece.start / PageSize].get() + piece.start % PageSize;
+}
+
+uint8_t PieceTable::readByte(size_t offset) const
+{
+    if (offset >= size_) return 0;
+
+    const Piece& piece = pieces_[findPiece(offset)];
+    return pieceData(piece)[offset - offsets_[cachedPiece_]];
+}
+
+size_t PieceTable::read(size_t offset, uint8_t *out, size_t length) const
+{
+    size_t copied = 0;
+    forEachSpan(offset, length, [&](const uint8_t *span, size_t spanLength) {
+        memcpy(out + copied, span, spanLength);
+        copied += spanLength;
+    });
+    return copied;
+}
+
+void PieceTable::forEachSpan(size_t offset, size_t length,
+                             const std::function<void(const uint8_t *, size_t)>& fn) const
+{
+    if (offset >= size_) return;
+    length = std::min(length, size_ - offset);
+    visitSpans(pieces_, offsets_, findPiece(offset), offset, length,
+               [this](const Piece& piece) { return pieceData(piece); }, fn);
+}
+
+void PieceTable::replace(size_t offset, const uint8_t *bytes, size_t length)
+{
+    if (offset > size_) return;
+    splice(offset, std::min(length, size_ - offset), bytes, length);
+}
+
+void PieceTable::insert(size_t offset, const uint8_t *bytes, size_t length)
+{
+    if (offset > size_) return;
+    splice(offset, 0, bytes, length);
+}
+
+void PieceTable::erase(size_t offset, size_t length)
+{
+    if (offset >= size_) return;
+    splice(offset, std::min(length, size_ - offset), nullptr, 0);
+}
+
+void PieceTable::splice(size_t offset, size_t eraseLength, const uint8_t *bytes, size_t insertLength)
+{
+    if (eraseLength == 0 && insertLength == 0) return;
+
+    size_t end = offset + eraseLength;
+    size_t first = offset == size_ ? pieces_.size() : findPiece(offset);
+    size_t last = first;
+
+    Edit edit;
+    edit.first = first;
+
+    // Pieces overlapping [offset, end) get replaced; an insertion inside a piece splits it in two
+    if (first < pieces_.size() && (eraseLength > 0 || offset > offsets_[first])) {
+        if (end >= size_) {
+            last = pieces_.size();
+        } else {
+            last = findPiece(end);
+            if (offsets_[last] != end) last++;
+        }
+
+        const Piece& head = pieces_[first];
+        if (offset > offsets_[first]) {
+            edit.after.push_back({ head.source, head.start, offset - offsets_[first] });
+        }
+    }
+
+    // Added bytes fill one page after another, so a long insertion becomes a piece per page it lands on
+    for (size_t done = 0; done < insertLength;) {
+        size_t within = addedSize_ % PageSize;
+        if (within == 0) pages_.emplace_back(new uint8_t[PageSize]);
+        size_t count = std::min(insertLength - done, PageSize - within);
+        memcpy(pages_.back().get() + within, bytes + done, count);
+        edit.after.push_back({ SourceAdded, addedSize_, count });
+        addedSize_ += count;
+        done += count;
+    }
+
+    if (last > first) {
+        const Piece& tail = pieces_[last - 1];
+        size_t tailEnd = offsets_[last - 1] + tail.length;
+        if (end < tailEnd) {
+            size_t skip = end - offsets_[last - 1];
+            edit.after.push_back({ tail.source, tail.start + skip, tail.length - skip });
+        }
+        edit.before.assign(pieces_.begin() + (ptrdiff_t) first, pieces_.begin() + (ptrdiff_t) last);
+    }
+
+    swapPieces(edit.first, edit.before, edit.after);
+
+    // A new edit drops the redo branch; if the saved state was on it, it can no longer be reached
+    history_.resize(undoPosition_);
+    if (savedPosition_ > undoPosition_) savedPosition_ = (size_t) -1;
+    history_.push_back(std::move(edit));
+    undoPosition_++;
+}
+
+bool PieceTable::undo()
+{
+    if (!canUndo()) return false;
+
+    const Edit& edit = history_[--undoPosition_];
+    swapPieces(edit.first, edit.after, edit.before);
+    return true;
+}
+
+bool PieceTable::redo()
+{
+    if (!canRedo()) return false;
+
+    const Edit& edit = history_[undoPosition_++];
+    swapPieces(edit.first, edit.before, edit.after);
+    return true;
+}
+
+bool PieceTable::isLayoutPreserved() const
+{
+    for (size_t i = 0; i < pieces_.size(); i++) {
+        if (pieces_[i].source == SourceOriginal && pieces_[i].start != offsets_[i]) return false;
+    }
+    return true;
+}
+
+void PieceTable::swapPieces(size_t first, const std::vector<Piece>& removed, const std::vector<Piece>& inserted)
+{
+    auto at = pieces_.erase(pieces_.begin() + (ptrdiff_t) first,
+                            pieces_.begin() + (ptrdiff_t) (first + removed.size()));
+    pieces_.insert(at, inserted.begin(), inserted.end());
+    rebuildOffsets(first);
+
+    cachedPiece_ = 0;
+    revision_++;
+}
+
+void PieceTable::rebuildOffsets(size_t from)
+{
+    offsets_.resize(pieces_.size());
+    size_t offset = from > 0 ? offsets_[from - 1] + pieces_[from - 1].length : 0;
+    for (size_t i = from; i < pieces_.size(); i++) {
+        offsets_[i] = offset;
+        offset += pieces_[i].length;
+    }
+    size_ = offset;
+}
+
+std::shared_ptr<const PieceSnapshot> PieceTable::snapshot() const
+{
+    if (!snapshots_.empty()) {
+        std::shared_ptr<const PieceSnapshot> latest = snapshots_.back().lock();
+        if (latest && latest->revision_ == revision_) return latest;
+    }
+
+    auto snapshot = std::make_shared<PieceSnapshot>();
+    snapshot->original_ = original_;
+    snapshot->owner_ = owner_;
+    snapshot->pages_ = pages_;
+    snapshot->pieces_ = pieces_;
+    snapshot->offsets_ = offsets_;
+    snapshot->size_ = size_;
+    snapshot->revision_ = revision_;
+
+    std::erase_if(snapshots_, [](const std::weak_ptr<const PieceSnapshot>& held) { return held.expired(); });
+    snapshots_.push_back(snapshot);
+    return snapshot;
+}
+
+bool PieceTable::isSnapshotHeld() const
+{
+    return std::any_of(snapshots_.begin(), snapshots_.end(),
+                       [](const std::weak_ptr<const PieceSnapshot>& held) { return !held.expired(); });
+}
+
+const uint8_t *PieceSnapshot::pieceData(const PieceTable::Piece& piece) const
+{
+    if (piece.source == PieceTable::SourceOriginal) return original_ + piece.start;
+    return pages_[piece.start / PieceTable::PageSize].get() + piece.start % PieceTable::PageSize;
+}
+
+uint8_t PieceSnapshot::readByte(size_t offset) const
+{
+    if (offset >= size_) return 0;
+
+    size_t i = pieceAt(offsets_, offset);
+    return pieceData(pieces_[i])[offset - offsets_[i]];
+}
+
+size_t PieceSnapshot::read(size_t offset, uint8_t *out, size_t length) const
+{
+    size_t copied = 0;
+    forEachSpan(offset, length, [&](const uint8_t *span, size_t spanLength) {
+        memcpy(out + copied, span, spanLength);
+        copied += spanLength;
+    });
+    return copied;
+}
+
+void PieceSnapshot::forEachSpan(size_t offset, size_t length,
+                                const std::function<void(const uint8_t *, size_t)>& fn) const
+{
+    if (offset >= size_) return;
+    length = std::min(length, size_ - offset);
+    visitSpans(pieces_, offsets_, pieceAt(offsets_, offset), offset, length,
+               [this](const PieceTable::Piece& piece) { return pieceData(piece); }, fn);
+}
+
+const uint8_t *PieceSnapshot::contiguous(size_t offset, size_t length, std::vector<uint8_t>& scratch) const
+{
+    scratch.clear();
+    if (offset >= size_) return scratch.data();
+    length = std::min(length, size_ - offset);
+
+    size_t i = pieceAt(offsets_, offset);
+    if (offset + length <= offsets_[i] + pieces_[i].length) return pieceData(pieces_[i]) + offset - offsets_[i];
+
+    scratch.resize(length);
+    read(offset, scratch.data(), length);
+    return scratch.data();
+}
+
+std::vector<std::pair<size_t, size_t>> PieceSnapshot::scanRanges(size_t chunkSize, size_t alignment,
+                                                                 size_t margin) const
+{
+    std::vector<std::pair<size_t, size_t>> ranges;
+    auto split = [&](size_t begin, size_t end) {
+        for (; begin < end; begin += chunkSize) ranges.emplace_back(begin, std::min(end, begin + chunkSize));
+    };
+
+    // Each piece long enough keeps an inner stretch clear of its neighbours; everything between two such stretches
+    // (the ends of both pieces and any short pieces in between) becomes ranges of its own
+    size_t pending = 0;
+    for (size_t i = 0; i < pieces_.size(); i++) {
+        size_t begin = offsets_[i], end = begin + pieces_[i].length;
+        if (end - begin <= 2 * margin + alignment) continue;
+        size_t inner = (begin + margin + alignment - 1) / alignment * alignment;
+        size_t innerEnd = (end - margin) / alignment * alignment;
+        if (innerEnd <= inner) continue;
+        split(pending, inner);
+        split(inner, innerEnd);
+        pending = innerEnd;
+    }
+    split(pending, size_);
+    return ranges;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class PieceSnapshot;
+
+// Copy-on-write edit layer over a read-only byte source.
+// The original bytes are never touched; edits are appended to a separate buffer and the document is described as an
+// ordered list of pieces referencing either buffer, so memory use is proportional to the edits, not the file.
+// The added buffer is a list of fixed-size pages whose filled bytes are never rewritten, so snapshots can share them.
+class PieceTable
+{
+public:
+    enum Source : uint8_t
+    {
+        SourceOriginal,
+        SourceAdded
+    };
+
+    struct Piece
+    {
+        Source source;
+        size_t start;  // offset into the source buffer
+        size_t length;
+    };
+
+    // Added pieces never cross a page boundary
+    static constexpr size_t PageSize = 64 << 10;
+
+    // Discards all edits and history and views `original` as a single unmodified piece.
+    // The caller keeps `original` alive for as long as the table references it; snapshots keep `owner` instead.
+    void reset(const uint8_t *original, size_t size, std::shared_ptr<const void> owner = nullptr);
+
+    size_t size() const { return size_; }
+
+    // O(log pieces); repeated nearby reads hit a cached piece.
+    uint8_t readByte(size_t offset) const;
+
+    // Copies up to `length` bytes starting at `offset`, returns the number of bytes copied.
+    size_t read(size_t offset, uint8_t *out, size_t length) const;
+
+    // Visits the contiguous spans covering [offset, offset + length) without copying them.
+    void forEachSpan(size_t offset, size_t length, const std::function<void(const uint8_t *, size_t)>& fn) const;
+
+    void replace(size_t offset, const uint8_t *bytes, size_t length);
+    void insert(size_t offset, const uint8_t *bytes, size_t length);
+    void erase(size_t offset, size_t length);
+
+    bool canUndo() const { return undoPosition_ > 0; }
+    bool canRedo() const { return undoPosition_ < history_.size(); }
+    bool undo();
+    bool redo();
+
+    bool isModified() const { return undoPosition_ != savedPosition_; }
+
+    // True when every original byte is still at its original offset, so only added pieces need writing to
+    // update the backing file in place.
+    bool isLayoutPreserved() const;
+
+    const std::vector<Piece>& pieces() const { return pieces_; }
+
+    // Logical offset of pieces()[index].
+    size_t pieceOffset(size_t index) const { return offsets_[index]; }
+
+    const uint8_t *pieceData(const Piece& piece) const;
+
+    // Incremented on every change to the logical contents, for callers caching derived data
+    uint64_t revision() const { return revision_; }
+
+    // The contents as they stand, for reading on other threads while editing carries on. Repeated calls at the same
+    // revision share one snapshot while it's held.
+    std::shared_ptr<const PieceSnapshot> snapshot() const;
+
+    // Whether any snapshot is still held, so the original bytes mustn't change underneath a reader
+    bool isSnapshotHeld() const;
+
+private:
+    struct Edit
+    {
+        size_t first;  // index of the first piece touched
+        std::vector<Piece> before;
+        std::vector<Piece> after;
+    };
+
+    size_t findPiece(size_t offset) const;
+    void splice(size_t offset, size_t eraseLength, const uint8_t *bytes, size_t insertLength);
+    void swapPieces(size_t first, const std::vector<Piece>& removed, const std::vector<Piece>& inserted);
+    void rebuildOffsets(size_t from);
+
+    const uint8_t *original_ = nullptr;
+    std::shared_ptr<const void> owner_;
+    std::vector<std::shared_ptr<uint8_t[]>> pages_;
+    size_t addedSize_ = 0;
+    std::vector<Piece> pieces_;
+    std::vector<size_t> offsets_;
+    size_t size_ = 0;
+
+    std::vector<Edit> history_;
+    size_t undoPosition_ = 0;
+    size_t savedPosition_ = 0;
+    uint64_t revision_ = 0;
+
+    mutable size_t cachedPiece_ = 0;
+    mutable std::vector<std::weak_ptr<const PieceSnapshot>> snapshots_;  // latest last
+};
+
+// One revision of a table's contents. Immutable, so any number of threads may read it at once without locking.
+// It holds its own piece list and shares the pages of added bytes and the owner of the original.
+class PieceSnapshot
+{
+public:
+    size_t size() const { return size_; }
+    uint64_t revision() const { return revision_; }
+
+    uint8_t readByte(size_t offset) const;
+    size_t read(size_t offset, uint8_t *out, size_t length) const;
+    void forEachSpan(size_t offset, size_t length, const std::function<void(const uint8_t *, size_t)>& fn) const;
+
+    // [offset, offset + length) in one block: straight from the source when a single piece covers it, otherwise
+    // copied into `scratch`. Clamped to the end of the contents like read.
+    const uint8_t *contiguous(size_t offset, size_t length, std::vector<uint8_t>& scratch) const;
+
+    // Splits the contents into ranges of at most chunkSize bytes, each starting on a multiple of `alignment` (which
+    // chunkSize must be too), for scanning in parallel. Ranges further than `margin` from a piece boundary lie inside
+    // a single piece with `margin` to spare either side, so a scan reading that far around them gets them from
+    // contiguous() without a copy; only the short ranges near edits are stitched together.
+    std::vector<std::pair<size_t, size_t>> scanRanges(size_t chunkSize, size_t alignment, size_t margin) const;
+
+private:
+    friend class PieceTable;
+
+    const uint8_t *pieceData(const PieceTable::Piece& piece) const;
+
+    const uint8_t *original_ = nullptr;
+    std::shared_ptr<const void> owner_;
+    std::vector<std::shared_ptr<uint8_t[]>> pages_;
+    std::vector<PieceTable::Piece> pieces_;
+    std::vector<size_t> offsets_;
+    size_t size_ = 0;
+    uint64_t revision_ = 0;
+};
@@ -0,0 +1,350 @@
+#include "pointer_graph.h"
+#include "piece_table.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define HEXSPANNED_SSE2 1
+#endif
+
+namespace
+{
+    constexpr size_t ChunkWords = 1 << 20;
+
+    // Words a chunk's view reaches past its end, enough for the flags after it and most runs carrying on
+    constexpr size_t MarginWords = 16;
+
+    // Per-word results of the vectorized range checks
+    enum WordFlags : uint8_t
+    {
+        WFTargetLE = 1,  // an aligned 32-bit offset into the file, read little-endian
+        WFTargetBE = 2,
+        WFHighLE = 4,    // small enough to be the high half of a 64-bit offset into the file
+        WFHighBE = 8
+    };
+
+    inline uint32_t swapWord(uint32_t w)
+    {
+        return (w >> 24) | ((w >> 8) & 0x0000FF00u) | ((w << 8) & 0x00FF0000u) | (w << 24);
+    }
+
+    // Reads words through `view`, which holds bytes [viewBegin, viewEnd) of the contents. Anything outside it comes
+    // from `snapshot`; without one, the view has to hold everything.
+    class Scanner
+    {
+    public:
+        Scanner(const uint8_t *view, size_t viewBegin, size_t viewEnd, const PieceSnapshot *snapshot, size_t size,
+                const PointerOptions& options)
+            : view_(view), viewBegin_(viewBegin), viewEnd_(viewEnd), snapshot_(snapshot), size_(size),
+              words_(size / 4), options_(options)
+        {
+            uint64_t limit = std::min<uint64_t>(size, 1ull << 32);
+            low_ = (uint32_t) options.minTarget;
+            span_ = (uint32_t) (limit - options.minTarget);
+            highLimit_ = (uint32_t) (size >> 32);
+            small_ = size <= (1ull << 32);
+        }
+
+        // Flags for words [begin, end), which must lie inside the view, into `flags`, four words at a time where SSE2
+        // is available
+        void computeFlags(size_t begin, size_t end, uint8_t *flags) const
+        {
+            size_t w = begin;
+#ifdef HEXSPANNED_SSE2
+            const __m128i bias = _mm_set1_epi32((int) 0x80000000u);
+            const __m128i low = _mm_set1_epi32((int) low_);
+            const __m128i span = _mm_set1_epi32((int) (span_ ^ 0x80000000u));
+            const __m128i high = _mm_set1_epi32((int) ((highLimit_ + 1) ^ 0x80000000u));
+            const __m128i three = _mm_set1_epi32(3);
+            const __m128i zero = _mm_setzero_si128();
+
+            // Bit j of a 4-bit movemask moved to bit 0 of byte j, so four words' flags are stored at once
+            static constexpr uint32_t spreadBits[16] = {
+                0x00000000, 0x00000001, 0x00000100, 0x00000101, 0x00010000, 0x00010001, 0x00010100, 0x00010101,
+                0x01000000, 0x01000001, 0x01000100, 0x01000101, 0x01010000, 0x01010001, 0x01010100, 0x01010101
+            };
+
+            // SSE2 only compares signed, so unsigned comparisons flip the sign bit of both sides
+            auto inRange = [&](__m128i v) {
+                __m128i below = _mm_cmplt_epi32(_mm_xor_si128(_mm_sub_epi32(v, low), bias), span);
+                __m128i aligned = _mm_cmpeq_epi32(_mm_and_si128(v, three), zero);
+                return _mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(below, aligned)));
+            };
+            auto isHigh = [&](__m128i v) {
+                return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(_mm_xor_si128(v, bias), high)));
+            };
+
+            for (; w + 4 <= end; w += 4) {
+                __m128i le = _mm_loadu_si128((const __m128i *) (view_ + (w * 4 - viewBegin_)));
+                __m128i be = _mm_or_si128(_mm_slli_epi16(le, 8), _mm_srli_epi16(le, 8));
+                be = _mm_shufflehi_epi16(_mm_shufflelo_epi16(be, 0xB1), 0xB1);
+
+                uint32_t packed = spreadBits[inRange(le)] | spreadBits[inRange(be)] << 1 |
+                                  spreadBits[isHigh(le)] << 2 | spreadBits[isHigh(be)] << 3;
+                memcpy(flags + (w - begin), &packed, 4);
+            }
+#endif
+            for (; w < end; w++) flags[w - begin] = wordFlags(w);
+        }
+
+        // Whether the word at `w` starts a pointer of `kind`, reading flags from [flagsBegin, flagsEnd) when inside it
+        bool pointerAt(PointerKind kind, size_t w, const uint8_t *flags, size_t flagsBegin, size_t flagsEnd,
+                       Pointer& pointer) const
+        {
+            auto flagAt = [&](size_t word) {
+                return word >= flagsBegin && word < flagsEnd ? flags[word - flagsBegin] : wordFlags(word);
+            };
+
+            // Below 4 GiB the low half of a 64-bit offset has to pass the 32-bit checks too
+            if (w + (kind >= PK64LE ? 2 : 1) > words_) return false;
+            if ((kind == PK64LE && small_ && !(flagAt(w) & WFTargetLE)) ||
+                (kind == PK64BE && small_ && !(flagAt(w + 1) & WFTargetBE))) {
+                return false;
+            }
+
+            uint64_t target;
+            switch (kind) {
+                case PK32LE:
+                    if (!(flagAt(w) & WFTargetLE)) return false;
+                    target = loadWord(w);
+                    break;
+                case PK32BE:
+                    if (!(flagAt(w) & WFTargetBE)) return false;
+                    target = swapWord(loadWord(w));
+                    break;
+                case PK64LE:
+                    if (!(flagAt(w + 1) & WFHighLE)) return false;
+                    target = (uint64_t) loadWord(w + 1) << 32 | loadWord(w);
+                    break;
+                default:
+                    if (!(flagAt(w) & WFHighBE)) return false;
+                    target = (uint64_t) swapWord(loadWord(w)) << 32 | swapWord(loadWord(w + 1));
+                    break;
+            }
+            if (target < options_.minTarget || target >= size_ || (target & 3)) return false;
+
+            pointer = { (uint64_t) w * 4, target, kind };
+            return true;
+        }
+
+        size_t words() const { return words_; }
+
+        // Offsets into zero fill are far more often coincidence than structure
+        bool hasContent(uint64_t target) const
+        {
+            uint8_t bytes[8] {};
+            size_t length = (size_t) std::min<uint64_t>(8, size_ - target);
+            if (target >= viewBegin_ && target + length <= viewEnd_) {
+                memcpy(bytes, view_ + (target - viewBegin_), length);
+            } else {
+                snapshot_->read(target, bytes, length);
+            }
+            uint64_t value;
+            memcpy(&value, bytes, 8);
+            return value != 0;
+        }
+
+        // Flags a word needs for a pointer of `kind` to start there
+        uint8_t startFlags(PointerKind kind) const
+        {
+            bool littleEndian = kind == PK32LE || kind == PK64LE;
+            uint8_t flags = littleEndian ? WFTargetLE : WFTargetBE;
+            if (kind >= PK64LE && !small_) flags |= littleEndian ? WFHighLE : WFHighBE;
+            return flags;
+        }
+
+    private:
+        uint32_t loadWord(size_t w) const
+        {
+            uint32_t word;
+            size_t offset = w * 4;
+            if (offset >= viewBegin_ && offset + 4 <= viewEnd_) {
+                memcpy(&word, view_ + (offset - viewBegin_), 4);
+            } else {
+                snapshot_->read(offset, (uint8_t *) &word, 4);
+            }
+            return word;
+        }
+
+        uint8_t wordFlags(size_t w) const
+        {
+            uint32_t le = loadWord(w), be = swapWord(le);
+            uint8_t flags = 0;
+            if (le - low_ < span_ && !(le & 3)) flags |= WFTargetLE;
+            if (be - low_ < span_ && !(be & 3)) flags |= WFTargetBE;
+            if (le <= highLimit_) flags |= WFHighLE;
+            if (be <= highLimit_) flags |= WFHighBE;
+            return flags;
+        }
+
+        const uint8_t *view_;
+        size_t viewBegin_;
+        size_t viewEnd_;
+        const PieceSnapshot *snapshot_;
+        size_t size_;
+        size_t words_;
+        const PointerOptions& options_;
+        uint32_t low_;
+        uint32_t span_;
+        uint32_t highLimit_;
+        bool small_;
+    };
+
+    // Reports pointers in runs starting inside [begin, end). Runs may carry on past `end`; a run that started before
+    // `begin` belongs to the previous chunk.
+    void scanChunk(const Scanner& scanner, const PointerOptions& options, size_t begin, size_t end,
+                   std::vector<uint8_t>& flags, std::vector<Pointer>& out)
+    {
+        size_t flagsEnd = std::min(scanner.words(), end + 1);
+        flags.resize(flagsEnd - begin);
+        scanner.computeFlags(begin, flagsEnd, flags.data());
+
+        std::vector<Pointer> run;
+        for (PointerKind kind: { PK32LE, PK32BE, PK64LE, PK64BE }) {
+            size_t step = kind >= PK64LE ? 2 : 1;
+            size_t w = (begin + step - 1) / step * step;
+            uint64_t skipMask = scanner.startFlags(kind) * 0x0101010101010101ull;
+            Pointer pointer;
+
+            if (w >= step && scanner.pointerAt(kind, w - step, flags.data(), begin, flagsEnd, pointer)) {
+                while (scanner.pointerAt(kind, w, flags.data(), begin, flagsEnd, pointer)) w += step;
+            }
+
+            while (w < end) {
+                // Nothing in the next eight words can start a pointer of this kind
+                if (w + 9 <= flagsEnd) {
+                    uint64_t next8;
+                    memcpy(&next8, flags.data() + (w - begin), 8);
+                    if ((next8 & skipMask) == 0) {
+                        w += 8;
+                        continue;
+                    }
+                }
+
+                run.clear();
+                while (scanner.pointerAt(kind, w, flags.data(), begin, flagsEnd, pointer)) {
+                    run.push_back(pointer);
+                    w += step;
+                }
+                if (run.empty()) w += step;
+
+                // Checked last, as it's the one test that reads far from the pointer
+                bool table = run.size() >= options.minTableRun;
+                for (const Pointer& p: run) {
+                    if ((table || p.target < options.isolatedLimit) && scanner.hasContent(p.target)) out.push_back(p);
+                }
+            }
+        }
+
+        std::sort(out.begin(), out.end(), [](const Pointer& a, const Pointer& b) {
+            return a.source != b.source ? a.source < b.source : a.kind < b.kind;
+        });
+    }
+
+    // Scans `ranges` of words across the worker pool, fetching the bytes around each with viewOf(viewBegin, viewEnd,
+    // scratch). Without a snapshot to fall back on, every view covers the whole contents.
+    template<class ViewOf>
+    bool scanRanges(const std::vector<std::pair<size_t, size_t>>& ranges, size_t size, ViewOf viewOf,
+                    const PieceSnapshot *snapshot, PointerGraph& graph, const PointerOptions& options,
+                    std::atomic<float> *progress, const std::atomic<bool> *cancel)
+    {
+        std::vector<std::vector<Pointer>> found(ranges.size());
+        std::atomic<size_t> chunksDone = 0;
+
+        workerPool().parallelFor(ranges.size(), 1, [&](size_t first, size_t last) {
+            std::vector<uint8_t> flags, bytes;
+            for (size_t chunk = first; chunk < last; chunk++) {
+                if (cancel && cancel->load(std::memory_order_relaxed)) return;
+                auto [begin, end] = ranges[chunk];
+
+                // From the two words a run reaching `begin` would start at, to the margin past `end`
+                size_t viewBegin = snapshot ? (begin - std::min<size_t>(begin, 2)) * 4 : 0;
+                size_t viewEnd = snapshot ? std::min<size_t>(size, (end + MarginWords) * 4) : size;
+                Scanner scanner(viewOf(viewBegin, viewEnd, bytes), viewBegin, viewEnd, snapshot, size, options);
+                scanChunk(scanner, options, begin, end, flags, found[chunk]);
+                if (progress) {
+                    progress->store(0.9f * (float) ++chunksDone / (float) ranges.size(), std::memory_order_relaxed);
+                }
+            }
+        });
+        if (cancel && cancel->load()) return false;
+
+        for (auto& chunk: found) {
+            size_t take = std::min(chunk.size(), options.maxPointers - graph.pointers.size());
+            graph.pointers.insert(graph.pointers.end(), chunk.begin(), chunk.begin() + (ptrdiff_t) take);
+            graph.truncated |= take < chunk.size();
+            std::vector<Pointer>().swap(chunk);
+        }
+
+        graph.byTarget.resize(graph.pointers.size());
+        std::iota(graph.byTarget.begin(), graph.byTarget.end(), 0u);
+        std::sort(graph.byTarget.begin(), graph.byTarget.end(), [&](uint32_t a, uint32_t b) {
+            const Pointer& pa = graph.pointers[a];
+            const Pointer& pb = graph.pointers[b];
+            return pa.target != pb.target ? pa.target < pb.target : pa.source < pb.source;
+        });
+        if (progress) progress->store(1.0f, std::memory_order_relaxed);
+        return true;
+    }
+}
+
+bool buildPointerGraph(const uint8_t *data, size_t size, PointerGraph& graph, const PointerOptions& options,
+                       std::atomic<float> *progress, const std::atomic<bool> *cancel)
+{
+    graph = PointerGraph();
+    if (size < 8 || options.minTarget >= std::min<uint64_t>(size, 1ull << 32)) return true;
+
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t begin = 0; begin < size / 4; begin += ChunkWords) {
+        ranges.emplace_back(begin, std::min(size / 4, begin + ChunkWords));
+    }
+    auto viewOf = [data](size_t viewBegin, size_t, std::vector<uint8_t>&) { return data + viewBegin; };
+    return scanRanges(ranges, size, viewOf, nullptr, graph, options, progress, cancel);
+}
+
+bool buildPointerGraph(const PieceSnapshot& snapshot, PointerGraph& graph, const PointerOptions& options,
+                       std::atomic<float> *progress, const std::atomic<bool> *cancel)
+{
+    graph = PointerGraph();
+    size_t size = snapshot.size();
+    if (size < 8 || options.minTarget >= std::min<uint64_t>(size, 1ull << 32)) return true;
+
+    // Ranges start 8-byte aligned so 64-bit words line up; only those near an edit are stitched together
+    std::vector<std::pair<size_t, size_t>> ranges = snapshot.scanRanges(ChunkWords * 4, 8, MarginWords * 4);
+    for (auto& [begin, end]: ranges) {
+        begin /= 4;
+        end /= 4;
+    }
+    auto viewOf = [&snapshot](size_t viewBegin, size_t viewEnd, std::vector<uint8_t>& scratch) {
+        return snapshot.contiguous(viewBegin, viewEnd - viewBegin, scratch);
+    };
+    return scanRanges(ranges, size, viewOf, &snapshot, graph, options, progress, cancel);
+}
+
+void findPointersAt(const PointerGraph& graph, uint64_t offset, std::vector<Pointer>& out)
+{
+    out.clear();
+
+    // A pointer covering `offset` starts at most 7 bytes before it
+    uint64_t from = offset >= 7 ? offset - 7 : 0;
+    auto it = std::lower_bound(graph.pointers.begin(), graph.pointers.end(), from,
+                               [](const Pointer& p, uint64_t source) { return p.source < source; });
+    for (; it != graph.pointers.end() && it->source <= offset; ++it) {
+        if (offset < it->source + it->width()) out.push_back(*it);
+    }
+}
+
+void findReferencesTo(const PointerGraph& graph, uint64_t begin, uint64_t end, std::vector<Pointer>& out,
+                      size_t maxResults)
+{
+    out.clear();
+    auto it = std::lower_bound(graph.byTarget.begin(), graph.byTarget.end(), begin,
+                               [&](uint32_t index, uint64_t target) { return graph.pointers[index].target < target; });
+    for (; it != graph.byTarget.end() && graph.pointers[*it].target < end && out.size() < maxResults; ++it) {
+        out.push_back(graph.pointers[*it]);
+    }
+}
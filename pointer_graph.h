@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class PieceSnapshot;
+
+enum PointerKind : uint8_t
+{
+    PK32LE,
+    PK32BE,
+    PK64LE,
+    PK64BE
+};
+
+// An aligned integer somewhere in the file whose value reads as an offset into it
+struct Pointer
+{
+    uint64_t source;
+    uint64_t target;
+    PointerKind kind;
+
+    uint32_t width() const { return kind >= PK64LE ? 8 : 4; }
+};
+
+struct PointerOptions
+{
+    uint64_t minTarget = 64;              // smaller values are nearly always counts and flags
+    uint32_t minTableRun = 3;             // consecutive pointers that make an offset table
+    uint64_t isolatedLimit = 16 << 20;    // pointers outside a table must point below this
+    size_t maxPointers = 1 << 22;
+};
+
+// Every pointer found, sorted by source, and the same pointers indexed by target for "who points here"
+struct PointerGraph
+{
+    std::vector<Pointer> pointers;
+    std::vector<uint32_t> byTarget;  // indices into pointers, ordered by target
+    bool truncated = false;          // more than maxPointers were found; the earliest in the file are kept
+};
+
+// Treats every 4-byte-aligned 32-bit and 8-byte-aligned 64-bit integer, in both byte orders, as a possible file
+// offset. Values are kept when they land 4-byte aligned inside the file at or past minTarget, on bytes that aren't all
+// zero, and either sit in a run of at least minTableRun such values or point below isolatedLimit, since lone random
+// words rarely do. Range checks run four words at a time with SSE2 where available, across the worker pool.
+// Returns false if `cancel` was raised.
+bool buildPointerGraph(const uint8_t *data, size_t size, PointerGraph& graph,
+                       const PointerOptions& options = PointerOptions(), std::atomic<float> *progress = nullptr,
+                       const std::atomic<bool> *cancel = nullptr);
+
+// The same over a snapshot of an edited document, read piece by piece; only the bytes around edits are copied
+bool buildPointerGraph(const PieceSnapshot& snapshot, PointerGraph& graph,
+                       const PointerOptions& options = PointerOptions(), std::atomic<float> *progress = nullptr,
+                       const std::atomic<bool> *cancel = nullptr);
+
+// Pointers whose bytes cover `offset`; at most one per kind
+void findPointersAt(const PointerGraph& graph, uint64_t offset, std::vector<Pointer>& out);
+
+// Pointers targeting [begin, end), in target order
+void findReferencesTo(const PointerGraph& graph, uint64_t begin, uint64_t end, std::vector<Pointer>& out,
+                      size_t maxResults = SIZE_MAX);
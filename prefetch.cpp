@@ -0,0 +1,88 @@
+#include "prefetch.h"
+
+#include <algorithm>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint64_t Step = 32 << 20;
+
+    bool cancelled(const std::atomic<bool> *cancel)
+    {
+        return cancel && cancel->load(std::memory_order_relaxed);
+    }
+}
+
+#ifdef _WIN32
+
+// No readahead hint to give here, so the file is read through once with the cache told to expect exactly that
+uint64_t prefetchFile(const std::string& path, uint64_t length, const std::atomic<bool> *cancel)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return 0;
+
+    std::vector<uint8_t> block(1 << 20);
+    uint64_t done = 0;
+    while (done < length && !cancelled(cancel)) {
+        DWORD read = 0;
+        DWORD wanted = (DWORD) std::min<uint64_t>(block.size(), length - done);
+        if (!ReadFile(file, block.data(), wanted, &read, nullptr) || read == 0) break;
+        done += read;
+    }
+    CloseHandle(file);
+    return done;
+}
+
+#else
+
+uint64_t prefetchFile(const std::string& path, uint64_t length, const std::atomic<bool> *cancel)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return 0;
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return 0;
+    }
+    length = std::min<uint64_t>(length, (uint64_t) st.st_size);
+
+    uint64_t done = 0;
+    while (done < length && !cancelled(cancel)) {
+        uint64_t count = std::min(Step, length - done);
+#ifdef __APPLE__
+        radvisory advice {};
+        advice.ra_offset = (off_t) done;
+        advice.ra_count = (int) count;
+        if (fcntl(fd, F_RDADVISE, &advice) != 0) break;
+#else
+        if (posix_fadvise(fd, (off_t) done, (off_t) count, POSIX_FADV_WILLNEED) != 0) break;
+#endif
+        done += count;
+    }
+    ::close(fd);
+    return done;
+}
+
+#endif
+
+void prefetchFiles(const std::vector<std::string>& paths, uint64_t maxBytes, const std::atomic<bool> *cancel)
+{
+    uint64_t total = 0;
+    for (const std::string& path: paths) {
+        if (total >= maxBytes || cancelled(cancel)) return;
+        total += prefetchFile(path, maxBytes - total, cancel);
+    }
+}
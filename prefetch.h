@@ -0,0 +1,14 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Asks the OS to start reading up to `length` bytes of `path` into the page cache and returns without waiting for
+// them, in steps small enough that `cancel` is noticed promptly. Returns how many bytes were hinted; missing files
+// are skipped quietly, since recent-file lists go stale.
+uint64_t prefetchFile(const std::string& path, uint64_t length, const std::atomic<bool> *cancel = nullptr);
+
+// Prefetches each of `paths` in order until `maxBytes` have been hinted in total
+void prefetchFiles(const std::vector<std::string>& paths, uint64_t maxBytes, const std::atomic<bool> *cancel = nullptr);
@@ -0,0 +1,259 @@
+#include "session_cache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+    constexpr char Magic[4] = { 'H', 'X', 'S', 'C' };
+    constexpr uint32_t Version = 2;
+
+    // Little-endian, fixed-width encoding. Sessions are small apart from the per-block arrays, which are written raw.
+    struct BinaryWriter
+    {
+        std::vector<uint8_t> bytes;
+
+        template<class T>
+        void put(T value)
+        {
+            uint8_t raw[sizeof(T)];
+            memcpy(raw, &value, sizeof(T));
+            bytes.insert(bytes.end(), raw, raw + sizeof(T));
+        }
+
+        void putBytes(const void *data, size_t size)
+        {
+            bytes.insert(bytes.end(), (const uint8_t *) data, (const uint8_t *) data + size);
+        }
+    };
+
+    struct BinaryReader
+    {
+        const std::vector<uint8_t>& bytes;
+        size_t position = 0;
+        bool ok = true;
+
+        template<class T>
+        T get()
+        {
+            T value {};
+            getBytes(&value, sizeof(T));
+            return value;
+        }
+
+        void getBytes(void *out, size_t size)
+        {
+            if (!ok || bytes.size() - position < size) {
+                ok = false;
+                return;
+            }
+            memcpy(out, bytes.data() + position, size);
+            position += size;
+        }
+
+        // Guards counts read from disk before they size an allocation
+        bool fits(uint64_t count, size_t elementSize) const
+        {
+            return ok && count <= (bytes.size() - position) / elementSize;
+        }
+    };
+
+    void putVisParams(BinaryWriter& w, const VisParams& p)
+    {
+        w.put<int64_t>((int64_t) p.vertexBufferStart);
+        w.put<int64_t>((int64_t) p.indexBufferStart);
+        w.put<int64_t>((int64_t) p.vertexCount);
+        w.put<int64_t>(p.vertexStride);
+        w.put<uint8_t>((p.bigEndian ? 1 : 0) | (p.backfaceCulling ? 2 : 0) | (p.indexedDraw ? 4 : 0) |
+                       (p.halfWidthIndexes ? 8 : 0) | (p.halfTexCoords ? 16 : 0));
+        w.put<float>(p.viewDistance);
+        w.put<uint8_t>((uint8_t) p.polygonMode);
+        w.put<uint8_t>((uint8_t) p.meshType);
+        w.put<int32_t>(p.normalOffset);
+        w.put<int32_t>(p.texCoordOffset);
+        w.put<int32_t>(p.colorOffset);
+    }
+
+    VisParams getVisParams(BinaryReader& r)
+    {
+        VisParams p;
+        p.vertexBufferStart = (uint64_t) r.get<int64_t>();
+        p.indexBufferStart = (uint64_t) r.get<int64_t>();
+        p.vertexCount = (uint64_t) r.get<int64_t>();
+        p.vertexStride = (uint32_t) r.get<int64_t>();
+        auto flags = r.get<uint8_t>();
+        p.bigEndian = flags & 1;
+        p.backfaceCulling = flags & 2;
+        p.indexedDraw = flags & 4;
+        p.halfWidthIndexes = flags & 8;
+        p.halfTexCoords = flags & 16;
+        p.viewDistance = r.get<float>();
+        auto polygonMode = r.get<uint8_t>();
+        auto meshType = r.get<uint8_t>();
+        p.polygonMode = polygonMode <= PMPoint ? (PolygonMode) polygonMode : PMFill;
+        p.meshType = meshType <= MTPoint ? (MeshType) meshType : MTTriangle;
+        p.normalOffset = r.get<int32_t>();
+        p.texCoordOffset = r.get<int32_t>();
+        p.colorOffset = r.get<int32_t>();
+        return p;
+    }
+
+    bool fileStamp(const std::string& path, uint64_t& size, int64_t& mtime)
+    {
+        std::error_code ec;
+        size = std::filesystem::file_size(path, ec);
+        if (ec) return false;
+        mtime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+        return !ec;
+    }
+}
+
+SessionCache::SessionCache(std::filesystem::path directory)
+    : directory_(std::move(directory)), index_(nlohmann::json::object())
+{
+    std::ifstream in(directory_ / "index.json");
+    if (in.is_open()) {
+        index_ = nlohmann::json::parse(in, nullptr, false);
+        if (!index_.is_object()) index_ = nlohmann::json::object();
+    }
+}
+
+bool SessionCache::lookupHash(const std::string& path, uint64_t& hash) const
+{
+    auto it = index_.find(path);
+    if (it == index_.end()) return false;
+
+    uint64_t size;
+    int64_t mtime;
+    if (!fileStamp(path, size, mtime)) return false;
+    if ((*it).value("size", (uint64_t) -1) != size || (*it).value("mtime", (int64_t) 0) != mtime) return false;
+
+    hash = (*it).value("hash", (uint64_t) 0);
+    return true;
+}
+
+void SessionCache::rememberHash(const std::string& path, uint64_t hash)
+{
+    uint64_t size;
+    int64_t mtime;
+    if (!fileStamp(path, size, mtime)) return;
+
+    index_[path] = { { "size", size }, { "mtime", mtime }, { "hash", hash } };
+    saveIndex();
+}
+
+bool SessionCache::load(uint64_t hash, FileSession& session) const
+{
+    std::ifstream in(sessionPath(hash), std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return false;
+
+    std::vector<uint8_t> bytes((size_t) in.tellg());
+    in.seekg(0, std::ios::beg);
+    in.read((char *) bytes.data(), (std::streamsize) bytes.size());
+    if (!in) return false;
+
+    BinaryReader r { bytes };
+    char magic[4];
+    r.getBytes(magic, 4);
+    if (!r.ok || memcmp(magic, Magic, 4) != 0 || r.get<uint32_t>() != Version) return false;
+    if (r.get<uint64_t>() != hash) return false;
+
+    FileSession loaded;
+    loaded.visParams = getVisParams(r);
+    loaded.hexViewAddress = r.get<uint64_t>();
+
+    auto candidateCount = r.get<uint32_t>();
+    if (!r.fits(candidateCount, 1)) return false;
+    for (uint32_t i = 0; i < candidateCount && r.ok; i++) {
+        loaded.candidates.push_back(getVisParams(r));
+    }
+
+    auto annotationCount = r.get<uint32_t>();
+    if (!r.fits(annotationCount, 1)) return false;
+    for (uint32_t i = 0; i < annotationCount && r.ok; i++) {
+        Annotation annotation;
+        annotation.offset = r.get<uint64_t>();
+        annotation.length = r.get<uint64_t>();
+        auto textLength = r.get<uint32_t>();
+        if (!r.fits(textLength, 1)) return false;
+        annotation.text.resize(textLength);
+        r.getBytes(annotation.text.data(), textLength);
+        loaded.annotations.push_back(std::move(annotation));
+    }
+
+    ContentDigest& digest = loaded.digest;
+    digest.hash = hash;
+    digest.size = r.get<uint64_t>();
+    digest.blockSize = r.get<uint32_t>();
+    auto blockCount = r.get<uint64_t>();
+    if (!r.fits(blockCount, sizeof(uint64_t) + 1)) return false;
+    digest.blockHashes.resize(blockCount);
+    digest.blockEntropy.resize(blockCount);
+    r.getBytes(digest.blockHashes.data(), blockCount * sizeof(uint64_t));
+    r.getBytes(digest.blockEntropy.data(), blockCount);
+
+    if (!r.ok) return false;
+    session = std::move(loaded);
+    return true;
+}
+
+bool SessionCache::store(uint64_t hash, const FileSession& session)
+{
+    BinaryWriter w;
+    w.putBytes(Magic, 4);
+    w.put<uint32_t>(Version);
+    w.put<uint64_t>(hash);
+
+    putVisParams(w, session.visParams);
+    w.put<uint64_t>(session.hexViewAddress);
+
+    w.put<uint32_t>((uint32_t) session.candidates.size());
+    for (const auto& candidate: session.candidates) {
+        putVisParams(w, candidate);
+    }
+
+    w.put<uint32_t>((uint32_t) session.annotations.size());
+    for (const auto& annotation: session.annotations) {
+        w.put<uint64_t>(annotation.offset);
+        w.put<uint64_t>(annotation.length);
+        w.put<uint32_t>((uint32_t) annotation.text.size());
+        w.putBytes(annotation.text.data(), annotation.text.size());
+    }
+
+    const ContentDigest& digest = session.digest;
+    w.put<uint64_t>(digest.size);
+    w.put<uint32_t>(digest.blockSize);
+    w.put<uint64_t>(digest.blockHashes.size());
+    w.putBytes(digest.blockHashes.data(), digest.blockHashes.size() * sizeof(uint64_t));
+    w.putBytes(digest.blockEntropy.data(), digest.blockEntropy.size());
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+
+    std::ofstream out(sessionPath(hash), std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Error writing session cache: " << sessionPath(hash).string() << std::endl;
+        return false;
+    }
+    out.write((const char *) w.bytes.data(), (std::streamsize) w.bytes.size());
+    return (bool) out;
+}
+
+std::filesystem::path SessionCache::sessionPath(uint64_t hash) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.hxs", (unsigned long long) hash);
+    return directory_ / name;
+}
+
+void SessionCache::saveIndex() const
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+
+    std::ofstream out(directory_ / "index.json");
+    if (out.is_open()) {
+        out << index_;
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "content_hash.h"
+#include "vis_params.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+struct Annotation
+{
+    uint64_t offset = 0;
+    uint64_t length = 1;
+    std::string text;
+};
+
+// Everything worth restoring when a file is reopened
+struct FileSession
+{
+    VisParams visParams;
+    uint64_t hexViewAddress = 0;
+    std::vector<VisParams> candidates;
+    std::vector<Annotation> annotations;
+    ContentDigest digest;  // block hashes and minimap statistics, so reopening skips the scan
+};
+
+// Sidecar store of per-file sessions, keyed by content hash so renamed or copied files still hit.
+// A path index remembers each file's size and modification time, letting an unchanged file skip hashing entirely.
+class SessionCache
+{
+public:
+    explicit SessionCache(std::filesystem::path directory);
+
+    // Content hash recorded for `path`, if its size and modification time still match
+    bool lookupHash(const std::string& path, uint64_t& hash) const;
+    void rememberHash(const std::string& path, uint64_t hash);
+
+    bool load(uint64_t hash, FileSession& session) const;
+    bool store(uint64_t hash, const FileSession& session);
+
+    // Where the session for `hash` lives, whether or not it has been stored yet
+    std::filesystem::path sessionPath(uint64_t hash) const;
+
+private:
+    void saveIndex() const;
+
+    std::filesystem::path directory_;
+    nlohmann::json index_;
+};
@@ -0,0 +1,141 @@
+#include "shader.h"
+#include "startup_trace.h"
+
+#include <glad/glad.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+    uint64_t hashText(uint64_t hash, const char *text)
+    {
+        // FNV-1a; the strings are short and this only has to tell them apart
+        for (const char *p = text ? text : ""; *p; p++) {
+            hash = (hash ^ (uint8_t) *p) * 0x100000001b3ull;
+        }
+        return (hash ^ 0xFF) * 0x100000001b3ull;
+    }
+
+    // Compiles both stages into `program` and links it. Returns false, having logged why, if linking fails.
+    bool linkStages(unsigned program, const char *vertexSource, const char *fragmentSource)
+    {
+        unsigned vertexShader = compileShader(vertexSource, GL_VERTEX_SHADER);
+        unsigned fragmentShader = compileShader(fragmentSource, GL_FRAGMENT_SHADER);
+
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glLinkProgram(program);
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        startupTrace().mark("link program");
+
+        int status;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (!status) {
+            std::cerr << "Error linking shader program" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool loadProgramBinary(unsigned program, const std::filesystem::path& path)
+    {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in.is_open() || in.tellg() <= (std::streamoff) sizeof(uint32_t)) return false;
+
+        std::vector<char> bytes((size_t) in.tellg());
+        in.seekg(0, std::ios::beg);
+        in.read(bytes.data(), (std::streamsize) bytes.size());
+        if (!in) return false;
+
+        uint32_t format = 0;
+        for (int b = 0; b < 4; b++) format |= (uint32_t) (uint8_t) bytes[b] << (b * 8);
+        glProgramBinary(program, format, bytes.data() + 4, (int) (bytes.size() - 4));
+
+        int status;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        return status;
+    }
+
+    void storeProgramBinary(unsigned program, const std::filesystem::path& path)
+    {
+        int length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return;
+
+        std::vector<char> bytes(4 + (size_t) length);
+        unsigned format = 0;
+        glGetProgramBinary(program, length, &length, &format, bytes.data() + 4);
+        for (int b = 0; b < 4; b++) bytes[b] = (char) (format >> (b * 8));
+
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        if (!out.is_open()) return;
+        out.write(bytes.data(), 4 + length);
+    }
+}
+
+unsigned compileShader(const char *source, unsigned type)
+{
+    unsigned shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    int status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (!status) {
+        std::cerr << "Error compiling shader: " << (type == GL_VERTEX_SHADER ? "Vertex" : "Fragment") << std::endl;
+    }
+
+    startupTrace().mark(type == GL_VERTEX_SHADER ? "compile vertex shader" : "compile fragment shader");
+    return shader;
+}
+
+unsigned linkProgram(const char *vertexSource, const char *fragmentSource)
+{
+    unsigned program = glCreateProgram();
+    if (!linkStages(program, vertexSource, fragmentSource)) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+unsigned linkCachedProgram(const char *vertexSource, const char *fragmentSource,
+                           const std::filesystem::path& cacheDirectory)
+{
+    // Program binaries are core in 4.1; on a 3.3 context they depend on the extension and at least one format
+    int formats = 0;
+    if (GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats == 0) return linkProgram(vertexSource, fragmentSource);
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (GLenum name: { GL_VENDOR, GL_RENDERER, GL_VERSION }) hash = hashText(hash, (const char *) glGetString(name));
+    hash = hashText(hashText(hash, vertexSource), fragmentSource);
+    char name[32];
+    snprintf(name, sizeof(name), "program-%016llx.bin", (unsigned long long) hash);
+    std::filesystem::path path = cacheDirectory / name;
+
+    unsigned program = glCreateProgram();
+    if (loadProgramBinary(program, path)) {
+        startupTrace().mark("load cached program");
+        return program;
+    }
+
+    // A failed glProgramBinary leaves the program unlinked, so start from a fresh one
+    glDeleteProgram(program);
+    program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    if (!linkStages(program, vertexSource, fragmentSource)) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    storeProgramBinary(program, path);
+    return program;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <filesystem>
+
+// Compiles a shader stage, logging to std::cerr on failure. Returns the shader either way, like glCreateShader.
+unsigned compileShader(const char *source, unsigned type);
+
+// Compiles and links a vertex/fragment pair, deleting the stages once linked. Returns 0 if linking fails.
+unsigned linkProgram(const char *vertexSource, const char *fragmentSource);
+
+// linkProgram, but reusing the driver's binary from an earlier run when `cacheDirectory` has one. Binaries are keyed
+// by the sources and the GL vendor, renderer and version; one the driver rejects is simply linked again from source.
+unsigned linkCachedProgram(const char *vertexSource, const char *fragmentSource,
+                           const std::filesystem::path& cacheDirectory);
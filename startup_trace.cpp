@@ -0,0 +1,41 @@
+#include "startup_trace.h"
+
+#include <cstdio>
+
+namespace
+{
+    // Constructed before main(), so the first phase includes loading and static initialization
+    StartupTrace trace;
+
+    double milliseconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+}
+
+void StartupTrace::mark(const char *phase)
+{
+    if (enabled_) marks_.push_back({ phase, std::chrono::steady_clock::now() });
+}
+
+void StartupTrace::report(std::ostream& out)
+{
+    if (!enabled_) return;
+
+    auto previous = start_;
+    char line[128];
+    for (const Mark& mark: marks_) {
+        snprintf(line, sizeof(line), "%-28s %9.2f ms\n", mark.phase.c_str(), milliseconds(mark.time - previous));
+        out << line;
+        previous = mark.time;
+    }
+    snprintf(line, sizeof(line), "%-28s %9.2f ms\n", "total", milliseconds(previous - start_));
+    out << line;
+    enabled_ = false;
+    marks_.clear();
+}
+
+StartupTrace& startupTrace()
+{
+    return trace;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Wall-clock time of each startup phase up to the first frame, for --startup-trace. Phases are marked as they
+// finish, so each one covers the time since the mark before it.
+class StartupTrace
+{
+public:
+    void enable() { enabled_ = true; }
+    bool enabled() const { return enabled_; }
+
+    // A no-op unless enabled, and once the report has been written
+    void mark(const char *phase);
+
+    // Writes every phase and the total, then stops recording
+    void report(std::ostream& out);
+
+private:
+    struct Mark
+    {
+        std::string phase;
+        std::chrono::steady_clock::time_point time;
+    };
+
+    bool enabled_ = false;
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+    std::vector<Mark> marks_;
+};
+
+// The process-wide trace, started during static initialization
+StartupTrace& startupTrace();
@@ -0,0 +1,330 @@
+#include "string_index.h"
+#include "piece_table.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define HEXSPANNED_SSE2 1
+#endif
+
+namespace
+{
+    constexpr size_t ChunkSize = 4 << 20;
+
+    // Strings are followed this far past the end of their chunk before being split
+    constexpr size_t Overlap = 64 << 10;
+
+    inline bool isPrintable(uint8_t b)
+    {
+        return (b >= 0x20 && b < 0x7F) || b == '\t';
+    }
+
+    // Bit i of printable[k] / zero[k] describes byte 64 * k + i of the span
+    void classifyBytes(const uint8_t *data, size_t length, std::vector<uint64_t>& printable,
+                       std::vector<uint64_t>& zero)
+    {
+        size_t blocks = (length + 63) / 64;
+        printable.assign(blocks, 0);
+        zero.assign(blocks, 0);
+
+        size_t i = 0;
+#ifdef HEXSPANNED_SSE2
+        const __m128i space = _mm_set1_epi8(0x1F), del = _mm_set1_epi8(0x7F), tab = _mm_set1_epi8('\t');
+        const __m128i nul = _mm_setzero_si128();
+        for (; i + 64 <= length; i += 64) {
+            uint64_t p = 0, z = 0;
+            for (int part = 0; part < 4; part++) {
+                __m128i v = _mm_loadu_si128((const __m128i *) (data + i + part * 16));
+
+                // Bytes from 0x80 up compare negative, so a signed range test also rules them out
+                __m128i text = _mm_and_si128(_mm_cmpgt_epi8(v, space), _mm_cmplt_epi8(v, del));
+                text = _mm_or_si128(text, _mm_cmpeq_epi8(v, tab));
+                p |= (uint64_t) (uint16_t) _mm_movemask_epi8(text) << (part * 16);
+                z |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_cmpeq_epi8(v, nul)) << (part * 16);
+            }
+            printable[i / 64] = p;
+            zero[i / 64] = z;
+        }
+#endif
+        for (; i < length; i++) {
+            printable[i / 64] |= (uint64_t) isPrintable(data[i]) << (i % 64);
+            zero[i / 64] |= (uint64_t) (data[i] == 0) << (i % 64);
+        }
+    }
+
+    // Keeps the even bits of `x`, packed into the low 32
+    inline uint64_t compactEvenBits(uint64_t x)
+    {
+        x &= 0x5555555555555555ull;
+        x = (x | x >> 1) & 0x3333333333333333ull;
+        x = (x | x >> 2) & 0x0F0F0F0F0F0F0F0Full;
+        x = (x | x >> 4) & 0x00FF00FF00FF00FFull;
+        x = (x | x >> 8) & 0x0000FFFF0000FFFFull;
+        x = (x | x >> 16) & 0x00000000FFFFFFFFull;
+        return x;
+    }
+
+    // Sets bit i of `starts` where bits i to i + length - 1 of `words` are all set. Doubling the run length each pass
+    // keeps this to log2(length) sweeps.
+    void markRunsOf(const std::vector<uint64_t>& words, uint32_t length, std::vector<uint64_t>& starts)
+    {
+        starts = words;
+        size_t count = starts.size();
+        for (uint32_t have = 1; have < length;) {
+            uint32_t step = std::min(have, length - have);
+            size_t wordShift = step / 64, bitShift = step % 64;
+            for (size_t k = 0; k < count; k++) {
+                uint64_t low = k + wordShift < count ? starts[k + wordShift] : 0;
+                uint64_t high = k + wordShift + 1 < count ? starts[k + wordShift + 1] : 0;
+                uint64_t shifted = bitShift ? (low >> bitShift | high << (64 - bitShift)) : low;
+                starts[k] &= shifted;
+            }
+            have += step;
+        }
+    }
+
+    // Calls found(start, length) for every run of set bits in a stream of `bits` bits that has a bit set in `starts`.
+    // Runs too short to matter never cost more than the words they sit in.
+    template<class F>
+    void forEachRun(const std::vector<uint64_t>& words, const std::vector<uint64_t>& starts, size_t bits, F&& found)
+    {
+        size_t position = 0;
+        while (position < bits) {
+            size_t word = position / 64;
+            uint64_t rest = starts[word] >> (position % 64);
+            if (rest == 0) {
+                position = (word + 1) * 64;
+                continue;
+            }
+            position += (size_t) std::countr_zero(rest);
+            if (position >= bits) break;
+
+            // The first start past the previous run is where a long enough run begins; follow it to its end
+            size_t start = position;
+            while (position < bits) {
+                uint64_t clear = ~words[position / 64] >> (position % 64);
+                if (clear != 0) {
+                    position += (size_t) std::countr_zero(clear);
+                    break;
+                }
+                position = (position / 64 + 1) * 64;
+            }
+            position = std::min(position, bits);
+            found(start, position - start);
+        }
+    }
+
+    // Per-thread bit masks over one chunk, reused from chunk to chunk
+    struct ScanScratch
+    {
+        std::vector<uint8_t> bytes;  // the chunk, when it had to be stitched together from several pieces
+        std::vector<uint64_t> printable;
+        std::vector<uint64_t> zero;
+        std::vector<uint64_t> units;
+        std::vector<uint64_t> starts;
+    };
+
+    struct ChunkStrings
+    {
+        std::vector<FoundString> strings;
+        std::string pool;
+    };
+
+    // Strings starting in [begin, end). `view` holds [viewBegin, viewEnd), which reaches two bytes before `begin` where
+    // there are any, and Overlap past `end`.
+    void scanChunk(const uint8_t *view, size_t viewBegin, size_t viewEnd, size_t begin, size_t end,
+                   const StringOptions& options, ScanScratch& scratch, ChunkStrings& out)
+    {
+        const uint8_t *span = view + (begin - viewBegin);
+        size_t length = viewEnd - begin;
+        std::vector<uint64_t>& printable = scratch.printable;
+        std::vector<uint64_t>& zero = scratch.zero;
+        std::vector<uint64_t>& units = scratch.units;
+        classifyBytes(span, length, printable, zero);
+
+        auto emit = [&](uint64_t offset, size_t characters, StringEncoding encoding, size_t unitBytes, size_t lowByte) {
+            FoundString found;
+            found.offset = offset;
+            found.length = (uint32_t) characters;
+            found.textLength = std::min<uint32_t>(found.length, StringIndex::MaxStoredLength);
+            found.text = out.pool.size();
+            found.encoding = encoding;
+            for (uint32_t c = 0; c < found.textLength; c++) {
+                uint8_t b = view[offset - viewBegin + (uint64_t) c * unitBytes + lowByte];
+                out.pool.push_back(b == '\t' ? ' ' : (char) b);
+            }
+            out.strings.push_back(found);
+        };
+
+        if (options.ascii) {
+            // A run already going at the chunk start belongs to the previous chunk
+            markRunsOf(printable, options.minLength, scratch.starts);
+            forEachRun(printable, scratch.starts, length, [&](size_t start, size_t run) {
+                if (begin + start >= end) return;
+                if (start == 0 && begin > 0 && isPrintable(view[begin - 1 - viewBegin])) return;
+                emit(begin + start, run, SEAscii, 1, 0);
+            });
+        }
+
+        // UTF-16 code units at even file offsets: a printable byte beside a zero, in either order
+        size_t unitCount = length / 2;
+        units.assign((unitCount + 63) / 64, 0);
+        for (bool bigEndian: { false, true }) {
+            if (!(bigEndian ? options.utf16BE : options.utf16LE)) continue;
+
+            for (size_t k = 0; k < printable.size(); k++) {
+                uint64_t p = printable[k], z = zero[k];
+                uint64_t nextP = k + 1 < printable.size() ? printable[k + 1] : 0;
+                uint64_t nextZ = k + 1 < zero.size() ? zero[k + 1] : 0;
+                uint64_t high = bigEndian ? (p >> 1 | nextP << 63) : (z >> 1 | nextZ << 63);
+                uint64_t low = bigEndian ? z : p;
+                uint64_t packed = compactEvenBits(low & high);
+                units[k / 2] = k % 2 ? (units[k / 2] | packed << 32) : packed;
+            }
+
+            StringEncoding encoding = bigEndian ? SEUtf16BE : SEUtf16LE;
+            markRunsOf(units, options.minLength, scratch.starts);
+            forEachRun(units, scratch.starts, unitCount, [&](size_t start, size_t run) {
+                uint64_t offset = begin + start * 2;
+                if (offset >= end) return;
+                if (start == 0 && begin >= 2) {
+                    uint8_t a = view[begin - 2 - viewBegin], b = view[begin - 1 - viewBegin];
+                    if (bigEndian ? (a == 0 && isPrintable(b)) : (isPrintable(a) && b == 0)) return;
+                }
+                emit(offset, run, encoding, 2, bigEndian ? 1 : 0);
+            });
+        }
+
+        std::sort(out.strings.begin(), out.strings.end(), [](const FoundString& a, const FoundString& b) {
+            return a.offset != b.offset ? a.offset < b.offset : a.encoding < b.encoding;
+        });
+    }
+
+    inline char foldCase(char c)
+    {
+        return c >= 'A' && c <= 'Z' ? (char) (c - 'A' + 'a') : c;
+    }
+
+    bool lessFolded(std::string_view a, std::string_view b)
+    {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+                                            [](char x, char y) { return foldCase(x) < foldCase(y); });
+    }
+
+    // Scans `ranges` across the worker pool, fetching each one's bytes with viewOf(viewBegin, viewEnd, scratch)
+    template<class ViewOf>
+    bool scanRanges(const std::vector<std::pair<size_t, size_t>>& ranges, size_t size, ViewOf viewOf,
+                    StringIndex& index, const StringOptions& options, std::atomic<float> *progress,
+                    const std::atomic<bool> *cancel)
+    {
+        std::vector<ChunkStrings> found(ranges.size());
+        std::atomic<size_t> chunksDone = 0;
+
+        workerPool().parallelFor(ranges.size(), 1, [&](size_t first, size_t last) {
+            ScanScratch scratch;
+            for (size_t chunk = first; chunk < last; chunk++) {
+                if (cancel && cancel->load(std::memory_order_relaxed)) return;
+                auto [begin, end] = ranges[chunk];
+                size_t viewBegin = begin - std::min<size_t>(begin, 2);
+                size_t viewEnd = std::min(size, end + Overlap);
+                const uint8_t *view = viewOf(viewBegin, viewEnd, scratch.bytes);
+                scanChunk(view, viewBegin, viewEnd, begin, end, options, scratch, found[chunk]);
+                if (progress) {
+                    progress->store(0.8f * (float) ++chunksDone / (float) ranges.size(), std::memory_order_relaxed);
+                }
+            }
+        });
+        if (cancel && cancel->load()) return false;
+
+        for (ChunkStrings& chunk: found) {
+            size_t take = std::min(chunk.strings.size(), options.maxStrings - index.strings.size());
+            uint64_t poolBase = index.pool.size();
+            for (size_t i = 0; i < take; i++) {
+                FoundString string = chunk.strings[i];
+                string.text += poolBase;
+                index.strings.push_back(string);
+            }
+            index.pool += chunk.pool;
+            index.truncated |= take < chunk.strings.size();
+            chunk = ChunkStrings();
+        }
+        return true;
+    }
+
+    void sortIndex(StringIndex& index, std::atomic<float> *progress)
+    {
+        // Sorting on the first eight folded characters packed into an integer settles nearly every comparison without
+        // touching the pool
+        std::vector<std::pair<uint64_t, uint32_t>> keys(index.strings.size());
+        for (uint32_t i = 0; i < (uint32_t) keys.size(); i++) {
+            std::string_view text = index.textOf(index.strings[i]);
+            uint64_t key = 0;
+            for (size_t c = 0; c < 8; c++) {
+                key = key << 8 | (c < text.size() ? (uint8_t) foldCase(text[c]) : 0);
+            }
+            keys[i] = { key, i };
+        }
+        std::sort(keys.begin(), keys.end(), [&](const std::pair<uint64_t, uint32_t>& a,
+                                                const std::pair<uint64_t, uint32_t>& b) {
+            if (a.first != b.first) return a.first < b.first;
+            std::string_view ta = index.textOf(index.strings[a.second]), tb = index.textOf(index.strings[b.second]);
+            if (ta.size() > 8 || tb.size() > 8) {
+                if (lessFolded(ta, tb)) return true;
+                if (lessFolded(tb, ta)) return false;
+            }
+            return a.second < b.second;
+        });
+        index.sorted.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++) index.sorted[i] = keys[i].second;
+        if (progress) progress->store(1.0f, std::memory_order_relaxed);
+    }
+}
+
+bool extractStrings(const uint8_t *data, size_t size, StringIndex& index, const StringOptions& options,
+                    std::atomic<float> *progress, const std::atomic<bool> *cancel)
+{
+    index = StringIndex();
+    if (size == 0) return true;
+
+    // Chunks start on even offsets so UTF-16 units line up across them
+    std::vector<std::pair<size_t, size_t>> ranges;
+    for (size_t begin = 0; begin < size; begin += ChunkSize) {
+        ranges.emplace_back(begin, std::min(size, begin + ChunkSize));
+    }
+    auto viewOf = [data](size_t viewBegin, size_t, std::vector<uint8_t>&) { return data + viewBegin; };
+    if (!scanRanges(ranges, size, viewOf, index, options, progress, cancel)) return false;
+    sortIndex(index, progress);
+    return true;
+}
+
+bool extractStrings(const PieceSnapshot& snapshot, StringIndex& index, const StringOptions& options,
+                    std::atomic<float> *progress, const std::atomic<bool> *cancel)
+{
+    index = StringIndex();
+    if (snapshot.size() == 0) return true;
+
+    // Only chunks within Overlap of an edit are stitched together; the rest are read straight from their piece
+    std::vector<std::pair<size_t, size_t>> ranges = snapshot.scanRanges(ChunkSize, 2, Overlap);
+    auto viewOf = [&snapshot](size_t viewBegin, size_t viewEnd, std::vector<uint8_t>& scratch) {
+        return snapshot.contiguous(viewBegin, viewEnd - viewBegin, scratch);
+    };
+    if (!scanRanges(ranges, snapshot.size(), viewOf, index, options, progress, cancel)) return false;
+    sortIndex(index, progress);
+    return true;
+}
+
+void findByPrefix(const StringIndex& index, std::string_view prefix, size_t& first, size_t& last)
+{
+    // Comparing only the first prefix.size() characters makes every string with the prefix compare equal
+    auto head = [&](uint32_t i) { return index.textOf(index.strings[i]).substr(0, prefix.size()); };
+    auto lower = std::lower_bound(index.sorted.begin(), index.sorted.end(), prefix,
+                                  [&](uint32_t i, std::string_view p) { return lessFolded(head(i), p); });
+    auto upper = std::upper_bound(lower, index.sorted.end(), prefix,
+                                  [&](std::string_view p, uint32_t i) { return lessFolded(p, head(i)); });
+    first = (size_t) (lower - index.sorted.begin());
+    last = (size_t) (upper - index.sorted.begin());
+}
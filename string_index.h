@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class PieceSnapshot;
+
+enum StringEncoding : uint8_t
+{
+    SEAscii,
+    SEUtf16LE,
+    SEUtf16BE
+};
+
+struct FoundString
+{
+    uint64_t offset;
+    uint32_t length;     // in characters
+    uint32_t textLength; // characters kept in the index's text pool, at most StringIndex::MaxStoredLength
+    uint64_t text;       // offset into the text pool
+    StringEncoding encoding;
+
+    uint64_t byteLength() const { return (uint64_t) length * (encoding == SEAscii ? 1 : 2); }
+};
+
+struct StringIndex
+{
+    static constexpr uint32_t MaxStoredLength = 256;
+
+    std::vector<FoundString> strings;  // by offset
+    std::vector<uint32_t> sorted;      // indices into strings, by case-insensitive text, then offset
+    std::string pool;                  // characters of every string, UTF-16 narrowed to ASCII
+    bool truncated = false;            // more than maxStrings were found; the earliest in the file are kept
+
+    std::string_view textOf(const FoundString& found) const { return { pool.data() + found.text, found.textLength }; }
+};
+
+struct StringOptions
+{
+    uint32_t minLength = 4;
+    bool ascii = true;
+    bool utf16LE = true;
+    bool utf16BE = true;
+    size_t maxStrings = 1 << 22;
+};
+
+// Finds runs of at least minLength printable ASCII characters, as single bytes or as 2-byte-aligned UTF-16 code
+// units in either byte order. Bytes are classified sixteen at a time with SSE2 where available, in chunks across the
+// worker pool; a string reaching more than 64 KiB past the end of its 4 MiB chunk is cut short there. Returns false
+// if `cancel` was raised.
+bool extractStrings(const uint8_t *data, size_t size, StringIndex& index,
+                    const StringOptions& options = StringOptions(), std::atomic<float> *progress = nullptr,
+                    const std::atomic<bool> *cancel = nullptr);
+
+// The same over a snapshot of an edited document, read piece by piece; only the bytes around edits are copied
+bool extractStrings(const PieceSnapshot& snapshot, StringIndex& index,
+                    const StringOptions& options = StringOptions(), std::atomic<float> *progress = nullptr,
+                    const std::atomic<bool> *cancel = nullptr);
+
+// Range [first, last) of index.sorted whose text starts with `prefix`, ignoring ASCII case
+void findByPrefix(const StringIndex& index, std::string_view prefix, size_t& first, size_t& last);
@@ -0,0 +1,361 @@
+#include "struct_template.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+    // Fixed arrays up to this length get a column per element; longer ones are shown as a single preview
+    constexpr uint32_t MaxUnrolledElements = 16;
+    constexpr uint64_t MaxArrayPreview = 8;
+    constexpr uint64_t MaxStringPreview = 64;
+    constexpr uint32_t MaxSegmentSize = 1 << 30;
+
+    struct TypeName
+    {
+        const char *name;
+        FieldType type;
+    };
+
+    const TypeName typeNames[] = {
+        { "u8", FTU8 }, { "uint8", FTU8 }, { "byte", FTU8 },
+        { "i8", FTI8 }, { "int8", FTI8 }, { "s8", FTI8 },
+        { "u16", FTU16 }, { "uint16", FTU16 },
+        { "i16", FTI16 }, { "int16", FTI16 }, { "s16", FTI16 },
+        { "u32", FTU32 }, { "uint32", FTU32 },
+        { "i32", FTI32 }, { "int32", FTI32 }, { "s32", FTI32 },
+        { "u64", FTU64 }, { "uint64", FTU64 },
+        { "i64", FTI64 }, { "int64", FTI64 }, { "s64", FTI64 },
+        { "f32", FTF32 }, { "float", FTF32 },
+        { "f64", FTF64 }, { "double", FTF64 },
+        { "char", FTChar }
+    };
+
+    bool parseType(const std::string& name, FieldType& type)
+    {
+        for (const auto& entry: typeNames) {
+            if (name == entry.name) {
+                type = entry.type;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool isInteger(FieldType type)
+    {
+        return type <= FTI64;
+    }
+
+    // Loads a value of `size` bytes into the low bytes of a host-order word
+    uint64_t loadBits(const uint8_t *bytes, size_t size, bool bigEndian)
+    {
+        uint8_t ordered[8] = {};
+        for (size_t i = 0; i < size; i++) {
+            ordered[i] = bigEndian ? bytes[size - 1 - i] : bytes[i];
+        }
+        uint64_t bits;
+        memcpy(&bits, ordered, 8);
+        return bits;
+    }
+
+    int64_t signExtend(uint64_t bits, size_t size)
+    {
+        int shift = 64 - (int) size * 8;
+        return shift ? (int64_t) (bits << shift) >> shift : (int64_t) bits;
+    }
+
+    // Reads from a PieceTable on the UI thread or a PieceSnapshot on the pool
+    template<class Source>
+    bool readInteger(const Source& table, uint64_t offset, const StructTemplate::Column& column, uint64_t& value)
+    {
+        uint8_t bytes[8];
+        size_t size = fieldTypeSize(column.type);
+        if (table.read(offset, bytes, size) != size) return false;
+
+        uint64_t bits = loadBits(bytes, size, column.bigEndian);
+        bool isSigned = column.type == FTI8 || column.type == FTI16 || column.type == FTI32 || column.type == FTI64;
+        value = isSigned ? (uint64_t) signExtend(bits, size) : bits;
+        return true;
+    }
+
+    int formatValue(FieldType type, const uint8_t *bytes, bool bigEndian, char *out, size_t outSize)
+    {
+        size_t size = fieldTypeSize(type);
+        uint64_t bits = loadBits(bytes, size, bigEndian);
+
+        switch (type) {
+            case FTI8:
+            case FTI16:
+            case FTI32:
+            case FTI64:
+                return snprintf(out, outSize, "%" PRId64, signExtend(bits, size));
+            case FTF32: {
+                float f;
+                auto word = (uint32_t) bits;
+                memcpy(&f, &word, 4);
+                return snprintf(out, outSize, "%g", f);
+            }
+            case FTF64: {
+                double d;
+                memcpy(&d, &bits, 8);
+                return snprintf(out, outSize, "%g", d);
+            }
+            default:
+                return snprintf(out, outSize, "%" PRIu64, bits);
+        }
+    }
+
+    // Fills `bases` for the record at `recordOffset` and returns where it ends, or UINT64_MAX if it runs past the
+    // end of the data
+    template<class Source>
+    uint64_t walkSegments(const StructTemplate& tmpl, const Source& table, uint64_t recordOffset,
+                          std::vector<uint64_t>& bases)
+    {
+        uint64_t size = table.size();
+        uint64_t base = recordOffset;
+        bases.clear();
+
+        for (const auto& segment: tmpl.segments) {
+            bases.push_back(base);
+            if (base > size || size - base < segment.size) return UINT64_MAX;
+            uint64_t end = base + segment.size;
+
+            if (segment.arrayColumn >= 0) {
+                const auto& array = tmpl.columns[segment.arrayColumn];
+                const auto& countColumn = tmpl.columns[array.countColumn];
+                uint64_t count;
+                if (!readInteger(table, bases[countColumn.segment] + countColumn.offset, countColumn, count)) {
+                    return UINT64_MAX;
+                }
+                // Negative or garbage counts land here too, since they read as huge unsigned values
+                if (count > (size - end) / fieldTypeSize(array.type)) return UINT64_MAX;
+                end += count * fieldTypeSize(array.type);
+            }
+            base = end;
+        }
+        return base;
+    }
+}
+
+size_t fieldTypeSize(FieldType type)
+{
+    switch (type) {
+        case FTU16:
+        case FTI16:
+            return 2;
+        case FTU32:
+        case FTI32:
+        case FTF32:
+            return 4;
+        case FTU64:
+        case FTI64:
+        case FTF64:
+            return 8;
+        default:
+            return 1;
+    }
+}
+
+namespace
+{
+    bool compileFields(const nlohmann::json& source, StructTemplate& compiled, std::string& error)
+    {
+        if (!source.is_object() || !source.contains("fields") || !source["fields"].is_array()) {
+            error = "Template needs a \"fields\" array";
+            return false;
+        }
+
+        StructTemplate out;
+        out.name = source.value("name", "record");
+        bool defaultBigEndian = source.value("endian", "little") == "big";
+        out.segments.emplace_back();
+
+        // Checked in 64 bits before adding, so a huge count can't wrap a segment back to something small
+        auto grow = [&](uint64_t bytes) {
+            uint64_t size = out.segments.back().size + bytes;
+            if (size > MaxSegmentSize) return false;
+            out.segments.back().size = (uint32_t) size;
+            return true;
+        };
+
+        size_t index = 0;
+        for (const auto& field: source["fields"]) {
+            if (!field.is_object()) {
+                error = "Field " + std::to_string(index) + " is not an object";
+                return false;
+            }
+
+            std::string name = field.value("name", "field" + std::to_string(index));
+            std::string typeName = field.value("type", "");
+            index++;
+
+            if (typeName == "pad") {
+                if (!grow(field.value("size", (uint64_t) 0))) {
+                    error = "Padding " + name + " is too large";
+                    return false;
+                }
+                continue;
+            }
+
+            StructTemplate::Column column;
+            if (!parseType(typeName, column.type)) {
+                error = "Unknown type \"" + typeName + "\" for field " + name;
+                return false;
+            }
+            column.name = name;
+            column.bigEndian = field.contains("endian") ? field["endian"] == "big" : defaultBigEndian;
+            column.segment = (uint32_t) out.segments.size() - 1;
+            column.offset = out.segments.back().size;
+            uint32_t elementSize = (uint32_t) fieldTypeSize(column.type);
+
+            auto count = field.find("count");
+            if (count == field.end()) {
+                out.columns.push_back(column);
+                if (!grow(elementSize)) {
+                    error = "Field " + name + " is too large";
+                    return false;
+                }
+            } else if (count->is_number_unsigned()) {
+                uint64_t elements = count->get<uint64_t>();
+                if (elements > MaxSegmentSize || !grow(elements * elementSize)) {
+                    error = "Field " + name + " is too large";
+                    return false;
+                }
+                if (column.type != FTChar && elements <= MaxUnrolledElements) {
+                    for (uint32_t i = 0; i < (uint32_t) elements; i++) {
+                        StructTemplate::Column element = column;
+                        element.name = name + "[" + std::to_string(i) + "]";
+                        element.offset = column.offset + i * elementSize;
+                        out.columns.push_back(element);
+                    }
+                } else {
+                    column.count = (uint32_t) elements;
+                    column.isArray = column.type != FTChar;
+                    out.columns.push_back(column);
+                }
+            } else if (count->is_string()) {
+                auto countColumn = std::find_if(out.columns.begin(), out.columns.end(), [&](const auto& c) {
+                    return c.name == count->get<std::string>();
+                });
+                if (countColumn == out.columns.end() || !isInteger(countColumn->type) || countColumn->isArray) {
+                    error = "Count of " + name + " must name an earlier integer field";
+                    return false;
+                }
+
+                // The variable-length array ends this segment; everything after it is laid out from a new base
+                column.countColumn = (int32_t) (countColumn - out.columns.begin());
+                column.isArray = column.type != FTChar;
+                out.columns.push_back(column);
+                out.segments.back().arrayColumn = (int32_t) out.columns.size() - 1;
+                out.segments.emplace_back();
+            } else {
+                error = "Count of " + name + " must be a number or a field name";
+                return false;
+            }
+        }
+
+        if (out.columns.empty()) {
+            error = "Template has no fields";
+            return false;
+        }
+
+        compiled = std::move(out);
+        return true;
+    }
+}
+
+bool compileTemplate(const nlohmann::json& source, StructTemplate& compiled, std::string& error)
+{
+    // Fields of the wrong JSON type throw from the accessors; report them like any other template mistake
+    try {
+        return compileFields(source, compiled, error);
+    } catch (const nlohmann::json::exception& e) {
+        error = e.what();
+        return false;
+    }
+}
+
+bool layoutRecords(const StructTemplate& tmpl, const PieceSnapshot& table, uint64_t start, uint64_t count,
+                   RecordLayout& layout, const std::atomic<bool> *cancel)
+{
+    layout = RecordLayout();
+    layout.start = start;
+    if (start > table.size()) return true;
+
+    if (tmpl.isFixedSize()) {
+        layout.stride = tmpl.segments[0].size;
+        uint64_t available = layout.stride ? (table.size() - start) / layout.stride : 0;
+        layout.count = std::min(count, available);
+        return true;
+    }
+
+    // Only the count fields are read, so this stays a short loop per record even for millions of them
+    std::vector<uint64_t> bases;
+    layout.offsets.reserve((size_t) std::min<uint64_t>(count, 1 << 20) + 1);
+    uint64_t offset = start;
+    for (uint64_t record = 0; record < count; record++) {
+        if (cancel && (record & 0xFFFF) == 0 && cancel->load(std::memory_order_relaxed)) return false;
+        uint64_t end = walkSegments(tmpl, table, offset, bases);
+        if (end == UINT64_MAX) break;
+
+        layout.offsets.push_back(offset);
+        offset = end;
+    }
+    layout.offsets.push_back(offset);
+    layout.count = layout.offsets.size() - 1;
+    return true;
+}
+
+void segmentBases(const StructTemplate& tmpl, const PieceTable& table, uint64_t recordOffset,
+                  std::vector<uint64_t>& bases)
+{
+    walkSegments(tmpl, table, recordOffset, bases);
+}
+
+void formatColumn(const StructTemplate& tmpl, const StructTemplate::Column& column, const PieceTable& table,
+                  const std::vector<uint64_t>& bases, char *out, size_t outSize)
+{
+    out[0] = '\0';
+    if (column.segment >= bases.size()) return;
+    uint64_t offset = bases[column.segment] + column.offset;
+
+    uint64_t count = column.count;
+    if (column.countColumn >= 0) {
+        const auto& countColumn = tmpl.columns[column.countColumn];
+        if (!readInteger(table, bases[countColumn.segment] + countColumn.offset, countColumn, count)) return;
+    }
+
+    size_t elementSize = fieldTypeSize(column.type);
+    uint8_t bytes[MaxStringPreview];
+
+    if (column.type == FTChar) {
+        size_t length = table.read(offset, bytes, (size_t) std::min(count, MaxStringPreview));
+        size_t written = 0;
+        for (size_t i = 0; i < length && written + 1 < outSize; i++) {
+            out[written++] = bytes[i] >= 0x20 && bytes[i] < 0x7F ? (char) bytes[i] : '.';
+        }
+        out[written] = '\0';
+        return;
+    }
+
+    if (!column.isArray) {
+        if (table.read(offset, bytes, elementSize) == elementSize) {
+            formatValue(column.type, bytes, column.bigEndian, out, outSize);
+        }
+        return;
+    }
+
+    int written = snprintf(out, outSize, "[%" PRIu64 "]", count);
+    uint64_t shown = std::min(count, MaxArrayPreview);
+    for (uint64_t i = 0; i < shown && written > 0 && (size_t) written + 2 < outSize; i++) {
+        if (table.read(offset + i * elementSize, bytes, elementSize) != elementSize) break;
+        out[written++] = ' ';
+        written += formatValue(column.type, bytes, column.bigEndian, out + written, outSize - written);
+    }
+    if (shown < count && written > 0 && (size_t) written + 4 < outSize) {
+        strcpy(out + written, " ...");
+    }
+}
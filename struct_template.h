@@ -0,0 +1,102 @@
+#pragma once
+
+#include "piece_table.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+enum FieldType : uint8_t
+{
+    FTU8,
+    FTI8,
+    FTU16,
+    FTI16,
+    FTU32,
+    FTI32,
+    FTU64,
+    FTI64,
+    FTF32,
+    FTF64,
+    FTChar
+};
+
+// A record layout described in JSON, compiled into flat columns:
+//
+//   { "name": "Mesh", "endian": "big", "fields": [
+//       { "name": "vertexCount", "type": "u32" },
+//       { "name": "bounds", "type": "f32", "count": 6 },
+//       { "name": "tag", "type": "char", "count": 4 },
+//       { "type": "pad", "size": 4 },
+//       { "name": "indices", "type": "u16", "count": "vertexCount", "endian": "little" } ] }
+//
+// Fields are grouped into segments of fixed layout, each ended by a variable-length array, so every column is a
+// single load at an offset precomputed at compile time from its segment's base. Small fixed arrays are unrolled
+// into one column per element.
+struct StructTemplate
+{
+    struct Column
+    {
+        std::string name;
+        FieldType type = FTU8;
+        bool bigEndian = false;
+        uint32_t segment = 0;
+        uint32_t offset = 0;      // from the segment's base
+        uint32_t count = 1;       // characters in a string, or elements in a fixed array
+        bool isArray = false;     // shown as a preview of its elements
+        int32_t countColumn = -1; // for variable-length arrays, the earlier column holding the element count
+    };
+
+    struct Segment
+    {
+        uint32_t size = 0;
+        int32_t arrayColumn = -1; // variable-length array following this segment, -1 for the last segment
+    };
+
+    std::string name;
+    std::vector<Column> columns;
+    std::vector<Segment> segments;
+
+    bool isFixedSize() const { return segments.size() == 1; }
+};
+
+// Record positions from applying a template at an address. Fixed-size records are computed on demand; variable
+// ones are found by walking the count fields once, up front.
+struct RecordLayout
+{
+    uint64_t start = 0;
+    uint64_t count = 0;
+    uint64_t stride = 0;            // fixed-size templates only
+    std::vector<uint64_t> offsets;  // variable-size templates only, count + 1 entries
+
+    uint64_t offsetOf(uint64_t record) const
+    {
+        return offsets.empty() ? start + record * stride : offsets[record];
+    }
+
+    uint64_t sizeOf(uint64_t record) const
+    {
+        return offsets.empty() ? stride : offsets[record + 1] - offsets[record];
+    }
+};
+
+size_t fieldTypeSize(FieldType type);
+
+bool compileTemplate(const nlohmann::json& source, StructTemplate& compiled, std::string& error);
+
+// Lays out up to `count` records from `start`, stopping at the first one that would run past the end of the data.
+// Walking a variable-size template reads every record, so this runs on the pool over a snapshot. Returns false if
+// `cancel` was raised.
+bool layoutRecords(const StructTemplate& tmpl, const PieceSnapshot& table, uint64_t start, uint64_t count,
+                   RecordLayout& layout, const std::atomic<bool> *cancel = nullptr);
+
+// Base offset of each segment of the record at `recordOffset`
+void segmentBases(const StructTemplate& tmpl, const PieceTable& table, uint64_t recordOffset,
+                  std::vector<uint64_t>& bases);
+
+// Formats one column of a record for the table view
+void formatColumn(const StructTemplate& tmpl, const StructTemplate::Column& column, const PieceTable& table,
+                  const std::vector<uint64_t>& bases, char *out, size_t outSize);
@@ -0,0 +1,222 @@
+#include "synthetic_corpus.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    // splitmix64; std distributions aren't specified exactly enough to give the same corpus on every platform
+    class Random
+    {
+    public:
+        explicit Random(uint64_t seed) : state_(seed) {}
+
+        uint64_t next()
+        {
+            uint64_t z = (state_ += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            return z ^ (z >> 31);
+        }
+
+        uint64_t below(uint64_t bound) { return next() % bound; }
+        float unit() { return (float) (next() >> 40) / (float) (1ull << 24); }
+        float between(float low, float high) { return low + (high - low) * unit(); }
+
+    private:
+        uint64_t state_;
+    };
+
+    void putWord(uint8_t *out, uint32_t bits, bool bigEndian)
+    {
+        if (bigEndian) {
+            bits = (bits >> 24) | ((bits >> 8) & 0x0000FF00u) | ((bits << 8) & 0x00FF0000u) | (bits << 24);
+        }
+        memcpy(out, &bits, 4);
+    }
+
+    void putFloat(uint8_t *out, float f, bool bigEndian)
+    {
+        uint32_t bits;
+        memcpy(&bits, &f, 4);
+        putWord(out, bits, bigEndian);
+    }
+
+    struct Vertex
+    {
+        float position[3];
+        float normal[3];
+        float uv[2];
+    };
+
+    // Either a bumpy grid or a UV sphere, emitted row by row like most exporters do
+    void makeShape(Random& random, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        uint32_t columns = 8 + (uint32_t) random.below(120);
+        uint32_t rows = 8 + (uint32_t) random.below(120);
+        bool sphere = random.below(2) == 0;
+        float scale = std::pow(10.0f, random.between(-1.0f, 2.0f));
+        float center[3] = { random.between(-2, 2) * scale, random.between(-2, 2) * scale,
+                            random.between(-2, 2) * scale };
+        float bump = random.between(0.0f, 0.3f);
+
+        vertices.clear();
+        for (uint32_t r = 0; r < rows; r++) {
+            for (uint32_t c = 0; c < columns; c++) {
+                float u = (float) c / (float) (columns - 1), v = (float) r / (float) (rows - 1);
+                Vertex vertex {};
+                if (sphere) {
+                    float theta = u * 6.2831853f, phi = v * 3.1415927f;
+                    float n[3] = { std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta) };
+                    for (int axis = 0; axis < 3; axis++) {
+                        vertex.normal[axis] = n[axis];
+                        vertex.position[axis] = center[axis] + n[axis] * scale;
+                    }
+                } else {
+                    float height = bump * std::sin(u * 9.0f) * std::cos(v * 7.0f);
+                    vertex.position[0] = center[0] + (u - 0.5f) * scale;
+                    vertex.position[1] = center[1] + height * scale;
+                    vertex.position[2] = center[2] + (v - 0.5f) * scale;
+                    vertex.normal[1] = 1.0f;
+                }
+                vertex.uv[0] = u;
+                vertex.uv[1] = v;
+                vertices.push_back(vertex);
+            }
+        }
+
+        indices.clear();
+        for (uint32_t r = 0; r + 1 < rows; r++) {
+            for (uint32_t c = 0; c + 1 < columns; c++) {
+                uint32_t i = r * columns + c;
+                indices.insert(indices.end(), { i, i + columns, i + 1, i + 1, i + columns, i + columns + 1 });
+            }
+        }
+    }
+
+    // Bytes a mesh with this layout needs, including its index buffer
+    uint64_t meshFootprint(size_t vertexCount, size_t indexCount, uint32_t stride, bool indexed, bool halfWidth)
+    {
+        uint64_t bytes = (uint64_t) vertexCount * stride;
+        if (indexed) bytes += 4 + (uint64_t) indexCount * (halfWidth ? 2 : 4);
+        return bytes;
+    }
+
+    void writeMesh(uint8_t *out, uint64_t start, const std::vector<Vertex>& vertices,
+                   const std::vector<uint32_t>& indices, EmbeddedMesh& mesh)
+    {
+        uint8_t *p = out + start;
+        for (const Vertex& vertex: vertices) {
+            for (int axis = 0; axis < 3; axis++) putFloat(p + axis * 4, vertex.position[axis], mesh.bigEndian);
+
+            // Whatever follows the position: a w of 1, texture coordinates, then a normal
+            uint32_t extra = (mesh.stride - 12) / 4;
+            if (extra == 1) {
+                putFloat(p + 12, 1.0f, mesh.bigEndian);
+            } else {
+                for (uint32_t i = 0; i < extra; i++) {
+                    float value = i < 2 ? vertex.uv[i] : i < 5 ? vertex.normal[i - 2] : 0.0f;
+                    putFloat(p + 12 + i * 4, value, mesh.bigEndian);
+                }
+            }
+            p += mesh.stride;
+        }
+
+        mesh.vertexStart = start;
+        mesh.vertexCount = (uint32_t) vertices.size();
+        mesh.indexStart = 0;
+        mesh.indexCount = 0;
+        if (!mesh.indexed) return;
+
+        mesh.indexStart = (start + (uint64_t) vertices.size() * mesh.stride + 3) & ~(uint64_t) 3;
+        mesh.indexCount = (uint32_t) indices.size();
+        uint8_t *q = out + mesh.indexStart;
+        for (uint32_t index: indices) {
+            if (mesh.halfWidthIndexes) {
+                uint16_t half = (uint16_t) index;
+                q[0] = (uint8_t) (mesh.bigEndian ? half >> 8 : half);
+                q[1] = (uint8_t) (mesh.bigEndian ? half : half >> 8);
+                q += 2;
+            } else {
+                putWord(q, index, mesh.bigEndian);
+                q += 4;
+            }
+        }
+    }
+
+    // Filler between meshes, in the proportions typical of game archives and firmware images
+    void writeFiller(Random& random, uint8_t *out, uint64_t length)
+    {
+        static const char text[] = "texture diffuse_map.dds material shader vs_main ps_main bone_root ";
+        uint64_t position = 0;
+        while (position < length) {
+            uint64_t span = std::min<uint64_t>(length - position, 256 + random.below(64 * 1024));
+            uint8_t *p = out + position;
+
+            switch (random.below(8)) {
+                case 0:
+                    memset(p, 0, span);
+                    break;
+                case 1:
+                    for (uint64_t i = 0; i < span; i++) p[i] = (uint8_t) text[i % (sizeof(text) - 1)];
+                    break;
+                case 2: {
+                    // Random float tables: plausible values that shouldn't be taken for a mesh
+                    bool bigEndian = random.below(2) == 0;
+                    for (uint64_t i = 0; i + 4 <= span; i += 4) putFloat(p + i, random.between(-1.0f, 1.0f), bigEndian);
+                    break;
+                }
+                default:
+                    for (uint64_t i = 0; i < span; i += 8) {
+                        uint64_t bits = random.next();
+                        memcpy(p + i, &bits, std::min<uint64_t>(8, span - i));
+                    }
+                    break;
+            }
+            position += span;
+        }
+    }
+}
+
+void generateCorpus(size_t size, uint64_t seed, SyntheticCorpus& corpus)
+{
+    static const uint32_t strides[] = { 12, 16, 20, 24, 32 };
+
+    Random random(seed);
+    corpus.bytes.assign(size, 0);
+    corpus.meshes.clear();
+    corpus.markers.clear();
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    uint64_t cursor = 0;
+    while (cursor < size) {
+        uint64_t gap = std::min<uint64_t>(size - cursor, 64 * 1024 + random.below(1 << 20));
+        writeFiller(random, corpus.bytes.data() + cursor, gap);
+
+        // A marker lands somewhere in most gaps
+        if (gap >= sizeof(SyntheticMarker) && random.below(4) != 0) {
+            uint64_t at = cursor + random.below(gap - sizeof(SyntheticMarker) + 1);
+            memcpy(corpus.bytes.data() + at, SyntheticMarker, sizeof(SyntheticMarker));
+            corpus.markers.push_back(at);
+        }
+        cursor += gap;
+
+        makeShape(random, vertices, indices);
+        EmbeddedMesh mesh {};
+        mesh.stride = strides[random.below(std::size(strides))];
+        mesh.bigEndian = random.below(2) == 0;
+        mesh.indexed = random.below(3) != 0;
+        mesh.halfWidthIndexes = vertices.size() <= 65536 && random.below(3) != 0;
+
+        uint64_t footprint = meshFootprint(vertices.size(), indices.size(), mesh.stride, mesh.indexed,
+                                           mesh.halfWidthIndexes);
+        uint64_t start = (cursor + 3) & ~(uint64_t) 3;
+        if (start + footprint > size) break;
+
+        writeMesh(corpus.bytes.data(), start, vertices, indices, mesh);
+        corpus.meshes.push_back(mesh);
+        cursor = start + footprint;
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Ground truth for one mesh placed in a synthetic corpus
+struct EmbeddedMesh
+{
+    uint64_t vertexStart;
+    uint32_t vertexCount;
+    uint32_t stride;
+    bool bigEndian;
+    bool indexed;
+    bool halfWidthIndexes;
+    uint64_t indexStart;
+    uint32_t indexCount;
+};
+
+struct SyntheticCorpus
+{
+    std::vector<uint8_t> bytes;
+    std::vector<EmbeddedMesh> meshes;
+    std::vector<uint64_t> markers;  // offsets of every SyntheticMarker, in order
+};
+
+// Eight bytes planted at known offsets for checking pattern search
+constexpr uint8_t SyntheticMarker[8] = { 0x48, 0x58, 0x53, 0x50, 0x9D, 0x3A, 0xC7, 0x01 };
+
+// Fills `corpus` with `size` bytes of random noise, zero fill, text and random float tables, with grid and sphere
+// meshes of varied stride, byte order and indexing embedded throughout. The same seed always gives the same bytes.
+void generateCorpus(size_t size, uint64_t seed, SyntheticCorpus& corpus);
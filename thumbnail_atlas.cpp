@@ -0,0 +1,264 @@
+#include "thumbnail_atlas.h"
+#include "shader.h"
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    constexpr int AtlasSize = ThumbnailAtlas::TilesPerRow * ThumbnailAtlas::TileSize;
+
+    // Points drawn per thumbnail at most; bigger meshes are sampled evenly
+    constexpr uint32_t MaxPoints = 8192;
+
+    const char *vertexSource =
+        "#version 330 core\n"
+        "layout (location = 0) in uvec4 slice;"  // start, count, tile, unused
+        "layout (location = 1) in vec4 frame;"   // center, 1 / radius
+        "uniform samplerBuffer positions;"
+        "uniform mat3 rotation;"
+        "out float shade;"
+        "void main() {"
+        "   gl_Position = vec4(2.0, 2.0, 2.0, 1.0);"  // clipped unless the position is usable
+        "   gl_PointSize = 1.5;"
+        "   shade = 0.0;"
+        "   if (uint(gl_VertexID) >= slice.y) return;"
+        "   int base = int(slice.x + uint(gl_VertexID)) * 3;"
+        "   vec3 p = vec3(texelFetch(positions, base).r, texelFetch(positions, base + 1).r,"
+        "                 texelFetch(positions, base + 2).r);"
+        "   vec3 q = rotation * (p - frame.xyz) * frame.w;"
+        "   if (any(isnan(q)) || any(greaterThan(abs(q), vec3(1.0)))) return;"
+        "   uint tile = slice.z;"
+        "   vec2 cell = vec2(float(tile % 8u), float(tile / 8u));"
+        "   gl_Position = vec4((cell + q.xy * 0.45 + 0.5) * 0.25 - 1.0, -q.z, 1.0);"
+        "   shade = 0.65 + 0.35 * q.z;"
+        "}";
+
+    const char *fragmentSource =
+        "#version 330 core\n"
+        "in float shade;"
+        "out vec4 color;"
+        "void main() {"
+        "   color = vec4(shade, 0.15 * shade, 0.1 * shade, 1);"
+        "}";
+
+    static_assert(ThumbnailAtlas::TilesPerRow == 8, "the vertex shader assumes 8 tiles per row");
+
+    bool readFloat(const PieceTable& table, uint64_t offset, bool bigEndian, float& value)
+    {
+        uint8_t bytes[4];
+        if (table.read(offset, bytes, 4) != 4) return false;
+        if (bigEndian) std::reverse(bytes, bytes + 4);
+        memcpy(&value, bytes, 4);
+        return std::isfinite(value) && std::fabs(value) < 1e30f;
+    }
+
+    bool readIndex(const PieceTable& table, uint64_t offset, bool bigEndian, bool halfWidth, uint64_t& index)
+    {
+        uint8_t bytes[4] {};
+        size_t width = halfWidth ? 2 : 4;
+        if (table.read(offset, bytes, width) != width) return false;
+        if (bigEndian) std::reverse(bytes, bytes + width);
+        index = halfWidth ? (uint32_t) (bytes[0] | bytes[1] << 8) : (uint32_t) bytes[0] | (uint32_t) bytes[1] << 8 |
+                                                                        (uint32_t) bytes[2] << 16 |
+                                                                        (uint32_t) bytes[3] << 24;
+        return true;
+    }
+}
+
+ThumbnailAtlas::~ThumbnailAtlas()
+{
+    if (!program_) return;
+    glDeleteProgram(program_);
+    glDeleteVertexArrays(1, &vao_);
+    glDeleteBuffers(1, &instanceBuffer_);
+    glDeleteTextures(1, &dataTexture_);
+    glDeleteBuffers(1, &dataBuffer_);
+    glDeleteTextures(1, &colorTexture_);
+    glDeleteRenderbuffers(1, &depthBuffer_);
+    glDeleteFramebuffers(1, &framebuffer_);
+}
+
+bool ThumbnailAtlas::create()
+{
+    program_ = linkProgram(vertexSource, fragmentSource);
+    if (!program_) return false;
+    rotationLocation_ = glGetUniformLocation(program_, "rotation");
+    glUseProgram(program_);
+    glUniform1i(glGetUniformLocation(program_, "positions"), 0);
+    glUseProgram(0);
+
+    glGenTextures(1, &colorTexture_);
+    glBindTexture(GL_TEXTURE_2D, colorTexture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, AtlasSize, AtlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenRenderbuffers(1, &depthBuffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer_);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, AtlasSize, AtlasSize);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture_, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer_);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenTextures(1, &dataTexture_);
+    glGenBuffers(1, &dataBuffer_);
+
+    // Everything comes from per-instance attributes and gl_VertexID
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &instanceBuffer_);
+    glBindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer_);
+    glVertexAttribIPointer(0, 4, GL_UNSIGNED_INT, sizeof(Instance), (void *) offsetof(Instance, start));
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), (void *) offsetof(Instance, center));
+    for (unsigned attribute = 0; attribute < 2; attribute++) {
+        glEnableVertexAttribArray(attribute);
+        glVertexAttribDivisor(attribute, 1);
+    }
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    tiles_.assign(TileCount, VisParams());
+    valid_.assign(TileCount, false);
+    return status == GL_FRAMEBUFFER_COMPLETE;
+}
+
+// Samples at most MaxPoints vertices evenly and frames the thumbnail on their bounding box
+ThumbnailAtlas::Instance ThumbnailAtlas::makeInstance(const VisParams& params, const PieceTable& table, int tile,
+                                                      std::vector<float>& positions)
+{
+    Instance instance {};
+    uint64_t count = params.vertexCount;
+    uint64_t step = std::max<uint64_t>(1, (count + MaxPoints - 1) / MaxPoints);
+    uint64_t stride = params.vertexStride;
+    uint64_t indexWidth = params.halfWidthIndexes ? 2 : 4;
+    instance.start = (uint32_t) (positions.size() / 3);
+    instance.tile = (uint32_t) tile;
+
+    glm::vec3 low(INFINITY), high(-INFINITY);
+    for (uint64_t element = 0; element < count; element += step) {
+        uint64_t vertex = element;
+        if (params.indexedDraw && !readIndex(table, params.indexBufferStart + element * indexWidth,
+                                             params.bigEndian, params.halfWidthIndexes, vertex)) {
+            break;
+        }
+
+        glm::vec3 position;
+        uint64_t base = params.vertexBufferStart + vertex * stride;
+        if (readFloat(table, base, params.bigEndian, position.x) &&
+            readFloat(table, base + 4, params.bigEndian, position.y) &&
+            readFloat(table, base + 8, params.bigEndian, position.z)) {
+            low = glm::min(low, position);
+            high = glm::max(high, position);
+        } else {
+            position = glm::vec3(NAN);
+        }
+        positions.insert(positions.end(), { position.x, position.y, position.z });
+        instance.count++;
+    }
+
+    glm::vec3 center(0.0f);
+    float radius = 1.0f;
+    if (low.x <= high.x) {
+        center = (low + high) * 0.5f;
+        radius = glm::length(high - low) * 0.5f;
+        if (!(radius > 0.0f && std::isfinite(radius))) radius = 1.0f;
+    }
+    memcpy(instance.center, glm::value_ptr(center), sizeof(instance.center));
+    instance.inverseRadius = 1.0f / radius;
+    return instance;
+}
+
+void ThumbnailAtlas::update(const std::vector<VisParams>& candidates, const PieceTable& table, uint64_t revision)
+{
+    lastRedrawn_ = 0;
+    if (!program_) return;
+
+    if (revision != revision_) {
+        revision_ = revision;
+        std::fill(valid_.begin(), valid_.end(), false);
+    }
+
+    std::vector<Instance> instances;
+    std::vector<float> positions;
+    uint32_t maxDrawn = 0;
+    for (int tile = 0; tile < TileCount && tile < (int) candidates.size(); tile++) {
+        if (valid_[tile] && sameLayout(tiles_[tile], candidates[tile])) continue;
+
+        tiles_[tile] = candidates[tile];
+        valid_[tile] = true;
+        instances.push_back(makeInstance(candidates[tile], table, tile, positions));
+        maxDrawn = std::max(maxDrawn, instances.back().count);
+    }
+    if (instances.empty()) return;
+    lastRedrawn_ = (int) instances.size();
+
+    int viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glViewport(0, 0, AtlasSize, AtlasSize);
+
+    // Clear just the tiles being redrawn, the rest keep their cached image
+    glEnable(GL_SCISSOR_TEST);
+    glClearColor(0.08f, 0.08f, 0.1f, 1.0f);
+    for (const Instance& instance: instances) {
+        glScissor((int) (instance.tile % TilesPerRow) * TileSize, (int) (instance.tile / TilesPerRow) * TileSize,
+                  TileSize, TileSize);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer_);
+    glBufferData(GL_ARRAY_BUFFER, (long) (instances.size() * sizeof(Instance)), instances.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, dataBuffer_);
+    glBufferData(GL_TEXTURE_BUFFER, (long) (positions.size() * sizeof(float)), positions.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_BUFFER, dataTexture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, dataBuffer_);
+
+    // Same angle as the main view, looking at the origin from (1, 1, 1)
+    glm::mat3 rotation(glm::lookAt(glm::vec3(1, 1, 1), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0)));
+    glUseProgram(program_);
+    glUniformMatrix3fv(rotationLocation_, 1, GL_FALSE, glm::value_ptr(rotation));
+
+    glEnable(GL_PROGRAM_POINT_SIZE);
+    glBindVertexArray(vao_);
+    glDrawArraysInstanced(GL_POINTS, 0, (int) maxDrawn, (int) instances.size());
+    glBindVertexArray(0);
+    glDisable(GL_PROGRAM_POINT_SIZE);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void ThumbnailAtlas::invalidate()
+{
+    std::fill(valid_.begin(), valid_.end(), false);
+}
+
+void ThumbnailAtlas::tileUVs(int tile, float uv0[2], float uv1[2]) const
+{
+    float size = 1.0f / TilesPerRow;
+    float u = (float) (tile % TilesPerRow) * size, v = (float) (tile / TilesPerRow) * size;
+    uv0[0] = u;
+    uv0[1] = v + size;
+    uv1[0] = u + size;
+    uv1[1] = v;
+}
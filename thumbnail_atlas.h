@@ -0,0 +1,73 @@
+#pragma once
+
+#include "piece_table.h"
+#include "vis_params.h"
+
+#include <cstdint>
+#include <vector>
+
+// Point-cloud previews of many candidate layouts, rendered into the tiles of one offscreen texture.
+// The positions of an even sample of each redrawn candidate's vertices are gathered from the document on the CPU
+// into one small buffer, so candidates can sit anywhere in a file far larger than the GPU could hold. Every tile that
+// needs redrawing then goes out in a single instanced draw, each instance carrying its slice of that buffer and its
+// framing.
+class ThumbnailAtlas
+{
+public:
+    static constexpr int TilesPerRow = 8;
+    static constexpr int TileCount = TilesPerRow * TilesPerRow;
+    static constexpr int TileSize = 160;
+
+    ThumbnailAtlas() = default;
+    ThumbnailAtlas(const ThumbnailAtlas&) = delete;
+    ThumbnailAtlas& operator=(const ThumbnailAtlas&) = delete;
+    ~ThumbnailAtlas();
+
+    // Needs a current GL context; returns false if the framebuffer can't be created
+    bool create();
+
+    // Shows candidates[i] in tile i for the first TileCount candidates. Only tiles whose layout changed are redrawn,
+    // unless `revision` differs from the last call, which redraws them all.
+    void update(const std::vector<VisParams>& candidates, const PieceTable& table, uint64_t revision);
+
+    // Redraws every tile on the next update, for when the candidates now come from another document
+    void invalidate();
+
+    unsigned texture() const { return colorTexture_; }
+
+    // Texture coordinates of a tile with the image upright, as ImGui::Image expects them
+    void tileUVs(int tile, float uv0[2], float uv1[2]) const;
+
+    // Tiles redrawn by the last update, for gauging how well the cache is doing
+    int lastRedrawn() const { return lastRedrawn_; }
+
+private:
+    struct Instance
+    {
+        uint32_t start;  // first position in the gathered buffer
+        uint32_t count;
+        uint32_t tile;
+        uint32_t unused;
+        float center[3];
+        float inverseRadius;
+    };
+
+    // Appends the candidate's sampled positions to `positions`, three floats each, NaN where unreadable
+    static Instance makeInstance(const VisParams& params, const PieceTable& table, int tile,
+                                 std::vector<float>& positions);
+
+    std::vector<VisParams> tiles_;
+    std::vector<bool> valid_;
+    uint64_t revision_ = 0;
+    int lastRedrawn_ = 0;
+
+    unsigned framebuffer_ = 0;
+    unsigned colorTexture_ = 0;
+    unsigned depthBuffer_ = 0;
+    unsigned dataTexture_ = 0;
+    unsigned dataBuffer_ = 0;
+    unsigned instanceBuffer_ = 0;
+    unsigned vao_ = 0;
+    unsigned program_ = 0;
+    int rotationLocation_ = -1;
+};
@@ -0,0 +1,234 @@
+#include "vertex_picking.h"
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+    constexpr size_t Grain = 1 << 16;
+
+    float decodeFloat(const uint8_t *p, bool bigEndian)
+    {
+        uint32_t bits = 0;
+        for (int b = 0; b < 4; b++) bits |= (uint32_t) p[b] << ((bigEndian ? 3 - b : b) * 8);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Spreads the low 10 bits of v out to every third bit
+    uint32_t spreadBits(uint32_t v)
+    {
+        v = (v | (v << 16)) & 0x030000FF;
+        v = (v | (v << 8)) & 0x0300F00F;
+        v = (v | (v << 4)) & 0x030C30C3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    // Four 8-bit passes over the code in the high word, which keeps equal codes in vertex order
+    void radixSort(std::vector<uint64_t>& keys)
+    {
+        std::vector<uint64_t> scratch(keys.size());
+        for (int shift = 32; shift < 64; shift += 8) {
+            size_t counts[257] = {};
+            for (uint64_t key: keys) counts[((key >> shift) & 0xFF) + 1]++;
+            for (int i = 0; i < 256; i++) counts[i + 1] += counts[i];
+            for (uint64_t key: keys) scratch[counts[(key >> shift) & 0xFF]++] = key;
+            keys.swap(scratch);
+        }
+    }
+
+    void emptyNode(PickTree::Node& node)
+    {
+        for (int axis = 0; axis < 3; axis++) {
+            node.low[axis] = INFINITY;
+            node.high[axis] = -INFINITY;
+        }
+    }
+
+    // Largest and smallest distance along the ray of any point in the box
+    float farthestDepth(const PickTree::Node& node, const float origin[3], const float direction[3])
+    {
+        float depth = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            depth += std::max((node.low[axis] - origin[axis]) * direction[axis],
+                              (node.high[axis] - origin[axis]) * direction[axis]);
+        }
+        return depth;
+    }
+
+    float nearestDepth(const PickTree::Node& node, const float origin[3], const float direction[3])
+    {
+        float depth = 0.0f;
+        for (int axis = 0; axis < 3; axis++) {
+            depth += std::min((node.low[axis] - origin[axis]) * direction[axis],
+                              (node.high[axis] - origin[axis]) * direction[axis]);
+        }
+        return depth;
+    }
+
+    // Slab test against the box grown by `margin` on every side
+    bool rayHitsBox(const PickTree::Node& node, const float origin[3], const float inverse[3], float margin)
+    {
+        float near = 0.0f, far = INFINITY;
+        for (int axis = 0; axis < 3; axis++) {
+            float t0 = (node.low[axis] - margin - origin[axis]) * inverse[axis];
+            float t1 = (node.high[axis] + margin - origin[axis]) * inverse[axis];
+            if (t0 > t1) std::swap(t0, t1);
+            near = std::max(near, t0);
+            far = std::min(far, t1);
+            if (near > far) return false;
+        }
+        return true;
+    }
+}
+
+bool buildPickTree(const uint8_t *bytes, uint64_t count, uint32_t stride, bool bigEndian, PickTree& tree,
+                   const std::atomic<bool> *cancel)
+{
+    tree = PickTree();
+    tree.positions.resize(count * 3);
+    workerPool().parallelFor(count, Grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            for (int axis = 0; axis < 3; axis++) {
+                tree.positions[i * 3 + axis] = decodeFloat(bytes + i * stride + axis * 4, bigEndian);
+            }
+        }
+    });
+    if (cancel && *cancel) return false;
+
+    float low[3] = { INFINITY, INFINITY, INFINITY }, high[3] = { -INFINITY, -INFINITY, -INFINITY };
+    for (uint64_t i = 0; i < count; i++) {
+        const float *p = &tree.positions[i * 3];
+        if (!std::isfinite(p[0]) || !std::isfinite(p[1]) || !std::isfinite(p[2])) continue;
+        for (int axis = 0; axis < 3; axis++) {
+            low[axis] = std::min(low[axis], p[axis]);
+            high[axis] = std::max(high[axis], p[axis]);
+        }
+    }
+
+    // Codes on a 1024^3 grid over the bounds; non-finite vertices get none and are dropped after sorting
+    std::vector<uint64_t> keys(count);
+    workerPool().parallelFor(count, Grain, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const float *p = &tree.positions[i * 3];
+            uint64_t code = UINT32_MAX;
+            if (std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2])) {
+                code = 0;
+                for (int axis = 0; axis < 3; axis++) {
+                    float extent = high[axis] - low[axis];
+                    float cell = extent > 0.0f ? (p[axis] - low[axis]) / extent * 1023.0f : 0.0f;
+                    code |= (uint64_t) spreadBits((uint32_t) std::clamp(cell, 0.0f, 1023.0f)) << axis;
+                }
+            }
+            keys[i] = code << 32 | i;
+        }
+    });
+    radixSort(keys);
+    if (cancel && *cancel) return false;
+
+    for (uint64_t key: keys) {
+        if ((key >> 32) == UINT32_MAX) break;
+        tree.order.push_back((uint32_t) key);
+    }
+
+    size_t leafCount = std::max<size_t>(1, (tree.order.size() + PickTree::LeafSize - 1) / PickTree::LeafSize);
+    size_t paddedLeaves = 1;
+    while (paddedLeaves < leafCount) paddedLeaves *= 2;
+    tree.firstLeaf = paddedLeaves - 1;
+    tree.nodes.resize(2 * paddedLeaves - 1);
+
+    workerPool().parallelFor(paddedLeaves, 1024, [&](size_t begin, size_t end) {
+        for (size_t leaf = begin; leaf < end; leaf++) {
+            PickTree::Node& node = tree.nodes[tree.firstLeaf + leaf];
+            emptyNode(node);
+            size_t first = leaf * PickTree::LeafSize;
+            size_t last = std::min(tree.order.size(), first + PickTree::LeafSize);
+            for (size_t k = first; k < last; k++) {
+                const float *p = &tree.positions[(size_t) tree.order[k] * 3];
+                for (int axis = 0; axis < 3; axis++) {
+                    node.low[axis] = std::min(node.low[axis], p[axis]);
+                    node.high[axis] = std::max(node.high[axis], p[axis]);
+                }
+            }
+        }
+    });
+
+    // Parents a level at a time, from just above the leaves to the root
+    for (size_t levelSize = paddedLeaves / 2; levelSize > 0; levelSize /= 2) {
+        size_t levelStart = levelSize - 1;
+        workerPool().parallelFor(levelSize, 4096, [&](size_t begin, size_t end) {
+            for (size_t n = levelStart + begin; n < levelStart + end; n++) {
+                const PickTree::Node& left = tree.nodes[2 * n + 1];
+                const PickTree::Node& right = tree.nodes[2 * n + 2];
+                for (int axis = 0; axis < 3; axis++) {
+                    tree.nodes[n].low[axis] = std::min(left.low[axis], right.low[axis]);
+                    tree.nodes[n].high[axis] = std::max(left.high[axis], right.high[axis]);
+                }
+            }
+        });
+    }
+    return !(cancel && *cancel);
+}
+
+bool pickVertex(const PickTree& tree, const float origin[3], const float direction[3], float radius, float spread,
+                uint64_t& vertex)
+{
+    if (tree.order.empty()) return false;
+
+    float inverse[3];
+    for (int axis = 0; axis < 3; axis++) inverse[axis] = 1.0f / direction[axis];
+
+    float bestScore = INFINITY, bestDepth = INFINITY;
+    size_t stack[64];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        size_t n = stack[--top];
+        const PickTree::Node& node = tree.nodes[n];
+
+        // The padding past the last leaf has inverted boxes, which the slab test would pass as infinite
+        if (node.low[0] > node.high[0]) continue;
+
+        // Each box is grown by the tolerance at its own deepest point, shrunk to the best score so far: nothing inside
+        // a box the ray misses by more than that can beat the vertex already found
+        float depth = farthestDepth(node, origin, direction);
+        if (depth <= 0.0f) continue;
+        float margin = std::min(bestScore, 1.0f) * (radius + spread * depth);
+        if (!rayHitsBox(node, origin, inverse, margin)) continue;
+        if (n < tree.firstLeaf) {
+            // Nearer child on top, so a close candidate is found early and narrows the rest of the search
+            size_t left = 2 * n + 1, right = 2 * n + 2;
+            bool leftFirst = nearestDepth(tree.nodes[left], origin, direction) <=
+                             nearestDepth(tree.nodes[right], origin, direction);
+            stack[top++] = leftFirst ? right : left;
+            stack[top++] = leftFirst ? left : right;
+            continue;
+        }
+
+        size_t first = (n - tree.firstLeaf) * PickTree::LeafSize;
+        size_t last = std::min(tree.order.size(), first + PickTree::LeafSize);
+        for (size_t k = first; k < last; k++) {
+            const float *p = &tree.positions[(size_t) tree.order[k] * 3];
+            float offset[3] = { p[0] - origin[0], p[1] - origin[1], p[2] - origin[2] };
+            float depth = offset[0] * direction[0] + offset[1] * direction[1] + offset[2] * direction[2];
+            if (depth <= 0.0f) continue;
+
+            // From the cross product rather than |offset|^2 - depth^2, which cancels to noise a long way down the ray
+            float cross[3] = { offset[1] * direction[2] - offset[2] * direction[1],
+                               offset[2] * direction[0] - offset[0] * direction[2],
+                               offset[0] * direction[1] - offset[1] * direction[0] };
+            float squared = cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2];
+            float tolerance = radius + spread * depth;
+            float score = std::sqrt(squared) / tolerance;
+            if (score > 1.0f || score > bestScore || (score == bestScore && depth >= bestDepth)) continue;
+            bestScore = score;
+            bestDepth = depth;
+            vertex = tree.order[k];
+        }
+    }
+    return bestScore <= 1.0f;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Vertex positions of one layout in a bounding volume hierarchy, so the vertex under the mouse is found by visiting
+// a thin tube of boxes rather than every vertex. Leaves are runs of vertices along a Morton curve; the boxes over them
+// form an implicit complete binary tree, children of node n at 2n + 1 and 2n + 2.
+struct PickTree
+{
+    static constexpr uint32_t LeafSize = 16;
+
+    struct Node
+    {
+        float low[3];
+        float high[3];
+    };
+
+    std::vector<float> positions;  // xyz of every vertex, by vertex index
+    std::vector<uint32_t> order;   // finite vertices by Morton code; leaf i holds order[i * LeafSize...]
+    std::vector<Node> nodes;
+    size_t firstLeaf = 0;          // index in nodes of leaf 0
+};
+
+// Decodes the leading three floats of `count` vertices `stride` bytes apart from `bytes`, and builds the tree across
+// the worker pool. Vertices whose position isn't finite can't be picked. Returns false if `cancel` was raised.
+bool buildPickTree(const uint8_t *bytes, uint64_t count, uint32_t stride, bool bigEndian, PickTree& tree,
+                   const std::atomic<bool> *cancel = nullptr);
+
+// The vertex closest to the ray from `origin` along the unit vector `direction`, counting only vertices in front of
+// the origin within `radius` + `spread` * distance of the ray, which is how far a few pixels reach in a perspective
+// view. Closeness is relative to that tolerance, so nearer vertices win ties. Returns false if none is close enough.
+bool pickVertex(const PickTree& tree, const float origin[3], const float direction[3], float radius, float spread,
+                uint64_t& vertex);
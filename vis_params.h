@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+
+enum PolygonMode
+{
+    PMFill,
+    PMLine,
+    PMPoint
+};
+
+enum MeshType
+{
+    MTTriangle,
+    MTTriangleStrip,
+    MTTriangleFan,
+    MTQuad,
+    MTQuadStrip,
+    MTLine,
+    MTLineStrip,
+    MTLineLoop,
+    MTPoint
+};
+
+struct VisParams
+{
+    // Offsets and counts are 64-bit so layouts anywhere in multi-gigabyte archives can be described
+    uint64_t vertexBufferStart = 0;
+    uint64_t indexBufferStart = 0;
+    uint64_t vertexCount = 3;  // index count for indexed draws
+    uint32_t vertexStride = 12;
+    bool bigEndian = true;
+    bool backfaceCulling = false;
+    float viewDistance = 3.0f;
+    bool indexedDraw = false;
+    bool halfWidthIndexes = false;
+    PolygonMode polygonMode = PMFill;
+    MeshType meshType = MTTriangle;
+
+    // Offsets within the vertex of attributes bound for shading, -1 when unbound. Normals are three floats, texture
+    // coordinates two floats or two halves, colors four normalized bytes.
+    int normalOffset = -1;
+    int texCoordOffset = -1;
+    int colorOffset = -1;
+    bool halfTexCoords = false;
+
+    bool operator==(const VisParams&) const = default;
+};
+
+// Whether two parameter sets read the same vertices and indices, whatever the draw style
+inline bool sameLayout(const VisParams& a, const VisParams& b)
+{
+    return a.vertexBufferStart == b.vertexBufferStart && a.vertexStride == b.vertexStride &&
+           a.vertexCount == b.vertexCount && a.bigEndian == b.bigEndian && a.indexedDraw == b.indexedDraw &&
+           (!a.indexedDraw || (a.indexBufferStart == b.indexBufferStart && a.halfWidthIndexes == b.halfWidthIndexes));
+}
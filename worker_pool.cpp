@@ -0,0 +1,98 @@
+#include "worker_pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+WorkerPool::WorkerPool(unsigned threadCount)
+{
+    threadCount = std::max(threadCount, 1u);
+    for (unsigned i = 0; i < threadCount; i++) {
+        threads_.emplace_back([this] { workerLoop(); });
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+
+    for (auto& thread: threads_) {
+        thread.join();
+    }
+}
+
+void WorkerPool::submit(std::function<void()> task)
+{
+    {
+        std::lock_guard lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+void WorkerPool::workerLoop()
+{
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (stopping_ && tasks_.empty()) return;
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+        task();
+    }
+}
+
+void WorkerPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn)
+{
+    grain = std::max(grain, (size_t) 1);
+    size_t chunkCount = (count + grain - 1) / grain;
+    if (chunkCount == 0) return;
+    if (chunkCount == 1) {
+        fn(0, count);
+        return;
+    }
+
+    struct Shared
+    {
+        std::atomic<size_t> nextChunk { 0 };
+        std::atomic<size_t> doneChunks { 0 };
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto shared = std::make_shared<Shared>();
+
+    auto work = [shared, chunkCount, count, grain, &fn] {
+        size_t chunk;
+        while ((chunk = shared->nextChunk.fetch_add(1)) < chunkCount) {
+            size_t begin = chunk * grain;
+            fn(begin, std::min(begin + grain, count));
+            if (shared->doneChunks.fetch_add(1) + 1 == chunkCount) {
+                std::lock_guard lock(shared->mutex);
+                shared->done.notify_all();
+            }
+        }
+    };
+
+    // Helpers that start after every chunk is claimed return immediately, so `fn` never outlives this call
+    size_t helpers = std::min((size_t) threadCount(), chunkCount - 1);
+    for (size_t i = 0; i < helpers; i++) {
+        submit(work);
+    }
+    work();
+
+    std::unique_lock lock(shared->mutex);
+    shared->done.wait(lock, [&] { return shared->doneChunks.load() == chunkCount; });
+}
+
+WorkerPool& workerPool()
+{
+    static WorkerPool pool;
+    return pool;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of background threads shared by every analysis and I/O job.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(unsigned threadCount = std::thread::hardware_concurrency());
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    unsigned threadCount() const { return (unsigned) threads_.size(); }
+
+    void submit(std::function<void()> task);
+
+    // Runs `fn` on the pool and hands back a future for its result, polled from the UI thread.
+    template<class F>
+    auto async(F&& fn) -> std::future<decltype(fn())>
+    {
+        using Result = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(fn));
+        std::future<Result> future = task->get_future();
+        submit([task] { (*task)(); });
+        return future;
+    }
+
+    // Calls fn(begin, end) over [0, count) in chunks of `grain` and blocks until all are done.
+    // The calling thread works through chunks too, so this is safe to use from inside a pool task.
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn);
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> threads_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
+
+// The process-wide pool
+WorkerPool& workerPool();
+
+template<class T>
+bool isFutureReady(const std::future<T>& future)
+{
+    return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}